@@ -1,13 +1,48 @@
-SOURCES="test/testconv1d.cpp -I src/base -I src/myarray -I src/conv1d -DNDEBUG"
+INCLUDES="-I src/base -I src/myarray -I src/conv1d -I src/conv2d -DNDEBUG"
+
+# PERF=1 compiles in the hardware counters of src/base/perf.hpp
+if [ -n "$PERF" ]; then
+	INCLUDES="$INCLUDES -DFASTCONV_PERF"
+fi
 
 VENDOR=${1}
+TARGET=${2:-testconv1d}
+
+# check builds testconv1d and runs only its identity checks, once per
+# instruction set, and fails if any of them fails
+if [ "$TARGET" == "check" ]; then
+	CHECK=1
+	TARGET=testconv1d
+fi
+
+# benchconv1d writes its results to bench_<vendor>.json/.csv for tracking
+# across compilers; see test/benchconv1d.cpp for the BENCH_* variables
+if [ "$TARGET" == "benchconv1d" ]; then
+	export BENCH_TAG=${BENCH_TAG:-$VENDOR}
+	export BENCH_JSON=${BENCH_JSON:-bench_${VENDOR}.json}
+	export BENCH_CSV=${BENCH_CSV:-bench_${VENDOR}.csv}
+elif [ "$TARGET" != "testconv1d" ] && [ "$TARGET" != "convfile" ]; then
+	echo "usage: $0 [gcc/oneapi] [testconv1d/benchconv1d/convfile/check] [convfile arguments]"
+	exit 1
+fi
+SOURCES="test/${TARGET}.cpp ${INCLUDES}"
+
+run() {
+	if [ -n "$CHECK" ]; then
+		for isa in scalar sse avx2 avx512; do
+			CHECK_ONLY=1 FASTCONV_ISA=$isa ./${TARGET} || return 1
+		done
+	else
+		./${TARGET} "$@"
+	fi
+}
 
 if [ "$VENDOR" == "gcc" ]; then
 	# gcc version
-	g++ ${SOURCES} -g -O3 -ffast-math -march=native -o testconv1d && ./testconv1d
+	g++ ${SOURCES} -g -O3 -ffast-math -march=native -pthread -o ${TARGET} && run "${@:3}"
 elif [ "$VENDOR" == "oneapi" ]; then
 	# Intel oneApi version
-	icpx ${SOURCES} -g -O3 -fp-model=fast -xHost -o testconv1d && ./testconv1d
+	icpx ${SOURCES} -g -O3 -fp-model=fast -xHost -pthread -o ${TARGET} && run "${@:3}"
 else
-	echo "usage: $0 [gcc/oneapi]"
+	echo "usage: $0 [gcc/oneapi] [testconv1d/benchconv1d/convfile/check] [convfile arguments]"
 fi
@@ -0,0 +1,344 @@
+#ifndef PERF_HPP
+#define PERF_HPP
+
+// Optional hardware counter instrumentation of the convolution calls,
+// compiled in with -DFASTCONV_PERF (Linux only). Each instrumented call adds
+// its wall-clock time and, where the kernel permits, the counts of
+// perf_event_open counters to a process-wide table keyed by engine name and
+// kernel-size bucket. Counters are per thread: with a thread pool only the
+// calling thread's share is counted, while the wall-clock time covers the
+// whole call. Without permission (see /proc/sys/kernel/perf_event_paranoid)
+// or without a PMU, only the wall-clock time is recorded.
+
+#ifdef FASTCONV_PERF
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Counters in the order of PerfCounters::names()
+enum class PerfEvent
+{
+   cycles,
+   instructions,
+   l1d_misses,
+   llc_misses,
+   fp_vector_ops,
+   count
+};
+
+using PerfValues = std::array<std::uint64_t, static_cast<std::size_t>(PerfEvent::count)>;
+
+// Counter group of the calling thread. Events that cannot be opened are
+// skipped, if none can the group is unavailable.
+class PerfCounters
+{
+ public:
+   static inline const std::array<const char*, static_cast<std::size_t>(PerfEvent::count)>& names()
+   {
+      static const std::array<const char*, static_cast<std::size_t>(PerfEvent::count)> list = {
+            "cycles", "instructions", "l1d_misses", "llc_misses", "fp_vector_ops"};
+      return list;
+   }
+
+   inline PerfCounters()
+   {
+      fds.fill(-1);
+#if defined(__linux__)
+      for ( std::size_t e = 0; e < fds.size(); e++ )
+      {
+         std::uint32_t type;
+         std::uint64_t config;
+         if ( !event_config(static_cast<PerfEvent>(e), type, config) )
+            continue;
+
+         perf_event_attr attr;
+         std::memset(&attr, 0, sizeof(attr));
+         attr.size = sizeof(attr);
+         attr.type = type;
+         attr.config = config;
+         attr.disabled = leader < 0 ? 1 : 0;
+         attr.exclude_kernel = 1;
+         attr.exclude_hv = 1;
+         attr.read_format
+               = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+         const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+         if ( fd < 0 )
+            continue;
+         fds[e] = fd;
+         slots[e] = members++;
+         if ( leader < 0 )
+            leader = fd;
+      }
+      if ( leader >= 0 )
+      {
+         ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+         ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+      }
+#endif
+   }
+
+   inline ~PerfCounters()
+   {
+#if defined(__linux__)
+      for ( int fd : fds )
+      {
+         if ( fd >= 0 )
+            close(fd);
+      }
+#endif
+   }
+
+   PerfCounters(const PerfCounters&) = delete;
+   PerfCounters& operator=(const PerfCounters&) = delete;
+
+   inline bool available() const
+   {
+      return leader >= 0;
+   }
+
+   inline bool has(PerfEvent e) const
+   {
+      return fds[static_cast<std::size_t>(e)] >= 0;
+   }
+
+   // Current totals of the running counters, scaled if they were multiplexed;
+   // returns false if the group has not been scheduled
+   inline bool read(PerfValues& values) const
+   {
+      values.fill(0);
+#if defined(__linux__)
+      if ( leader < 0 )
+         return false;
+      std::array<std::uint64_t, 3 + static_cast<std::size_t>(PerfEvent::count)> buf{};
+      const ssize_t expected = static_cast<ssize_t>((3 + members) * sizeof(std::uint64_t));
+      if ( ::read(leader, buf.data(), sizeof(buf)) < expected )
+         return false;
+      const std::uint64_t enabled = buf[1], running = buf[2];
+      if ( running == 0 )
+         return false;
+      for ( std::size_t e = 0; e < fds.size(); e++ )
+      {
+         if ( fds[e] >= 0 )
+            values[e] = static_cast<std::uint64_t>(double(buf[3 + slots[e]]) * enabled / running);
+      }
+      return true;
+#else
+      return false;
+#endif
+   }
+
+   // Counters of the calling thread, opened on first use
+   static inline PerfCounters& thread_counters()
+   {
+      thread_local PerfCounters counters;
+      return counters;
+   }
+
+ private:
+#if defined(__linux__)
+   static inline bool event_config(PerfEvent e, std::uint32_t& type, std::uint64_t& config)
+   {
+      constexpr std::uint64_t read_miss = (std::uint64_t(PERF_COUNT_HW_CACHE_OP_READ) << 8)
+            | (std::uint64_t(PERF_COUNT_HW_CACHE_RESULT_MISS) << 16);
+      type = PERF_TYPE_HARDWARE;
+      switch ( e )
+      {
+      case PerfEvent::cycles:
+         config = PERF_COUNT_HW_CPU_CYCLES;
+         return true;
+      case PerfEvent::instructions:
+         config = PERF_COUNT_HW_INSTRUCTIONS;
+         return true;
+      case PerfEvent::l1d_misses:
+         type = PERF_TYPE_HW_CACHE;
+         config = PERF_COUNT_HW_CACHE_L1D | read_miss;
+         return true;
+      case PerfEvent::llc_misses:
+         config = PERF_COUNT_HW_CACHE_MISSES;
+         return true;
+      case PerfEvent::fp_vector_ops:
+#if defined(__x86_64__)
+         // FP_ARITH_INST_RETIRED, packed single of 128, 256 and 512 bits: a
+         // model-specific event of Intel cores since Broadwell
+         __builtin_cpu_init();
+         if ( !__builtin_cpu_is("intel") )
+            return false;
+         type = PERF_TYPE_RAW;
+         config = 0xc7 | (0xa8 << 8);
+         return true;
+#else
+         return false;
+#endif
+      default:
+         return false;
+      }
+   }
+#endif
+
+   std::array<int, static_cast<std::size_t>(PerfEvent::count)> fds;
+   std::array<std::size_t, static_cast<std::size_t>(PerfEvent::count)> slots{};
+   std::size_t members = 0;
+   int leader = -1;
+};
+
+// Totals of one (engine, kernel bucket) entry
+struct PerfTotals
+{
+   std::uint64_t calls = 0;
+   std::uint64_t outputs = 0;
+   double seconds = 0;
+   std::uint64_t counted_calls = 0; // calls with valid counter readings
+   PerfValues values{};
+};
+
+// Process-wide table of the instrumented calls
+class PerfRegistry
+{
+ public:
+   // Kernel sizes are grouped by powers of two: bucket b holds sizes up to 2^b
+   static inline std::size_t bucket(std::size_t kernel_size)
+   {
+      std::size_t b = 0;
+      while ( (std::size_t(1) << b) < kernel_size )
+         b++;
+      return b;
+   }
+
+   inline void add(const std::string& engine, std::size_t kernel_size, std::size_t outputs, double seconds,
+         const PerfValues* values)
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      PerfTotals& t = entries[{engine, bucket(kernel_size)}];
+      t.calls++;
+      t.outputs += outputs;
+      t.seconds += seconds;
+      if ( values )
+      {
+         t.counted_calls++;
+         for ( std::size_t e = 0; e < t.values.size(); e++ )
+            t.values[e] += (*values)[e];
+      }
+   }
+
+   inline void clear()
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      entries.clear();
+   }
+
+   inline std::map<std::pair<std::string, std::size_t>, PerfTotals> snapshot() const
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      return entries;
+   }
+
+   // One line per entry: per-output time and counts, IPC
+   inline void report(std::ostream& out) const
+   {
+      const PerfCounters& counters = PerfCounters::thread_counters();
+      out << "perf counters: " << (counters.available() ? "available" : "unavailable, wall-clock only")
+          << '\n';
+      for ( const auto& [key, t] : snapshot() )
+      {
+         const double outputs = t.outputs > 0 ? double(t.outputs) : 1.0;
+         out << std::left << std::setw(8) << key.first << std::right << " kernel <= " << std::setw(5)
+             << (std::size_t(1) << key.second) << ": calls = " << t.calls << std::fixed
+             << std::setprecision(4) << "; ns/output = " << t.seconds / outputs * 1e9;
+         if ( t.counted_calls > 0 )
+         {
+            for ( std::size_t e = 0; e < t.values.size(); e++ )
+            {
+               if ( counters.has(static_cast<PerfEvent>(e)) )
+                  out << "; " << PerfCounters::names()[e] << "/output = " << t.values[e] / outputs;
+            }
+            const auto cycles = t.values[static_cast<std::size_t>(PerfEvent::cycles)];
+            if ( cycles > 0 )
+               out << std::setprecision(2) << "; IPC = "
+                   << double(t.values[static_cast<std::size_t>(PerfEvent::instructions)]) / cycles;
+         }
+         out << '\n';
+      }
+      out << std::defaultfloat;
+   }
+
+   static inline PerfRegistry& global()
+   {
+      static PerfRegistry registry;
+      return registry;
+   }
+
+ private:
+   mutable std::mutex mutex;
+   std::map<std::pair<std::string, std::size_t>, PerfTotals> entries;
+};
+
+// Records the enclosing scope in the global registry
+class PerfScope
+{
+ public:
+   inline PerfScope(const char* engine, std::size_t kernel_size, std::size_t outputs)
+         : engine(engine), kernel_size(kernel_size), outputs(outputs),
+           counters(PerfCounters::thread_counters())
+   {
+      valid = counters.read(start_values);
+      start = std::chrono::steady_clock::now();
+   }
+
+   inline ~PerfScope()
+   {
+      const auto end = std::chrono::steady_clock::now();
+      PerfValues end_values;
+      const bool counted = valid && counters.read(end_values);
+      if ( counted )
+      {
+         for ( std::size_t e = 0; e < end_values.size(); e++ )
+            end_values[e] -= start_values[e];
+      }
+      PerfRegistry::global().add(engine, kernel_size, outputs,
+            std::chrono::duration<double>(end - start).count(), counted ? &end_values : nullptr);
+   }
+
+   PerfScope(const PerfScope&) = delete;
+   PerfScope& operator=(const PerfScope&) = delete;
+
+ private:
+   const char* engine;
+   std::size_t kernel_size;
+   std::size_t outputs;
+   const PerfCounters& counters;
+   PerfValues start_values;
+   bool valid;
+   std::chrono::steady_clock::time_point start;
+};
+
+#define FASTCONV_PERF_CONCAT2(a, b) a##b
+#define FASTCONV_PERF_CONCAT(a, b) FASTCONV_PERF_CONCAT2(a, b)
+#define FASTCONV_PERF_SCOPE(engine, kernel_size, outputs) \
+   PerfScope FASTCONV_PERF_CONCAT(perf_scope_, __LINE__)(engine, kernel_size, outputs)
+
+#else
+
+#define FASTCONV_PERF_SCOPE(engine, kernel_size, outputs) \
+   do                                                      \
+   {                                                       \
+   } while ( 0 )
+
+#endif // FASTCONV_PERF
+
+#endif // PERF_HPP
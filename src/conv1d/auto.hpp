@@ -0,0 +1,356 @@
+#ifndef AUTO_HPP
+#define AUTO_HPP
+
+#include "conv1.hpp"
+#include "fft.hpp"
+#include "pad.hpp"
+#include "ref.hpp"
+#include "tiled.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+// Engines the planner chooses from
+enum class Conv1DEngine
+{
+   ref,
+   pad4,
+   pad8,
+   pad16,
+   fft,
+   tiled
+};
+
+inline const char*
+conv1d_engine_name(Conv1DEngine engine)
+{
+   switch ( engine )
+   {
+   case Conv1DEngine::pad4:
+      return "pad4";
+   case Conv1DEngine::pad8:
+      return "pad8";
+   case Conv1DEngine::pad16:
+      return "pad16";
+   case Conv1DEngine::fft:
+      return "fft";
+   case Conv1DEngine::tiled:
+      return "tiled";
+   default:
+      return "ref";
+   }
+}
+
+inline bool
+conv1d_engine_from_name(const std::string& name, Conv1DEngine& engine)
+{
+   for ( auto e : {Conv1DEngine::ref, Conv1DEngine::pad4, Conv1DEngine::pad8, Conv1DEngine::pad16,
+               Conv1DEngine::fft, Conv1DEngine::tiled} )
+   {
+      if ( name == conv1d_engine_name(e) )
+      {
+         engine = e;
+         return true;
+      }
+   }
+   return false;
+}
+
+template <typename FloatType>
+inline std::string
+conv_type_name()
+{
+   if ( std::is_same_v<FloatType, float> )
+      return "float";
+   if ( std::is_same_v<FloatType, double> )
+      return "double";
+   return "other" + std::to_string(sizeof(FloatType));
+}
+
+// Planner decisions ("wisdom"), keyed by value type, kernel length and the
+// input size rounded down to a power of two. Can be saved to a text file,
+// one decision per line: <type> <kernel size> <log2 input size> <engine>.
+class Conv1DWisdom
+{
+ public:
+   using Key = std::tuple<std::string, std::size_t, std::size_t>;
+
+   static inline std::size_t size_bucket(std::size_t input_size)
+   {
+      std::size_t bucket = 0;
+      while ( (input_size >> (bucket + 1)) > 0 )
+         bucket++;
+      return bucket;
+   }
+
+   inline bool lookup(const Key& key, Conv1DEngine& engine) const
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = entries.find(key);
+      if ( it == entries.end() )
+         return false;
+      engine = it->second;
+      return true;
+   }
+
+   inline void store(const Key& key, Conv1DEngine engine)
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      entries[key] = engine;
+   }
+
+   inline std::size_t size() const
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      return entries.size();
+   }
+
+   inline void clear()
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      entries.clear();
+   }
+
+   // Write all entries to a file, throws on I/O errors
+   inline void save(const std::string& path) const
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::ofstream out(path);
+      if ( !out )
+         throw std::runtime_error("Cannot write wisdom file " + path);
+      for ( const auto& [key, engine] : entries )
+      {
+         out << std::get<0>(key) << ' ' << std::get<1>(key) << ' ' << std::get<2>(key) << ' '
+             << conv1d_engine_name(engine) << '\n';
+      }
+      if ( !out )
+         throw std::runtime_error("Cannot write wisdom file " + path);
+   }
+
+   // Merge entries from a file; returns false if it cannot be opened.
+   // Malformed lines are skipped, each line is parsed on its own.
+   inline bool load(const std::string& path)
+   {
+      std::ifstream in(path);
+      if ( !in )
+         return false;
+      std::lock_guard<std::mutex> lock(mutex);
+      std::string line;
+      while ( std::getline(in, line) )
+      {
+         std::istringstream fields(line);
+         std::string type, engine_name, rest;
+         std::size_t kernel_size, bucket;
+         Conv1DEngine engine;
+         if ( fields >> type >> kernel_size >> bucket >> engine_name && !(fields >> rest)
+               && conv1d_engine_from_name(engine_name, engine) )
+            entries[{type, kernel_size, bucket}] = engine;
+      }
+      return true;
+   }
+
+   // Process-wide wisdom, preloaded from $FASTCONV_WISDOM if set
+   static inline std::shared_ptr<Conv1DWisdom> global()
+   {
+      static std::shared_ptr<Conv1DWisdom> wisdom = []() {
+         auto w = std::make_shared<Conv1DWisdom>();
+         if ( const char* path = std::getenv("FASTCONV_WISDOM") )
+            w->load(path);
+         return w;
+      }();
+      return wisdom;
+   }
+
+ private:
+   mutable std::mutex mutex;
+   std::map<Key, Conv1DEngine> entries;
+};
+
+// Trials run on at most this many input samples
+#ifndef FASTCONV_AUTO_MAX_TRIAL
+#define FASTCONV_AUTO_MAX_TRIAL (1 << 20)
+#endif
+
+// FFT is only tried for kernels at least this long
+#ifndef FASTCONV_AUTO_MIN_FFT_KERNEL
+#define FASTCONV_AUTO_MIN_FFT_KERNEL 32
+#endif
+
+// The tiled direct engine is only tried for kernels longer than the unrolled
+// specializations
+#ifndef FASTCONV_AUTO_MIN_TILED_KERNEL
+#define FASTCONV_AUTO_MIN_TILED_KERNEL (FASTCONV_MAX_FIXED_KERNEL + 1)
+#endif
+
+// Class definition for 1D convolution that picks the fastest engine per shape
+template <typename FloatType>
+class Conv1DAuto : Conv1DBase<FloatType>
+{
+ public:
+   // Constructor
+   inline Conv1DAuto(bool preserve_shape = false,
+         std::shared_ptr<Conv1DWisdom> wisdom = Conv1DWisdom::global())
+         : ref(preserve_shape), pad4(4, preserve_shape), pad8(8, preserve_shape),
+           pad16(16, preserve_shape), fft(preserve_shape), tiled(preserve_shape),
+           preserve_shape(preserve_shape), kernel_size(0), wisdom(std::move(wisdom))
+   {
+   }
+   inline Conv1DAuto(const ConstArrayView1D<FloatType>& init_kernel, bool preserve_shape = false,
+         std::shared_ptr<Conv1DWisdom> wisdom = Conv1DWisdom::global())
+         : Conv1DAuto(preserve_shape, std::move(wisdom))
+   {
+      set_kernel(init_kernel);
+   }
+
+   // Set the convolution kernel on all candidate engines
+   inline void set_kernel(const ConstArrayView1D<FloatType>& k)
+   {
+      kernel_size = k.size();
+      ref.set_kernel(k);
+      pad4.set_kernel(k);
+      pad8.set_kernel(k);
+      pad16.set_kernel(k);
+      if ( kernel_size >= FASTCONV_AUTO_MIN_FFT_KERNEL )
+         fft.set_kernel(k);
+      if ( kernel_size >= FASTCONV_AUTO_MIN_TILED_KERNEL )
+         tiled.set_kernel(k);
+   }
+
+   // Set the boundary mode of preserve_shape on all candidate engines
+   inline void set_boundary(Conv1DBoundary mode, FloatType value = 0)
+   {
+      ref.set_boundary(mode, value);
+      pad4.set_boundary(mode, value);
+      pad8.set_boundary(mode, value);
+      pad16.set_boundary(mode, value);
+      fft.set_boundary(mode, value);
+      tiled.set_boundary(mode, value);
+   }
+
+   // Compute the output size based on input size
+   inline std::size_t output_size(std::size_t input_size) const
+   {
+      return input_size + (preserve_shape ? 0 : 1 - kernel_size);
+   }
+
+   // Engine used for inputs of this size, tuned on first use
+   inline Conv1DEngine plan(const ConstArrayView1D<FloatType>& x) const
+   {
+      const Conv1DWisdom::Key key{
+            conv_type_name<FloatType>(), kernel_size, Conv1DWisdom::size_bucket(x.size())};
+      Conv1DEngine engine;
+      // Entries may come from a file tuned with other settings, retune if
+      // this kernel cannot use the engine
+      if ( !wisdom->lookup(key, engine) || !eligible(engine) )
+      {
+         engine = tune(x);
+         wisdom->store(key, engine);
+      }
+      return engine;
+   }
+
+   // Perform the 1D convolution with the planned engine
+   inline Array1D<FloatType> conv(const ConstArrayView1D<FloatType>& x) const
+   {
+      Array1D<FloatType> y(output_size(x.size()));
+      conv_into(x, y);
+      return y;
+   }
+
+   // Perform the 1D convolution with the planned engine into a caller-owned buffer
+   inline void conv_into(const ConstArrayView1D<FloatType>& x, ArrayView1D<FloatType> y) const
+   {
+      run(plan(x), x, y);
+   }
+
+ private:
+   // Whether the engine has a kernel set and may run this kernel size
+   inline bool eligible(Conv1DEngine engine) const
+   {
+      if ( engine == Conv1DEngine::fft )
+         return kernel_size >= FASTCONV_AUTO_MIN_FFT_KERNEL;
+      if ( engine == Conv1DEngine::tiled )
+         return kernel_size >= FASTCONV_AUTO_MIN_TILED_KERNEL;
+      return true;
+   }
+
+   inline void run(Conv1DEngine engine, const ConstArrayView1D<FloatType>& x,
+         ArrayView1D<FloatType> y) const
+   {
+      switch ( engine )
+      {
+      case Conv1DEngine::pad4:
+         pad4.conv_into(x, y);
+         break;
+      case Conv1DEngine::pad8:
+         pad8.conv_into(x, y);
+         break;
+      case Conv1DEngine::pad16:
+         pad16.conv_into(x, y);
+         break;
+      case Conv1DEngine::fft:
+         fft.conv_into(x, y);
+         break;
+      case Conv1DEngine::tiled:
+         tiled.conv_into(x, y);
+         break;
+      default:
+         ref.conv_into(x, y);
+      }
+   }
+
+   // Time every candidate on (a prefix of) the input, best of two runs
+   inline Conv1DEngine tune(const ConstArrayView1D<FloatType>& x) const
+   {
+      using namespace std::chrono;
+
+      const auto trial_input = x.view(0, std::min<std::size_t>(x.size(), FASTCONV_AUTO_MAX_TRIAL));
+      Array1D<FloatType> trial_output(output_size(trial_input.size()));
+      Conv1DEngine best = Conv1DEngine::ref;
+      double best_time = 0;
+
+      for ( auto engine : {Conv1DEngine::ref, Conv1DEngine::pad4, Conv1DEngine::pad8, Conv1DEngine::pad16,
+                  Conv1DEngine::fft, Conv1DEngine::tiled} )
+      {
+         if ( !eligible(engine) )
+            continue;
+
+         double time = 0;
+         for ( int trial = 0; trial < 2; trial++ )
+         {
+            auto t1 = steady_clock::now();
+            run(engine, trial_input, trial_output);
+            auto t2 = steady_clock::now();
+            const double t = duration<double>(t2 - t1).count();
+            time = trial == 0 ? t : std::min(time, t);
+         }
+
+         if ( engine == Conv1DEngine::ref || time < best_time )
+         {
+            best = engine;
+            best_time = time;
+         }
+      }
+      return best;
+   }
+
+   Conv1DRef<FloatType> ref;                      // Candidate engines
+   Conv1DPad<FloatType> pad4, pad8, pad16;
+   Conv1DFFT<FloatType> fft;
+   Conv1DTiled<FloatType> tiled;
+   bool preserve_shape;                           // Preserve shape of the input/output
+   std::size_t kernel_size;                       // Size of the kernel
+   std::shared_ptr<Conv1DWisdom> wisdom;          // Shared planner decisions
+};
+
+#endif // AUTO_HPP
@@ -0,0 +1,203 @@
+#ifndef BANK_HPP
+#define BANK_HPP
+
+#include "boundary.hpp"
+#include "core.hpp"
+#include "myarray2d.hpp"
+#include "parallel.hpp"
+#include "perf.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// Number of outputs per input tile; the tile (plus the kernel halo) stays in
+// L1/L2 while all kernels of the bank are applied to it
+#ifndef FASTCONV_BANK_BLOCK
+#define FASTCONV_BANK_BLOCK 4096
+#endif
+
+// Class definition for a filter bank: one input convolved with many kernels
+// in a single traversal. Kernels may have different lengths; each one is
+// reversed and zero-padded to a multiple of pad_modulo, as in Conv1DPad.
+// Output row i holds the result of kernel i. Without preserve_shape, the
+// outputs of a kernel longer than the shortest one end before its row does;
+// the rest of the row is zeroed.
+template <typename FloatType>
+class Conv1DBank : public Conv1DParallel
+{
+ public:
+   // Constructor
+   inline Conv1DBank(bool preserve_shape = false, std::size_t pad_modulo = 8,
+         std::size_t block_size = FASTCONV_BANK_BLOCK)
+         : preserve_shape(preserve_shape), pad_modulo(std::max<std::size_t>(pad_modulo, 1)),
+           block_size(std::max<std::size_t>(block_size, 64)), boundary(Conv1DBoundary::zero),
+           boundary_value(0)
+   {
+   }
+   inline Conv1DBank(const std::vector<ConstArrayView1D<FloatType>>& init_kernels,
+         bool preserve_shape = false, std::size_t pad_modulo = 8,
+         std::size_t block_size = FASTCONV_BANK_BLOCK)
+         : Conv1DBank(preserve_shape, pad_modulo, block_size)
+   {
+      set_kernels(init_kernels);
+   }
+
+   // Set the kernels (reverse and pad them)
+   inline void set_kernels(const std::vector<ConstArrayView1D<FloatType>>& new_kernels)
+   {
+      kernel_sizes.clear();
+      padded_sizes.clear();
+      std::size_t max_padded_size = 0;
+      for ( const auto& k : new_kernels )
+      {
+         if ( k.size() == 0 )
+         {
+            throw std::invalid_argument("Empty convolution kernel");
+         }
+         kernel_sizes.push_back(k.size());
+         padded_sizes.push_back((k.size() + pad_modulo - 1) / pad_modulo * pad_modulo);
+         max_padded_size = std::max(max_padded_size, padded_sizes.back());
+      }
+
+      kernels = std::move(Array2D<FloatType>(new_kernels.size(), max_padded_size));
+      for ( std::size_t n = 0; n < new_kernels.size(); n++ )
+      {
+         const std::size_t size = kernel_sizes[n];
+         for ( std::size_t i = 0; i < max_padded_size; i++ )
+         {
+            kernels(n, i) = i < size ? new_kernels[n](size - i - 1) : FloatType(0);
+         }
+      }
+   }
+
+   // Set the boundary mode of preserve_shape for all kernels
+   inline void set_boundary(Conv1DBoundary mode, FloatType value = 0)
+   {
+      boundary = mode;
+      boundary_value = value;
+   }
+
+   inline std::size_t num_kernels() const
+   {
+      return kernel_sizes.size();
+   }
+
+   // Number of outputs of kernel n (in the row, starting at output_offset(n))
+   inline std::size_t valid_size(std::size_t n, std::size_t input_size) const
+   {
+      return input_size + 1 - kernel_sizes[n];
+   }
+
+   // Position of the first output of kernel n in its row
+   inline std::size_t output_offset(std::size_t n) const
+   {
+      return preserve_shape ? (kernel_sizes[n] - 1) / 2 : 0;
+   }
+
+   // Row length of the output: large enough for the shortest kernel
+   inline std::size_t output_size(std::size_t input_size) const
+   {
+      if ( preserve_shape )
+         return input_size;
+      const std::size_t min_size = *std::min_element(kernel_sizes.begin(), kernel_sizes.end());
+      return input_size + 1 - min_size;
+   }
+
+   // Convolve the input with all kernels
+   inline Array2D<FloatType> conv(const ConstArrayView1D<FloatType>& x) const
+   {
+      Array2D<FloatType> y(num_kernels(), output_size(x.size()));
+      conv_into(x, y);
+      return y;
+   }
+
+   // Convolve the input with all kernels into a caller-owned buffer
+   inline void conv_into(const ConstArrayView1D<FloatType>& x, ArrayView2D<FloatType> y) const
+   {
+      FASTCONV_PERF_SCOPE("bank", kernels.cols(), y.rows() * y.cols());
+      const std::size_t input_size = x.size();
+      if ( y.rows() != num_kernels() || y.cols() != output_size(input_size) )
+      {
+         throw std::runtime_error("Incorrect output shape for filter bank convolution");
+      }
+
+      // outputs each padded kernel can produce, processed tile by tile so
+      // that a tile of x is read once from memory for all kernels
+      const std::size_t min_padded = *std::min_element(padded_sizes.begin(), padded_sizes.end());
+      const std::size_t common_size = input_size >= min_padded ? input_size - min_padded + 1 : 0;
+      const std::size_t num_blocks = (common_size + block_size - 1) / block_size;
+
+      auto run_block = [&](std::size_t b) {
+         const std::size_t start = b * block_size;
+         for ( std::size_t n = 0; n < num_kernels(); n++ )
+         {
+            const std::size_t end = std::min(start + block_size, padded_output_size(n, input_size));
+            if ( start >= end )
+               continue;
+            const std::size_t offset = output_offset(n);
+            conv1d_core<FloatType>(x.view(start, end + padded_sizes[n] - 1),
+                  kernels.row(n).view(0, padded_sizes[n]), y.row(n).view(offset + start, offset + end));
+         }
+      };
+
+      if ( pool && pool->size() > 1 && common_size * num_kernels() >= parallel_threshold && num_blocks > 1 )
+      {
+         pool->parallel_for(num_blocks, run_block);
+      }
+      else
+      {
+         for ( std::size_t b = 0; b < num_blocks; b++ )
+            run_block(b);
+      }
+
+      for ( std::size_t n = 0; n < num_kernels(); n++ )
+      {
+         conv_tail(x, n, padded_output_size(n, input_size), y);
+         if ( preserve_shape )
+         {
+            conv1d_boundary<FloatType>(x, kernels.row(n).view(0, kernel_sizes[n]), y.row(n), boundary,
+                  boundary_value);
+         }
+         else
+         {
+            const std::size_t end = input_size >= kernel_sizes[n] ? valid_size(n, input_size) : 0;
+            ArrayView1D<FloatType> row = y.row(n);
+            for ( std::size_t i = end; i < row.size(); i++ )
+               row(i) = FloatType(0);
+         }
+      }
+   }
+
+ private:
+   // Outputs of kernel n computed with its padded length
+   inline std::size_t padded_output_size(std::size_t n, std::size_t input_size) const
+   {
+      return input_size >= padded_sizes[n] ? input_size - padded_sizes[n] + 1 : 0;
+   }
+
+   // Outputs from `start` on for kernel n, with its unpadded length
+   inline void conv_tail(const ConstArrayView1D<FloatType>& x, std::size_t n, std::size_t start,
+         ArrayView2D<FloatType> y) const
+   {
+      const std::size_t size = kernel_sizes[n];
+      if ( x.size() < size || start >= valid_size(n, x.size()) )
+         return;
+      const std::size_t end = valid_size(n, x.size());
+      const std::size_t offset = output_offset(n);
+      conv1d_core<FloatType>(x.view(start, x.size()), kernels.row(n).view(0, size),
+            y.row(n).view(offset + start, offset + end));
+   }
+
+   Array2D<FloatType> kernels;           // Reversed kernels, one per row, zero-padded
+   std::vector<std::size_t> kernel_sizes; // Actual sizes of the kernels
+   std::vector<std::size_t> padded_sizes; // Sizes of the padded kernels
+   bool preserve_shape;                   // Preserve shape of the input/output
+   std::size_t pad_modulo;                // Padding alignment constraint
+   std::size_t block_size;                // Outputs per input tile
+   Conv1DBoundary boundary;               // Extension of the input for the edge outputs
+   FloatType boundary_value;              // Value of Conv1DBoundary::constant
+};
+
+#endif // BANK_HPP
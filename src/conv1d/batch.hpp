@@ -0,0 +1,135 @@
+#ifndef CONV1D_BATCH_HPP
+#define CONV1D_BATCH_HPP
+
+#include "core.hpp"
+#include "myarray2d.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// Convolve every row of x (channels x samples) with the same kernel. Rows are
+// processed in groups of four that share each tap broadcast; groups are run
+// on the pool when the batch is large enough. Every output is computed
+// exactly as by conv1d_core on its row.
+template <typename FloatType>
+void
+conv1d_core_batch(ConstArrayView2D<FloatType> x, ConstArrayView1D<FloatType> k, ArrayView2D<FloatType> y,
+      ThreadPool* pool = nullptr, std::size_t threshold = FASTCONV_PARALLEL_THRESHOLD)
+{
+   const std::size_t kernel_size = k.size();
+   const std::size_t rows = x.rows();
+
+   if ( y.rows() != rows || y.cols() != x.cols() - kernel_size + 1 )
+   {
+      throw std::runtime_error("Incorrect output shape for batched 1D convolution");
+   }
+
+   const auto& table = conv1d_rows_kernel_table<FloatType>();
+   const auto rows_kernel = kernel_size < table.size() ? table[kernel_size] : table[0];
+   constexpr std::size_t group_size = 4;
+   const std::size_t num_groups = (rows + group_size - 1) / group_size;
+
+   auto run_group = [&](std::size_t g) {
+      const std::size_t r0 = g * group_size;
+      const std::size_t r1 = std::min(r0 + group_size, rows);
+      std::size_t done = 0;
+      if ( rows_kernel && r1 - r0 == group_size )
+      {
+         done = rows_kernel(x.row(r0).data_ptr(), x.stride(), k.data_ptr(), y.row(r0).data_ptr(),
+               y.stride(), kernel_size, y.cols());
+      }
+      for ( std::size_t r = r0; r < r1; r++ )
+      {
+         conv1d_core<FloatType>(x.row(r).view(done, x.cols()), k, y.row(r).view(done, y.cols()));
+      }
+   };
+
+   if ( pool && pool->size() > 1 && rows * y.cols() >= threshold && num_groups > 1 )
+   {
+      pool->parallel_for(num_groups, run_group);
+   }
+   else
+   {
+      for ( std::size_t g = 0; g < num_groups; g++ )
+      {
+         run_group(g);
+      }
+   }
+}
+
+// Rows of the column pass gathered per block: the group of columns is
+// transposed block by block into rows that stay in L2
+#ifndef FASTCONV_COLUMNS_BLOCK
+#define FASTCONV_COLUMNS_BLOCK 1024
+#endif
+
+// Convolve every column of x (samples x channels, e.g. interleaved audio or
+// the vertical pass over an image) with the same kernel, without transposing
+// the whole array. Adjacent columns are handled in groups that span a cache
+// line: a block of rows of the group is gathered into the rows of a small
+// buffer, so every line loaded feeds all columns of the group, convolved by
+// conv1d_core_batch and scattered back. Groups and row blocks run on the
+// pool. Every output is computed exactly as by conv1d_core on x.col(c).
+template <typename FloatType>
+void
+conv1d_core_columns(ConstArrayView2D<FloatType> x, ConstArrayView1D<FloatType> k, ArrayView2D<FloatType> y,
+      ThreadPool* pool = nullptr, std::size_t threshold = FASTCONV_PARALLEL_THRESHOLD)
+{
+   const std::size_t kernel_size = k.size();
+   const std::size_t cols = x.cols();
+
+   if ( y.cols() != cols || y.rows() != x.rows() - kernel_size + 1 )
+   {
+      throw std::runtime_error("Incorrect output shape for batched 1D convolution");
+   }
+
+   const std::size_t output_rows = y.rows();
+   constexpr std::size_t group_size = std::max<std::size_t>(64 / sizeof(FloatType), 1);
+   constexpr std::size_t block_rows = FASTCONV_COLUMNS_BLOCK;
+   const std::size_t num_groups = (cols + group_size - 1) / group_size;
+   const std::size_t num_blocks = (output_rows + block_rows - 1) / block_rows;
+
+   auto run_task = [&](std::size_t t) {
+      thread_local std::vector<FloatType> input, output;
+      const std::size_t c0 = (t / num_blocks) * group_size;
+      const std::size_t c1 = std::min(c0 + group_size, cols);
+      const std::size_t r0 = (t % num_blocks) * block_rows;
+      const std::size_t r1 = std::min(r0 + block_rows, output_rows);
+      const std::size_t width = c1 - c0, in_len = r1 - r0 + kernel_size - 1, out_len = r1 - r0;
+
+      input.resize(width * in_len);
+      output.resize(width * out_len);
+      for ( std::size_t r = 0; r < in_len; r++ )
+      {
+         const FloatType* in = x.row(r0 + r).data_ptr() + c0;
+         for ( std::size_t c = 0; c < width; c++ )
+            input[c * in_len + r] = in[c];
+      }
+      conv1d_core_batch<FloatType>(ConstArrayView2D<FloatType>(input.data(), width, in_len, in_len), k,
+            ArrayView2D<FloatType>(output.data(), width, out_len, out_len));
+      for ( std::size_t r = 0; r < out_len; r++ )
+      {
+         FloatType* out = y.row(r0 + r).data_ptr() + c0;
+         for ( std::size_t c = 0; c < width; c++ )
+            out[c] = output[c * out_len + r];
+      }
+   };
+
+   const std::size_t num_tasks = num_groups * num_blocks;
+   if ( pool && pool->size() > 1 && output_rows * cols >= threshold && num_tasks > 1 )
+   {
+      pool->parallel_for(num_tasks, run_task);
+   }
+   else
+   {
+      for ( std::size_t t = 0; t < num_tasks; t++ )
+      {
+         run_task(t);
+      }
+   }
+}
+
+#endif // CONV1D_BATCH_HPP
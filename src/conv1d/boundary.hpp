@@ -0,0 +1,128 @@
+#ifndef CONV1D_BOUNDARY_HPP
+#define CONV1D_BOUNDARY_HPP
+
+#include "core.hpp"
+#include "myarray.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// How the input is extended beyond its ends for the edge outputs of a
+// preserve_shape convolution (for x = a b c d):
+//  - none: the edge outputs are not written
+//  - zero: ... 0 0 | a b c d | 0 0 ...
+//  - constant: ... v v | a b c d | v v ...
+//  - replicate: ... a a | a b c d | d d ...
+//  - reflect: ... c b | a b c d | c b ... (the end samples are not repeated)
+//  - wrap: ... c d | a b c d | a b ...
+enum class Conv1DBoundary
+{
+   none,
+   zero,
+   constant,
+   replicate,
+   reflect,
+   wrap
+};
+
+// Index in [0, n) of sample p of an input of n samples extended by mode, or
+// -1 where the extension is not a sample of the input (none, zero, constant)
+inline std::ptrdiff_t
+conv1d_extended_index(std::ptrdiff_t n, std::ptrdiff_t p, Conv1DBoundary mode)
+{
+   if ( p >= 0 && p < n )
+      return p;
+
+   switch ( mode )
+   {
+   case Conv1DBoundary::replicate:
+      return p < 0 ? 0 : n - 1;
+   case Conv1DBoundary::reflect:
+   {
+      if ( n == 1 )
+         return 0;
+      const std::ptrdiff_t period = 2 * (n - 1);
+      std::ptrdiff_t q = p % period;
+      if ( q < 0 )
+         q += period;
+      return q < n ? q : period - q;
+   }
+   case Conv1DBoundary::wrap:
+   {
+      std::ptrdiff_t q = p % n;
+      return q < 0 ? q + n : q;
+   }
+   default:
+      return -1;
+   }
+}
+
+// Sample p of the extended input, p may lie outside [0, x.size())
+template <typename FloatType>
+inline FloatType
+conv1d_extended(const ConstArrayView1D<FloatType>& x, std::ptrdiff_t p, Conv1DBoundary mode,
+      FloatType value)
+{
+   const std::ptrdiff_t q = conv1d_extended_index(static_cast<std::ptrdiff_t>(x.size()), p, mode);
+   if ( q >= 0 )
+      return x(q);
+   return mode == Conv1DBoundary::constant ? value : FloatType(0);
+}
+
+// Edge outputs of a preserve_shape convolution with the reversed kernel k:
+// y(i) = sum_j k(j) * x(i - (K - 1) / 2 + j) for the outputs whose window
+// leaves x, i.e. [0, (K - 1) / 2) and the last K / 2. Only the K - 1 + edge
+// samples around each end are extended, into a short buffer that runs through
+// conv1d_core, so the edges match a convolution of a padded copy of x.
+// y holds the outputs [begin, begin + y.size()) of the full output, other
+// edge outputs are skipped; the values do not depend on the range.
+template <typename FloatType>
+void
+conv1d_boundary_range(ConstArrayView1D<FloatType> x, ConstArrayView1D<FloatType> k,
+      ArrayView1D<FloatType> y, std::size_t begin, Conv1DBoundary mode, FloatType value = 0,
+      Conv1DSymmetry symmetry = Conv1DSymmetry::none)
+{
+   const std::size_t input_size = x.size();
+   const std::size_t kernel_size = k.size();
+   if ( mode == Conv1DBoundary::none || input_size == 0 || kernel_size == 0 )
+      return;
+
+   const std::size_t offset = (kernel_size - 1) / 2;
+   const std::size_t raw_output_size = input_size >= kernel_size ? input_size - kernel_size + 1 : 0;
+   const std::size_t left_end = std::min(offset, input_size);
+   const std::size_t right_begin = std::max(offset + raw_output_size, left_end);
+   const std::size_t range_end = begin + y.size();
+
+   auto edge = [&](std::size_t edge_begin, std::size_t edge_end) {
+      edge_begin = std::max(edge_begin, begin);
+      edge_end = std::min(edge_end, range_end);
+      if ( edge_begin >= edge_end )
+         return;
+      thread_local std::vector<FloatType> extended;
+      const std::size_t length = edge_end - edge_begin + kernel_size - 1;
+      extended.resize(length);
+      const std::ptrdiff_t first
+            = static_cast<std::ptrdiff_t>(edge_begin) - static_cast<std::ptrdiff_t>(offset);
+      for ( std::size_t n = 0; n < length; n++ )
+      {
+         extended[n] = conv1d_extended(x, first + static_cast<std::ptrdiff_t>(n), mode, value);
+      }
+      conv1d_core<FloatType>(ConstArrayView1D<FloatType>(extended.data(), length), k,
+            y.view(edge_begin - begin, edge_end - begin), symmetry);
+   };
+
+   edge(0, left_end);
+   edge(right_begin, input_size);
+}
+
+// All edge outputs of a preserve_shape convolution (y has x.size() elements)
+template <typename FloatType>
+void
+conv1d_boundary(ConstArrayView1D<FloatType> x, ConstArrayView1D<FloatType> k, ArrayView1D<FloatType> y,
+      Conv1DBoundary mode, FloatType value = 0, Conv1DSymmetry symmetry = Conv1DSymmetry::none)
+{
+   conv1d_boundary_range<FloatType>(x, k, y, 0, mode, value, symmetry);
+}
+
+#endif // CONV1D_BOUNDARY_HPP
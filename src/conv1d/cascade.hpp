@@ -0,0 +1,217 @@
+#ifndef CONV1D_CASCADE_HPP
+#define CONV1D_CASCADE_HPP
+
+#include "core.hpp"
+#include "myarray.hpp"
+#include "parallel.hpp"
+#include "perf.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// Number of final outputs per tile; the intermediate tiles of all stages
+// (plus their halos) stay in L1/L2 while the tile runs through the cascade
+#ifndef FASTCONV_CASCADE_BLOCK
+#define FASTCONV_CASCADE_BLOCK 4096
+#endif
+
+// Class definition for a cascade of FIR stages applied back to back, e.g.
+// smoothing then differentiation: the result equals convolving with each
+// kernel in turn (valid outputs only), without full-size intermediates.
+// The signal is processed in tiles of block_size outputs; every stage writes
+// its tile, extended by the halo the later stages need, to a per-thread
+// buffer that the next stage reads while it is still in cache. Each stage
+// runs through conv1d_core on splits of the output range, so the results are
+// identical to a chain of Conv1DRef::conv calls.
+//
+// Short inputs, where the halos of the stages cost more than they save, use
+// the composed kernel (the convolution of all kernels) in a single pass
+// instead; it rounds differently from the cascade (see set_compose_below).
+template <typename FloatType>
+class Conv1DCascade : public Conv1DParallel
+{
+ public:
+   // Constructor
+   inline Conv1DCascade(std::size_t block_size = FASTCONV_CASCADE_BLOCK)
+         : block_size(std::max<std::size_t>(block_size, 64)), halo(0), compose_below(0),
+           composed_symmetry(Conv1DSymmetry::none)
+   {
+   }
+   inline Conv1DCascade(const std::vector<ConstArrayView1D<FloatType>>& init_kernels,
+         std::size_t block_size = FASTCONV_CASCADE_BLOCK)
+         : Conv1DCascade(block_size)
+   {
+      set_kernels(init_kernels);
+   }
+
+   // Set the stages, in the order they are applied (reverse the kernels and
+   // compose them)
+   inline void set_kernels(const std::vector<ConstArrayView1D<FloatType>>& new_kernels)
+   {
+      if ( new_kernels.empty() )
+      {
+         throw std::invalid_argument("Empty convolution cascade");
+      }
+      kernels.clear();
+      symmetries.clear();
+      halo = 0;
+      std::vector<double> full(1, 1.0);
+      for ( const auto& k : new_kernels )
+      {
+         if ( k.size() == 0 )
+         {
+            throw std::invalid_argument("Empty convolution kernel");
+         }
+         Array1D<FloatType> reversed(k.size());
+         for ( std::size_t i = 0; i < k.size(); i++ )
+         {
+            reversed(i) = k(k.size() - 1 - i);
+         }
+         symmetries.push_back(conv1d_symmetry<FloatType>(reversed));
+         kernels.push_back(std::move(reversed));
+         halo += k.size() - 1;
+
+         // full convolution in double, rounded once at the end
+         std::vector<double> next(full.size() + k.size() - 1, 0.0);
+         for ( std::size_t i = 0; i < full.size(); i++ )
+            for ( std::size_t j = 0; j < k.size(); j++ )
+               next[i + j] += full[i] * double(k(j));
+         full.swap(next);
+      }
+
+      composed = std::move(Array1D<FloatType>(full.size()));
+      for ( std::size_t i = 0; i < full.size(); i++ )
+      {
+         composed(i) = FloatType(full[full.size() - 1 - i]);
+      }
+      composed_symmetry = conv1d_symmetry<FloatType>(composed);
+      compose_below = default_compose_below();
+   }
+
+   // Use the composed kernel for outputs of at most max_outputs samples (0
+   // never composes, so the results always equal the chain of stages). The
+   // default from set_kernels is one tile when the composed kernel has fewer
+   // taps than the stages together, 0 otherwise.
+   inline void set_compose_below(std::size_t max_outputs)
+   {
+      compose_below = max_outputs;
+   }
+
+   inline std::size_t num_stages() const
+   {
+      return kernels.size();
+   }
+
+   // The equivalent single kernel (not reversed)
+   inline Array1D<FloatType> composed_kernel() const
+   {
+      Array1D<FloatType> k(composed.size());
+      for ( std::size_t i = 0; i < k.size(); i++ )
+      {
+         k(i) = composed(composed.size() - 1 - i);
+      }
+      return k;
+   }
+
+   // Compute the output size based on input size (the composed kernel has
+   // halo + 1 taps)
+   inline std::size_t output_size(std::size_t input_size) const
+   {
+      return input_size > halo ? input_size - halo : 0;
+   }
+
+   // Perform the cascade
+   inline Array1D<FloatType> conv(const ConstArrayView1D<FloatType>& x) const
+   {
+      Array1D<FloatType> y(output_size(x.size()));
+      conv_into(x, y);
+      return y;
+   }
+
+   // Perform the cascade into a caller-owned buffer
+   inline void conv_into(const ConstArrayView1D<FloatType>& x, ArrayView1D<FloatType> y) const
+   {
+      FASTCONV_PERF_SCOPE("cascade", halo + 1, y.size());
+      if ( y.size() != output_size(x.size()) )
+      {
+         throw std::runtime_error("Incorrect output size for 1D convolution");
+      }
+      const std::size_t total = y.size();
+      if ( total == 0 )
+         return;
+
+      if ( total <= compose_below )
+      {
+         conv1d_core_parallel<FloatType>(x, composed, y, pool.get(), parallel_threshold, composed_symmetry);
+         return;
+      }
+
+      const std::size_t num_blocks = (total + block_size - 1) / block_size;
+      auto run_block = [&](std::size_t b) {
+         const std::size_t start = b * block_size;
+         const std::size_t end = std::min(start + block_size, total);
+         run_tile(x.view(start, end + halo), y.view(start, end));
+      };
+
+      if ( pool && pool->size() > 1 && total >= parallel_threshold && num_blocks > 1 )
+      {
+         pool->parallel_for(num_blocks, run_block);
+      }
+      else
+      {
+         for ( std::size_t b = 0; b < num_blocks; b++ )
+            run_block(b);
+      }
+   }
+
+ private:
+   // One tile through all stages: stage s reads the previous tile and writes
+   // the next one, the last stage writes y
+   inline void run_tile(ConstArrayView1D<FloatType> x, ArrayView1D<FloatType> y) const
+   {
+      thread_local std::vector<FloatType> buffers[2];
+      // Input of stage s with `size` elements: x, or the tile the previous stage wrote
+      auto stage_input = [&](std::size_t s, std::size_t size) {
+         return s == 0 ? x : ConstArrayView1D<FloatType>(buffers[(s + 1) % 2].data(), size);
+      };
+      std::size_t size = x.size();
+      const std::size_t last = kernels.size() - 1;
+      for ( std::size_t s = 0; s < last; s++ )
+      {
+         const ConstArrayView1D<FloatType> in = stage_input(s, size);
+         size = size - kernels[s].size() + 1;
+         std::vector<FloatType>& buffer = buffers[s % 2];
+         if ( buffer.size() < size )
+            buffer.resize(size);
+         conv1d_core<FloatType>(in, kernels[s], ArrayView1D<FloatType>(buffer.data(), size), symmetries[s]);
+      }
+      conv1d_core<FloatType>(stage_input(last, size), kernels[last], y, symmetries[last]);
+   }
+
+   // Composing pays off for a single tile when it saves taps: the halos of
+   // the stages are then a large part of the work
+   inline std::size_t default_compose_below() const
+   {
+      std::size_t taps = 0;
+      for ( std::size_t s = 0; s < kernels.size(); s++ )
+         taps += folded_taps(kernels[s].size(), symmetries[s]);
+      return folded_taps(composed.size(), composed_symmetry) < taps ? block_size : 0;
+   }
+
+   static inline std::size_t folded_taps(std::size_t size, Conv1DSymmetry symmetry)
+   {
+      return symmetry == Conv1DSymmetry::none ? size : (size + 1) / 2;
+   }
+
+   std::vector<Array1D<FloatType>> kernels; // Reversed kernels of the stages
+   std::vector<Conv1DSymmetry> symmetries;  // Symmetry of each stage
+   Array1D<FloatType> composed;             // Reversed composed kernel
+   std::size_t block_size;                  // Final outputs per tile
+   std::size_t halo;                        // Sum of kernel_size - 1 over the stages
+   std::size_t compose_below;               // Output sizes that use the composed kernel
+   Conv1DSymmetry composed_symmetry;        // Symmetry of the composed kernel
+};
+
+#endif // CONV1D_CASCADE_HPP
@@ -0,0 +1,423 @@
+#ifndef CONV1D_COMPLEX_HPP
+#define CONV1D_COMPLEX_HPP
+
+#include "boundary.hpp"
+#include "core.hpp"
+#include "myarray.hpp"
+#include "parallel.hpp"
+#include "perf.hpp"
+
+#include <algorithm>
+#include <complex>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// Outputs per block of a complex convolution: the split input block (plus the
+// kernel halo) and the partial products stay in L1/L2 while the real
+// convolutions of the block are combined
+#ifndef FASTCONV_COMPLEX_BLOCK
+#define FASTCONV_COMPLEX_BLOCK 2048
+#endif
+
+// Real and imaginary parts of interleaved std::complex samples as strided
+// views (std::complex<T> is laid out as T[2])
+template <typename FloatType>
+inline ConstArrayView1D<FloatType>
+conv1d_real_part(const ConstArrayView1D<std::complex<FloatType>>& x)
+{
+   return {reinterpret_cast<const FloatType*>(x.data_ptr()), x.size(), 2 * x.stride()};
+}
+
+template <typename FloatType>
+inline ConstArrayView1D<FloatType>
+conv1d_imag_part(const ConstArrayView1D<std::complex<FloatType>>& x)
+{
+   return {reinterpret_cast<const FloatType*>(x.data_ptr()) + 1, x.size(), 2 * x.stride()};
+}
+
+template <typename FloatType>
+inline ArrayView1D<FloatType>
+conv1d_real_part(const ArrayView1D<std::complex<FloatType>>& x)
+{
+   return {reinterpret_cast<FloatType*>(x.data_ptr()), x.size(), 2 * x.stride()};
+}
+
+template <typename FloatType>
+inline ArrayView1D<FloatType>
+conv1d_imag_part(const ArrayView1D<std::complex<FloatType>>& x)
+{
+   return {reinterpret_cast<FloatType*>(x.data_ptr()) + 1, x.size(), 2 * x.stride()};
+}
+
+// Whether re and im are the two parts of one interleaved complex array
+template <typename FloatType>
+inline bool
+conv1d_interleaved(const FloatType* re, std::size_t re_stride, const FloatType* im, std::size_t im_stride)
+{
+   return re_stride == 2 && im_stride == 2 && im == re + 1;
+}
+
+// Split n interleaved complex samples into their parts in a single pass, and
+// back
+template <typename FloatType>
+inline void
+conv1d_split(const FloatType* in, FloatType* re, FloatType* im, std::size_t n)
+{
+   for ( std::size_t i = 0; i < n; i++ )
+   {
+      re[i] = in[2 * i];
+      im[i] = in[2 * i + 1];
+   }
+}
+
+template <typename FloatType>
+inline void
+conv1d_interleave(const FloatType* re, const FloatType* im, FloatType* out, std::size_t n)
+{
+   for ( std::size_t i = 0; i < n; i++ )
+   {
+      out[2 * i] = re[i];
+      out[2 * i + 1] = im[i];
+   }
+}
+
+// Class definition for complex convolution (e.g. baseband IQ signals) on
+// split storage: the real and imaginary parts live in separate arrays, so
+// every product is a real convolution through conv1d_core and vectorizes like
+// the real engines. Interleaved std::complex arrays are accepted too and split
+// block by block on the way in and out.
+//
+// A complex kernel costs four real convolutions per output block,
+//    re = kr * xr - ki * xi,   im = ki * xr + kr * xi,
+// or three with set_gauss(true),
+//    t = kr * (xr + xi),   re = t - (kr + ki) * xi,   im = t + (ki - kr) * xr,
+// which saves a quarter of the multiplications but rounds differently (the
+// sums cancel when kr and ki are large). A real kernel (or a complex one
+// whose imaginary part is zero) costs two. Symmetric and antisymmetric
+// kernels are folded.
+template <typename FloatType>
+class Conv1DComplex : public Conv1DParallel
+{
+ public:
+   using Complex = std::complex<FloatType>;
+
+   // Constructor
+   inline Conv1DComplex(bool preserve_shape = false, std::size_t block_size = FASTCONV_COMPLEX_BLOCK)
+         : symmetry_re(Conv1DSymmetry::none), symmetry_im(Conv1DSymmetry::none),
+           symmetry_sum(Conv1DSymmetry::none), symmetry_diff(Conv1DSymmetry::none),
+           preserve_shape(preserve_shape), block_size(std::max<std::size_t>(block_size, 64)),
+           real_kernel(true), gauss(false), boundary(Conv1DBoundary::zero), boundary_value(0)
+   {
+   }
+   inline Conv1DComplex(const ConstArrayView1D<Complex>& init_kernel, bool preserve_shape = false)
+         : Conv1DComplex(preserve_shape)
+   {
+      set_kernel(init_kernel);
+   }
+   inline Conv1DComplex(const ConstArrayView1D<FloatType>& init_kernel, bool preserve_shape = false)
+         : Conv1DComplex(preserve_shape)
+   {
+      set_kernel(init_kernel);
+   }
+
+   // Set an interleaved complex kernel
+   inline void set_kernel(const ConstArrayView1D<Complex>& new_kernel)
+   {
+      set_kernel(conv1d_real_part(new_kernel), conv1d_imag_part(new_kernel));
+   }
+
+   // Set a split complex kernel (reverse both parts)
+   inline void set_kernel(const ConstArrayView1D<FloatType>& new_re,
+         const ConstArrayView1D<FloatType>& new_im)
+   {
+      if ( new_re.size() != new_im.size() )
+      {
+         throw std::invalid_argument("Real and imaginary kernel parts differ in size");
+      }
+      set_parts(new_re, &new_im);
+   }
+
+   // Set a real kernel: two real convolutions per complex output
+   inline void set_kernel(const ConstArrayView1D<FloatType>& new_kernel)
+   {
+      set_parts(new_kernel, nullptr);
+   }
+
+   // Use three real convolutions instead of four for complex kernels
+   inline void set_gauss(bool enable)
+   {
+      gauss = enable;
+   }
+
+   // Whether the kernel is real (two real convolutions per output)
+   inline bool is_real() const
+   {
+      return real_kernel;
+   }
+
+   // How the input is extended for the edge outputs of preserve_shape; the
+   // real and imaginary parts are extended alike, with the parts of value.
+   // The edge outputs always use the four products.
+   inline void set_boundary(Conv1DBoundary mode, Complex value = 0)
+   {
+      boundary = mode;
+      boundary_value = value;
+   }
+
+   // Compute the output size based on input size
+   inline std::size_t output_size(std::size_t input_size) const
+   {
+      return input_size + (preserve_shape ? 0 : 1 - kernel_re.size());
+   }
+
+   // Perform the complex convolution on interleaved samples
+   inline Array1D<Complex> conv(const ConstArrayView1D<Complex>& x) const
+   {
+      Array1D<Complex> y(output_size(x.size()));
+      conv_into(x, y);
+      return y;
+   }
+
+   // Perform the complex convolution on interleaved samples into a
+   // caller-owned buffer
+   inline void conv_into(const ConstArrayView1D<Complex>& x, ArrayView1D<Complex> y) const
+   {
+      conv_into(conv1d_real_part(x), conv1d_imag_part(x), conv1d_real_part(y), conv1d_imag_part(y));
+   }
+
+   // Perform the complex convolution on split samples into caller-owned
+   // buffers; every part may be a strided view
+   inline void conv_into(const ConstArrayView1D<FloatType>& x_re, const ConstArrayView1D<FloatType>& x_im,
+         ArrayView1D<FloatType> y_re, ArrayView1D<FloatType> y_im) const
+   {
+      FASTCONV_PERF_SCOPE("complex", kernel_re.size(), y_re.size());
+      const std::size_t input_size = x_re.size();
+      if ( x_im.size() != input_size || y_re.size() != output_size(input_size)
+            || y_im.size() != y_re.size() )
+      {
+         throw std::runtime_error("Incorrect output size for 1D convolution");
+      }
+
+      const std::size_t kernel_size = kernel_re.size();
+      const std::size_t raw_output_size = input_size >= kernel_size ? input_size - kernel_size + 1 : 0;
+      const std::size_t offset = preserve_shape ? (kernel_size - 1) / 2 : 0;
+
+      if ( raw_output_size > 0 )
+      {
+         ArrayView1D<FloatType> out_re = y_re.view(offset, offset + raw_output_size);
+         ArrayView1D<FloatType> out_im = y_im.view(offset, offset + raw_output_size);
+         if ( real_kernel && x_re.contiguous() && x_im.contiguous() && out_re.contiguous()
+               && out_im.contiguous() )
+         {
+            // the parts are independent: two plain real convolutions
+            conv1d_core_parallel<FloatType>(x_re, kernel_re, out_re, pool.get(), parallel_threshold,
+                  symmetry_re);
+            conv1d_core_parallel<FloatType>(x_im, kernel_re, out_im, pool.get(), parallel_threshold,
+                  symmetry_re);
+         }
+         else
+         {
+            run_blocks(x_re, x_im, out_re, out_im);
+         }
+      }
+      if ( preserve_shape )
+      {
+         run_edges(x_re, x_im, y_re, y_im, 0, std::min(offset, input_size));
+         run_edges(x_re, x_im, y_re, y_im, std::max(offset + raw_output_size, std::min(offset, input_size)),
+               input_size);
+      }
+   }
+
+ private:
+   inline void set_parts(const ConstArrayView1D<FloatType>& new_re,
+         const ConstArrayView1D<FloatType>* new_im)
+   {
+      const std::size_t kernel_size = new_re.size();
+      kernel_re = std::move(Array1D<FloatType>(kernel_size));
+      kernel_im = std::move(Array1D<FloatType>(kernel_size));
+      real_kernel = true;
+      for ( std::size_t i = 0; i < kernel_size; i++ )
+      {
+         kernel_re(i) = new_re(kernel_size - 1 - i);
+         kernel_im(i) = new_im ? (*new_im)(kernel_size - 1 - i) : FloatType(0);
+         real_kernel = real_kernel && kernel_im(i) == FloatType(0);
+      }
+
+      // kernels of the Gauss products
+      kernel_sum = std::move(Array1D<FloatType>(kernel_size));
+      kernel_diff = std::move(Array1D<FloatType>(kernel_size));
+      for ( std::size_t i = 0; i < kernel_size; i++ )
+      {
+         kernel_sum(i) = kernel_re(i) + kernel_im(i);
+         kernel_diff(i) = kernel_im(i) - kernel_re(i);
+      }
+      symmetry_re = conv1d_symmetry<FloatType>(kernel_re);
+      symmetry_im = conv1d_symmetry<FloatType>(kernel_im);
+      symmetry_sum = conv1d_symmetry<FloatType>(kernel_sum);
+      symmetry_diff = conv1d_symmetry<FloatType>(kernel_diff);
+   }
+
+   // Valid outputs block by block (on the pool when large enough)
+   inline void run_blocks(const ConstArrayView1D<FloatType>& x_re, const ConstArrayView1D<FloatType>& x_im,
+         ArrayView1D<FloatType> y_re, ArrayView1D<FloatType> y_im) const
+   {
+      const std::size_t total = y_re.size();
+      const std::size_t halo = kernel_re.size() - 1;
+      const std::size_t num_blocks = (total + block_size - 1) / block_size;
+      auto run_block = [&](std::size_t b) {
+         const std::size_t start = b * block_size;
+         const std::size_t end = std::min(start + block_size, total);
+         run_block_products(x_re.view(start, end + halo), x_im.view(start, end + halo),
+               y_re.view(start, end), y_im.view(start, end));
+      };
+
+      if ( pool && pool->size() > 1 && total >= parallel_threshold && num_blocks > 1 )
+      {
+         pool->parallel_for(num_blocks, run_block);
+      }
+      else
+      {
+         for ( std::size_t b = 0; b < num_blocks; b++ )
+            run_block(b);
+      }
+   }
+
+   // One block: strided (e.g. interleaved) inputs and outputs are split into
+   // contiguous per-thread buffers once, the real convolutions and their
+   // combination run on those
+   inline void run_block_products(const ConstArrayView1D<FloatType>& x_re,
+         const ConstArrayView1D<FloatType>& x_im, ArrayView1D<FloatType> y_re,
+         ArrayView1D<FloatType> y_im) const
+   {
+      thread_local std::vector<FloatType> in_re, in_im, in_sum, out_re, out_im, partial;
+      const std::size_t length = x_re.size(), n = y_re.size();
+      auto input = [&](const ConstArrayView1D<FloatType>& x, std::vector<FloatType>& buffer) {
+         if ( x.contiguous() )
+            return x;
+         buffer.resize(length);
+         conv1d_gather<FloatType>(x, buffer.data());
+         return ConstArrayView1D<FloatType>(buffer.data(), length);
+      };
+      auto output = [&](const ArrayView1D<FloatType>& y, std::vector<FloatType>& buffer) {
+         if ( y.contiguous() )
+            return y;
+         buffer.resize(n);
+         return ArrayView1D<FloatType>(buffer.data(), n);
+      };
+      // interleaved parts are split in one pass instead of two gathers
+      const bool interleaved
+            = conv1d_interleaved(x_re.data_ptr(), x_re.stride(), x_im.data_ptr(), x_im.stride());
+      if ( interleaved )
+      {
+         in_re.resize(length);
+         in_im.resize(length);
+         conv1d_split(x_re.data_ptr(), in_re.data(), in_im.data(), length);
+      }
+      const ConstArrayView1D<FloatType> a = interleaved ? ConstArrayView1D<FloatType>(in_re.data(), length)
+                                                        : input(x_re, in_re);
+      const ConstArrayView1D<FloatType> b = interleaved ? ConstArrayView1D<FloatType>(in_im.data(), length)
+                                                        : input(x_im, in_im);
+      const ArrayView1D<FloatType> re = output(y_re, out_re), im = output(y_im, out_im);
+      FloatType* yr = re.data_ptr();
+      FloatType* yi = im.data_ptr();
+      partial.resize(n);
+      FloatType* p = partial.data();
+      const ArrayView1D<FloatType> vp(p, n);
+
+      if ( real_kernel )
+      {
+         conv1d_core<FloatType>(a, kernel_re, re, symmetry_re);
+         conv1d_core<FloatType>(b, kernel_re, im, symmetry_re);
+      }
+      else if ( gauss )
+      {
+         in_sum.resize(length);
+         const FloatType* ap = a.data_ptr();
+         const FloatType* bp = b.data_ptr();
+         for ( std::size_t i = 0; i < length; i++ )
+            in_sum[i] = ap[i] + bp[i];
+
+         // p = kr * (xr + xi), re = p - (kr + ki) * xi, im = p + (ki - kr) * xr
+         conv1d_core<FloatType>(ConstArrayView1D<FloatType>(in_sum.data(), length), kernel_re, vp,
+               symmetry_re);
+         conv1d_core<FloatType>(b, kernel_sum, re, symmetry_sum);
+         conv1d_core<FloatType>(a, kernel_diff, im, symmetry_diff);
+         for ( std::size_t i = 0; i < n; i++ )
+         {
+            yr[i] = p[i] - yr[i];
+            yi[i] = p[i] + yi[i];
+         }
+      }
+      else
+      {
+         conv1d_core<FloatType>(a, kernel_re, re, symmetry_re);
+         conv1d_core<FloatType>(b, kernel_im, vp, symmetry_im);
+         for ( std::size_t i = 0; i < n; i++ )
+            yr[i] -= p[i];
+         conv1d_core<FloatType>(a, kernel_im, im, symmetry_im);
+         conv1d_core<FloatType>(b, kernel_re, vp, symmetry_re);
+         for ( std::size_t i = 0; i < n; i++ )
+            yi[i] += p[i];
+      }
+
+      if ( conv1d_interleaved<FloatType>(y_re.data_ptr(), y_re.stride(), y_im.data_ptr(), y_im.stride()) )
+      {
+         conv1d_interleave(yr, yi, y_re.data_ptr(), n);
+         return;
+      }
+      if ( !y_re.contiguous() )
+         conv1d_scatter<FloatType>(yr, y_re);
+      if ( !y_im.contiguous() )
+         conv1d_scatter<FloatType>(yi, y_im);
+   }
+
+   // Edge outputs [begin, end) of preserve_shape, from the four products of
+   // the extended parts
+   inline void run_edges(const ConstArrayView1D<FloatType>& x_re, const ConstArrayView1D<FloatType>& x_im,
+         ArrayView1D<FloatType> y_re, ArrayView1D<FloatType> y_im, std::size_t begin, std::size_t end) const
+   {
+      if ( begin >= end || boundary == Conv1DBoundary::none )
+         return;
+      const std::size_t n = end - begin;
+      std::vector<FloatType> p(n), q(n);
+      ArrayView1D<FloatType> vp(p.data(), n), vq(q.data(), n);
+      const FloatType value_re = boundary_value.real(), value_im = boundary_value.imag();
+
+      conv1d_boundary_range<FloatType>(x_re, kernel_re, vp, begin, boundary, value_re, symmetry_re);
+      if ( real_kernel )
+      {
+         conv1d_boundary_range<FloatType>(x_im, kernel_re, vq, begin, boundary, value_im, symmetry_re);
+         for ( std::size_t i = 0; i < n; i++ )
+         {
+            y_re(begin + i) = p[i];
+            y_im(begin + i) = q[i];
+         }
+         return;
+      }
+      conv1d_boundary_range<FloatType>(x_im, kernel_im, vq, begin, boundary, value_im, symmetry_im);
+      for ( std::size_t i = 0; i < n; i++ )
+         y_re(begin + i) = p[i] - q[i];
+      conv1d_boundary_range<FloatType>(x_re, kernel_im, vp, begin, boundary, value_re, symmetry_im);
+      conv1d_boundary_range<FloatType>(x_im, kernel_re, vq, begin, boundary, value_im, symmetry_re);
+      for ( std::size_t i = 0; i < n; i++ )
+         y_im(begin + i) = p[i] + q[i];
+   }
+
+   Array1D<FloatType> kernel_re;   // Reversed real part of the kernel
+   Array1D<FloatType> kernel_im;   // Reversed imaginary part of the kernel
+   Array1D<FloatType> kernel_sum;  // kernel_re + kernel_im (Gauss products)
+   Array1D<FloatType> kernel_diff; // kernel_im - kernel_re (Gauss products)
+   Conv1DSymmetry symmetry_re;     // Symmetry of kernel_re
+   Conv1DSymmetry symmetry_im;     // Symmetry of kernel_im
+   Conv1DSymmetry symmetry_sum;    // Symmetry of kernel_sum
+   Conv1DSymmetry symmetry_diff;   // Symmetry of kernel_diff
+   bool preserve_shape;            // Preserve shape of the input/output
+   std::size_t block_size;         // Outputs per block
+   bool real_kernel;               // Imaginary part of the kernel is zero
+   bool gauss;                     // Three real convolutions instead of four
+   Conv1DBoundary boundary;        // Extension of the input for the edge outputs
+   Complex boundary_value;         // Value of Conv1DBoundary::constant
+};
+
+#endif // CONV1D_COMPLEX_HPP
@@ -3,6 +3,7 @@
 
 #include "conv_base.hpp"
 #include "myarray.hpp"
+#include "myarray2d.hpp"
 #include <cmath>
 #include <cstdint>
 #include <memory>
@@ -20,6 +21,31 @@ class Conv1DBase : ConvBase
    virtual void set_kernel(const ConstArrayView1D<FloatType>& k) = 0;
    virtual std::size_t output_size(std::size_t input_size) const = 0;
    virtual Array1D<FloatType> conv(const ConstArrayView1D<FloatType>& input) const = 0;
+   // Write the result into a caller-owned buffer of size output_size(input.size())
+   virtual void conv_into(const ConstArrayView1D<FloatType>& input,
+         ArrayView1D<FloatType> output) const = 0;
+
+   // Convolve every row of a (channels x samples) batch with the kernel. The
+   // default runs conv_into row by row; engines may block across rows.
+   virtual void conv_batch_into(const ConstArrayView2D<FloatType>& input,
+         ArrayView2D<FloatType> output) const
+   {
+      if ( output.rows() != input.rows() )
+      {
+         throw std::runtime_error("Incorrect output shape for batched 1D convolution");
+      }
+      for ( std::size_t r = 0; r < input.rows(); r++ )
+      {
+         conv_into(input.row(r), output.row(r));
+      }
+   }
+
+   inline Array2D<FloatType> conv_batch(const ConstArrayView2D<FloatType>& input) const
+   {
+      Array2D<FloatType> output(input.rows(), output_size(input.cols()));
+      conv_batch_into(input, output);
+      return output;
+   }
 };
 
 #endif // CONV1D_H
@@ -0,0 +1,244 @@
+#ifndef CONV1D_CONVERT_HPP
+#define CONV1D_CONVERT_HPP
+
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// _Float16 is available with GCC >= 12 and Clang on x86-64
+#if defined(__FLT16_MAX__)
+#define FASTCONV_HAS_FLOAT16 1
+#endif
+
+// bfloat16: the upper 16 bits of an IEEE single, converted with
+// round-to-nearest-even
+struct BFloat16
+{
+   std::uint16_t bits;
+
+   BFloat16() = default;
+   inline explicit BFloat16(float f)
+         : bits(from_float(f))
+   {
+   }
+
+   inline explicit operator float() const
+   {
+      const std::uint32_t u = std::uint32_t(bits) << 16;
+      float f;
+      std::memcpy(&f, &u, sizeof(f));
+      return f;
+   }
+
+   static inline std::uint16_t from_float(float f)
+   {
+      std::uint32_t u;
+      std::memcpy(&u, &f, sizeof(u));
+      if ( (u & 0x7fffffffu) > 0x7f800000u )
+         return std::uint16_t((u >> 16) | 0x40); // keep NaNs quiet
+      return std::uint16_t((u + 0x7fffu + ((u >> 16) & 1)) >> 16);
+   }
+};
+
+// Scalar conversions to and from float; int16_t rounds to nearest even and
+// saturates. The vectorized loops below give the same results.
+template <typename T>
+inline float
+conv1d_to_float(T v)
+{
+   return static_cast<float>(v);
+}
+
+template <typename T>
+inline T
+conv1d_from_float(float v)
+{
+   if constexpr ( std::is_same_v<T, std::int16_t> )
+   {
+      // clamp like maxps/minps, which also send NaN to -32768
+      v = v > -32768.0f ? v : -32768.0f;
+      v = v < 32767.0f ? v : 32767.0f;
+      return static_cast<std::int16_t>(std::nearbyint(v));
+   }
+   else
+      return static_cast<T>(v);
+}
+
+// 16-bit storage types with vectorized conversions
+template <typename T>
+constexpr bool conv1d_is_16bit = std::is_same_v<T, BFloat16> || std::is_same_v<T, std::int16_t>
+#ifdef FASTCONV_HAS_FLOAT16
+      || std::is_same_v<T, _Float16>
+#endif
+      ;
+
+template <typename Src, typename Dst>
+void
+conv1d_convert_scalar(const Src* src, Dst* dst, std::size_t n)
+{
+   for ( std::size_t i = 0; i < n; i++ )
+   {
+      if constexpr ( std::is_same_v<Dst, float> )
+         dst[i] = conv1d_to_float(src[i]);
+      else
+         dst[i] = conv1d_from_float<Dst>(src[i]);
+   }
+}
+
+#ifdef FASTCONV_X86
+
+// Eight lanes per step with AVX2 and F16C, the remainder is scalar
+template <typename Src, typename Dst>
+__attribute__((target("avx2,f16c"))) void
+conv1d_convert_avx2(const Src* src, Dst* dst, std::size_t n)
+{
+   constexpr std::size_t W = 8;
+   std::size_t i = 0;
+   for ( ; i + W <= n; i += W )
+   {
+      if constexpr ( std::is_same_v<Dst, float> )
+      {
+         const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+         __m256 v;
+         if constexpr ( std::is_same_v<Src, BFloat16> )
+            v = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+         else if constexpr ( std::is_same_v<Src, std::int16_t> )
+            v = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(h));
+         else
+            v = _mm256_cvtph_ps(h);
+         _mm256_storeu_ps(dst + i, v);
+      }
+      else
+      {
+         const __m256 v = _mm256_loadu_ps(src + i);
+         __m256i r;
+         if constexpr ( std::is_same_v<Dst, BFloat16> )
+         {
+            const __m256i u = _mm256_castps_si256(v);
+            const __m256i odd = _mm256_and_si256(_mm256_srli_epi32(u, 16), _mm256_set1_epi32(1));
+            const __m256i rounded = _mm256_srli_epi32(_mm256_add_epi32(u, _mm256_add_epi32(odd,
+                  _mm256_set1_epi32(0x7fff))), 16);
+            const __m256i quiet = _mm256_or_si256(_mm256_srli_epi32(u, 16), _mm256_set1_epi32(0x40));
+            const __m256i nan = _mm256_cmpgt_epi32(_mm256_and_si256(u, _mm256_set1_epi32(0x7fffffff)),
+                  _mm256_set1_epi32(0x7f800000));
+            r = _mm256_packus_epi32(_mm256_blendv_epi8(rounded, quiet, nan), _mm256_setzero_si256());
+         }
+         else if constexpr ( std::is_same_v<Dst, std::int16_t> )
+         {
+            const __m256 clamped = _mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(-32768.0f)),
+                  _mm256_set1_ps(32767.0f));
+            r = _mm256_packs_epi32(_mm256_cvtps_epi32(clamped), _mm256_setzero_si256());
+         }
+         else
+         {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                  _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+            continue;
+         }
+         // the packs work per 128-bit lane, gather the two useful quarters
+         r = _mm256_permute4x64_epi64(r, 0x08);
+         _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_castsi256_si128(r));
+      }
+   }
+   conv1d_convert_scalar(src + i, dst + i, n - i);
+}
+
+// Sixteen lanes per step with AVX-512F
+template <typename Src, typename Dst>
+__attribute__((target("avx512f"))) void
+conv1d_convert_avx512(const Src* src, Dst* dst, std::size_t n)
+{
+   constexpr std::size_t W = 16;
+   std::size_t i = 0;
+   for ( ; i + W <= n; i += W )
+   {
+      if constexpr ( std::is_same_v<Dst, float> )
+      {
+         const __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+         __m512 v;
+         if constexpr ( std::is_same_v<Src, BFloat16> )
+            v = _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(h), 16));
+         else if constexpr ( std::is_same_v<Src, std::int16_t> )
+            v = _mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(h));
+         else
+            v = _mm512_cvtph_ps(h);
+         _mm512_storeu_ps(dst + i, v);
+      }
+      else
+      {
+         const __m512 v = _mm512_loadu_ps(src + i);
+         __m256i r;
+         if constexpr ( std::is_same_v<Dst, BFloat16> )
+         {
+            const __m512i u = _mm512_castps_si512(v);
+            const __m512i odd = _mm512_and_si512(_mm512_srli_epi32(u, 16), _mm512_set1_epi32(1));
+            const __m512i rounded = _mm512_srli_epi32(_mm512_add_epi32(u, _mm512_add_epi32(odd,
+                  _mm512_set1_epi32(0x7fff))), 16);
+            const __m512i quiet = _mm512_or_si512(_mm512_srli_epi32(u, 16), _mm512_set1_epi32(0x40));
+            const __m512i magnitude = _mm512_and_si512(u, _mm512_set1_epi32(0x7fffffff));
+            const __mmask16 nan = _mm512_cmpgt_epi32_mask(magnitude, _mm512_set1_epi32(0x7f800000));
+            r = _mm512_cvtepi32_epi16(_mm512_mask_blend_epi32(nan, rounded, quiet));
+         }
+         else if constexpr ( std::is_same_v<Dst, std::int16_t> )
+         {
+            const __m512 clamped = _mm512_min_ps(_mm512_max_ps(v, _mm512_set1_ps(-32768.0f)),
+                  _mm512_set1_ps(32767.0f));
+            r = _mm512_cvtsepi32_epi16(_mm512_cvtps_epi32(clamped));
+         }
+         else
+         {
+            r = _mm512_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+         }
+         _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), r);
+      }
+   }
+   conv1d_convert_scalar(src + i, dst + i, n - i);
+}
+
+#endif // FASTCONV_X86
+
+template <typename Src, typename Dst>
+using Conv1DConvertFn = void (*)(const Src* src, Dst* dst, std::size_t n);
+
+// Conversion loop for the instruction set detected at runtime. The vector
+// loops cover float to and from _Float16, BFloat16 and int16_t.
+template <typename Src, typename Dst>
+Conv1DConvertFn<Src, Dst>
+conv1d_convert_kernel()
+{
+   static_assert(std::is_same_v<Src, float> || std::is_same_v<Dst, float>, "One side must be float");
+#ifdef FASTCONV_X86
+   constexpr bool vectorized = (std::is_same_v<Src, float> && conv1d_is_16bit<Dst>)
+         || (conv1d_is_16bit<Src> && std::is_same_v<Dst, float>);
+   if constexpr ( vectorized )
+   {
+      static const Conv1DConvertFn<Src, Dst> kernel = []() -> Conv1DConvertFn<Src, Dst> {
+         if ( simd_isa() == SimdIsa::avx512 )
+            return &conv1d_convert_avx512<Src, Dst>;
+         if ( simd_isa() == SimdIsa::avx2 && __builtin_cpu_supports("f16c") )
+            return &conv1d_convert_avx2<Src, Dst>;
+         return &conv1d_convert_scalar<Src, Dst>;
+      }();
+      return kernel;
+   }
+#endif
+   return &conv1d_convert_scalar<Src, Dst>;
+}
+
+// Convert n values, one side being float
+template <typename Src, typename Dst>
+inline void
+conv1d_convert(const Src* src, Dst* dst, std::size_t n)
+{
+   if constexpr ( std::is_same_v<Src, Dst> )
+      std::copy(src, src + n, dst);
+   else
+      conv1d_convert_kernel<Src, Dst>()(src, dst, n);
+}
+
+#endif // CONV1D_CONVERT_HPP
@@ -2,7 +2,10 @@
 #define CONV1D_CORE_HPP
 
 #include "myarray.hpp"
+#include "dispatch.hpp"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
 #include <stdexcept>
 #include <vector>
@@ -44,16 +47,75 @@ void conv1d_km(ConstArrayView1D<FloatType> x, ConstArrayView1D<FloatType> k, Arr
    }
 }
 
-// A generic function for 1D convolution
+// Mirror symmetry of a kernel: k(K - 1 - i) == k(i) or == -k(i)
+enum class Conv1DSymmetry
+{
+   none,
+   symmetric,
+   antisymmetric
+};
+
+// Detect the symmetry of a kernel; pairs may differ by up to tolerance times
+// the largest tap magnitude (0 requires exact symmetry). Kernels shorter than
+// 2 taps have nothing to fold.
+template <typename FloatType>
+Conv1DSymmetry
+conv1d_symmetry(ConstArrayView1D<FloatType> k, FloatType tolerance = 0)
+{
+   const std::size_t kernel_size = k.size();
+   if ( kernel_size < 2 )
+      return Conv1DSymmetry::none;
+
+   FloatType scale = 0;
+   for ( std::size_t i = 0; i < kernel_size; i++ )
+      scale = std::max<FloatType>(scale, std::abs(k(i)));
+   const FloatType limit = tolerance * scale;
+
+   bool symmetric = true, antisymmetric = true;
+   for ( std::size_t i = 0; i <= kernel_size / 2; i++ )
+   {
+      const FloatType a = k(i), b = k(kernel_size - 1 - i);
+      symmetric = symmetric && std::abs(a - b) <= limit;
+      antisymmetric = antisymmetric && std::abs(a + b) <= limit;
+   }
+   if ( symmetric )
+      return Conv1DSymmetry::symmetric;
+   if ( antisymmetric )
+      return Conv1DSymmetry::antisymmetric;
+   return Conv1DSymmetry::none;
+}
+
+// Outputs per block of the strided path of conv1d_core: the gathered input
+// block (plus the kernel halo) and the output block stay in L1
+#ifndef FASTCONV_GATHER_BLOCK
+#define FASTCONV_GATHER_BLOCK 2048
+#endif
+
+// conv1d_core on contiguous views (unit stride), sizes already checked
 template <typename FloatType>
-void conv1d_core(ConstArrayView1D<FloatType> x, ConstArrayView1D<FloatType> k, ArrayView1D<FloatType> y)
+void conv1d_core_unit(ConstArrayView1D<FloatType> x, ConstArrayView1D<FloatType> k,
+      ArrayView1D<FloatType> y, Conv1DSymmetry symmetry)
 {
    const auto kernel_size = k.size();
-   const auto output_size = x.size() - kernel_size + 1;
+   const auto output_size = y.size();
 
-   if ( y.size() != output_size )
+   if ( symmetry != Conv1DSymmetry::none )
    {
-      throw std::runtime_error("Incorrect output shape for 1D convolution");
+      const auto& folded = symmetry == Conv1DSymmetry::symmetric
+            ? conv1d_folded_kernel_table<FloatType, false>()
+            : conv1d_folded_kernel_table<FloatType, true>();
+      folded[kernel_size < folded.size() ? kernel_size : 0](x.data_ptr(), k.data_ptr(), y.data_ptr(),
+            kernel_size, output_size);
+      return;
+   }
+
+   // unrolled (and for float, vectorized) kernels selected once per call
+   const auto& table = conv1d_kernel_table<FloatType>();
+   const auto kernel = kernel_size < table.size() ? table[kernel_size] : table[0];
+   if ( kernel )
+   {
+      kernel(x.data_ptr(), k.data_ptr(), y.data_ptr(), kernel_size, output_size);
+      return;
    }
 
    if ( kernel_size % 16 == 0 )
@@ -81,4 +143,136 @@ void conv1d_core(ConstArrayView1D<FloatType> x, ConstArrayView1D<FloatType> k, A
    }
 }
 
+// Copy the elements of a (strided) view to contiguous memory and back; the
+// stride of interleaved pairs (e.g. std::complex) gets a loop of its own that
+// the compiler vectorizes
+template <typename FloatType>
+inline void conv1d_gather(ConstArrayView1D<FloatType> x, FloatType* out)
+{
+   const FloatType* in = x.data_ptr();
+   const std::size_t n = x.size(), stride = x.stride();
+   if ( stride == 2 )
+   {
+      for ( std::size_t i = 0; i < n; i++ )
+         out[i] = in[2 * i];
+   }
+   else
+   {
+      for ( std::size_t i = 0; i < n; i++ )
+         out[i] = in[i * stride];
+   }
+}
+
+template <typename FloatType>
+inline void conv1d_scatter(const FloatType* in, ArrayView1D<FloatType> y)
+{
+   FloatType* out = y.data_ptr();
+   const std::size_t n = y.size(), stride = y.stride();
+   if ( stride == 2 )
+   {
+      for ( std::size_t i = 0; i < n; i++ )
+         out[2 * i] = in[i];
+   }
+   else
+   {
+      for ( std::size_t i = 0; i < n; i++ )
+         out[i * stride] = in[i];
+   }
+}
+
+// conv1d_core on strided views: a strided kernel is copied once, the input is
+// gathered block by block (with the kernel_size - 1 samples of halo) into a
+// per-thread buffer, and a strided output is written through a buffer that is
+// scattered afterwards. The blocks run through the unit-stride kernels, which
+// do not depend on how the output range is split, so the results equal those
+// of contiguous copies.
+template <typename FloatType>
+void conv1d_core_gather(ConstArrayView1D<FloatType> x, ConstArrayView1D<FloatType> k,
+      ArrayView1D<FloatType> y, Conv1DSymmetry symmetry)
+{
+   thread_local std::vector<FloatType> kernel_buffer, input_buffer, output_buffer;
+   const std::size_t kernel_size = k.size();
+   const std::size_t output_size = y.size();
+
+   ConstArrayView1D<FloatType> kernel = k;
+   if ( !k.contiguous() )
+   {
+      kernel_buffer.resize(kernel_size);
+      conv1d_gather<FloatType>(k, kernel_buffer.data());
+      kernel = ConstArrayView1D<FloatType>(kernel_buffer.data(), kernel_size);
+   }
+
+   constexpr std::size_t B = FASTCONV_GATHER_BLOCK;
+   for ( std::size_t o = 0; o < output_size; o += B )
+   {
+      const std::size_t n = std::min(B, output_size - o);
+      ConstArrayView1D<FloatType> in = x.view(o, o + n + kernel_size - 1);
+      if ( !x.contiguous() )
+      {
+         input_buffer.resize(n + kernel_size - 1);
+         conv1d_gather<FloatType>(in, input_buffer.data());
+         in = ConstArrayView1D<FloatType>(input_buffer.data(), input_buffer.size());
+      }
+
+      ArrayView1D<FloatType> out = y.view(o, o + n);
+      if ( y.contiguous() )
+      {
+         conv1d_core_unit<FloatType>(in, kernel, out, symmetry);
+      }
+      else
+      {
+         output_buffer.resize(n);
+         conv1d_core_unit<FloatType>(in, kernel, ArrayView1D<FloatType>(output_buffer.data(), n), symmetry);
+         conv1d_scatter<FloatType>(output_buffer.data(), out);
+      }
+   }
+}
+
+// A generic function for 1D convolution. With a symmetry, the folded kernels
+// are used and only the first half of k (rounded up) is read. Any of x, k and
+// y may be strided views (e.g. a column of a 2D array), contiguous views take
+// the unit-stride kernels directly.
+template <typename FloatType>
+void conv1d_core(ConstArrayView1D<FloatType> x, ConstArrayView1D<FloatType> k, ArrayView1D<FloatType> y,
+      Conv1DSymmetry symmetry = Conv1DSymmetry::none)
+{
+   const auto kernel_size = k.size();
+   const auto output_size = x.size() - kernel_size + 1;
+
+   if ( y.size() != output_size )
+   {
+      throw std::runtime_error("Incorrect output shape for 1D convolution");
+   }
+
+   if ( x.contiguous() && k.contiguous() && y.contiguous() )
+      conv1d_core_unit<FloatType>(x, k, y, symmetry);
+   else
+      conv1d_core_gather<FloatType>(x, k, y, symmetry);
+}
+
+// Run fn(x, y) on contiguous views of x and y, for the engines whose kernels
+// take raw pointers: strided views are copied to temporaries first (y too, so
+// that the outputs fn does not write keep their values) and y is copied back
+// afterwards. Contiguous views are passed through.
+template <typename InType, typename OutType, typename Fn>
+void conv1d_contiguous(ConstArrayView1D<InType> x, ArrayView1D<OutType> y, const Fn& fn)
+{
+   if ( x.contiguous() && y.contiguous() )
+   {
+      fn(x, y);
+      return;
+   }
+
+   Array1D<InType> x_copy(x.contiguous() ? 0 : x.size());
+   Array1D<OutType> y_copy(y.contiguous() ? 0 : y.size());
+   for ( std::size_t i = 0; i < x_copy.size(); i++ )
+      x_copy(i) = x(i);
+   for ( std::size_t i = 0; i < y_copy.size(); i++ )
+      y_copy(i) = y(i);
+   fn(x.contiguous() ? x : ConstArrayView1D<InType>(x_copy),
+         y.contiguous() ? y : ArrayView1D<OutType>(y_copy));
+   for ( std::size_t i = 0; i < y_copy.size(); i++ )
+      y(i) = y_copy(i);
+}
+
 #endif // CONV1D_CORE_HPP
@@ -0,0 +1,260 @@
+#ifndef CONV1D_DISPATCH_HPP
+#define CONV1D_DISPATCH_HPP
+
+#include "simd.hpp"
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+// Kernels of length 1..FASTCONV_MAX_FIXED_KERNEL are compiled as fully
+// unrolled specializations. Longer kernels use the generic loops.
+#ifndef FASTCONV_MAX_FIXED_KERNEL
+#define FASTCONV_MAX_FIXED_KERNEL 32
+#endif
+
+// Signature shared by all raw kernels: y(i) = sum_j k(j) * x(i + j)
+template <typename FloatType>
+using Conv1DKernelFn = void (*)(const FloatType* x, const FloatType* k, FloatType* y,
+      std::size_t kernel_size, std::size_t output_size);
+
+// Entry 0 holds the kernel for arbitrary sizes (nullptr if there is none),
+// entry K the specialization for kernel size K.
+template <typename FloatType>
+using Conv1DKernelTable = std::array<Conv1DKernelFn<FloatType>, FASTCONV_MAX_FIXED_KERNEL + 1>;
+
+template <typename FloatType, std::size_t... J>
+FASTCONV_EXACT_FP inline FloatType
+conv1d_dot(const FloatType* x, const FloatType* k, std::index_sequence<J...>)
+{
+   return (FloatType(0) + ... + (k[J] * x[J]));
+}
+
+// Scalar kernel for a compile-time kernel size, the tap loop is fully unrolled
+template <typename FloatType, std::size_t K>
+FASTCONV_EXACT_FP void
+conv1d_fixed(const FloatType* x, const FloatType* k, FloatType* y, std::size_t, std::size_t output_size)
+{
+   for ( std::size_t i = 0; i < output_size; ++i )
+   {
+      y[i] = conv1d_dot<FloatType>(x + i, k, std::make_index_sequence<K>{});
+   }
+}
+
+template <typename FloatType, std::size_t... K>
+constexpr Conv1DKernelTable<FloatType>
+conv1d_make_scalar_table(std::index_sequence<K...>)
+{
+   return {nullptr, &conv1d_fixed<FloatType, K + 1>...};
+}
+
+#ifdef FASTCONV_X86
+
+template <std::size_t... K>
+constexpr Conv1DKernelTable<float>
+conv1d_make_simd_table(SimdIsa isa, std::index_sequence<K...>)
+{
+   switch ( isa )
+   {
+   case SimdIsa::avx512:
+      return {&conv1d_avx512<0>, &conv1d_avx512<K + 1>...};
+   case SimdIsa::avx2:
+      return {&conv1d_avx2<0>, &conv1d_avx2<K + 1>...};
+   default:
+      return {&conv1d_sse<0>, &conv1d_sse<K + 1>...};
+   }
+}
+
+#endif // FASTCONV_X86
+
+// Kernel table for the instruction set detected at runtime
+template <typename FloatType>
+const Conv1DKernelTable<FloatType>&
+conv1d_kernel_table()
+{
+   using Sizes = std::make_index_sequence<FASTCONV_MAX_FIXED_KERNEL>;
+#ifdef FASTCONV_X86
+   if constexpr ( std::is_same_v<FloatType, float> )
+   {
+      static const Conv1DKernelTable<float> table = simd_isa() == SimdIsa::scalar
+            ? conv1d_make_scalar_table<float>(Sizes{})
+            : conv1d_make_simd_table(simd_isa(), Sizes{});
+      return table;
+   }
+#endif
+   static const Conv1DKernelTable<FloatType> table = conv1d_make_scalar_table<FloatType>(Sizes{});
+   return table;
+}
+
+// Scalar folded kernel for a compile-time kernel size (see the SIMD folded
+// kernels for the formula); K = 0 loops over kernel_size
+template <typename FloatType, std::size_t K, bool Anti>
+FASTCONV_EXACT_FP void
+conv1d_fixed_folded(const FloatType* x, const FloatType* k, FloatType* y, std::size_t kernel_size,
+      std::size_t output_size)
+{
+   const std::size_t ks = K > 0 ? K : kernel_size;
+   const std::size_t half = ks / 2;
+   for ( std::size_t i = 0; i < output_size; ++i )
+   {
+      FloatType total = 0;
+      for ( std::size_t j = 0; j < half; ++j )
+      {
+         total += k[j] * (Anti ? x[i + j] - x[i + ks - 1 - j] : x[i + j] + x[i + ks - 1 - j]);
+      }
+      if ( !Anti && ks % 2 == 1 )
+         total += k[half] * x[i + half];
+      y[i] = total;
+   }
+}
+
+template <typename FloatType, bool Anti, std::size_t... K>
+constexpr Conv1DKernelTable<FloatType>
+conv1d_make_scalar_folded_table(std::index_sequence<K...>)
+{
+   return {&conv1d_fixed_folded<FloatType, 0, Anti>, &conv1d_fixed_folded<FloatType, K + 1, Anti>...};
+}
+
+#ifdef FASTCONV_X86
+
+template <bool Anti, std::size_t... K>
+constexpr Conv1DKernelTable<float>
+conv1d_make_simd_folded_table(SimdIsa isa, std::index_sequence<K...>)
+{
+   switch ( isa )
+   {
+   case SimdIsa::avx512:
+      return {&conv1d_avx512_folded<0, Anti>, &conv1d_avx512_folded<K + 1, Anti>...};
+   case SimdIsa::avx2:
+      return {&conv1d_avx2_folded<0, Anti>, &conv1d_avx2_folded<K + 1, Anti>...};
+   default:
+      return {&conv1d_sse_folded<0, Anti>, &conv1d_sse_folded<K + 1, Anti>...};
+   }
+}
+
+#endif // FASTCONV_X86
+
+// Folded kernel table (symmetric or antisymmetric kernels) for the
+// instruction set detected at runtime; every entry is set
+template <typename FloatType, bool Anti>
+const Conv1DKernelTable<FloatType>&
+conv1d_folded_kernel_table()
+{
+   using Sizes = std::make_index_sequence<FASTCONV_MAX_FIXED_KERNEL>;
+#ifdef FASTCONV_X86
+   if constexpr ( std::is_same_v<FloatType, float> )
+   {
+      static const Conv1DKernelTable<float> table = simd_isa() == SimdIsa::scalar
+            ? conv1d_make_scalar_folded_table<float, Anti>(Sizes{})
+            : conv1d_make_simd_folded_table<Anti>(simd_isa(), Sizes{});
+      return table;
+   }
+#endif
+   static const Conv1DKernelTable<FloatType> table
+         = conv1d_make_scalar_folded_table<FloatType, Anti>(Sizes{});
+   return table;
+}
+
+// Batched kernel for four rows, returns the number of outputs done per row
+template <typename FloatType>
+using Conv1DRowsKernelFn = std::size_t (*)(const FloatType* x, std::size_t x_stride, const FloatType* k,
+      FloatType* y, std::size_t y_stride, std::size_t kernel_size, std::size_t output_size);
+
+template <typename FloatType>
+using Conv1DRowsKernelTable = std::array<Conv1DRowsKernelFn<FloatType>, FASTCONV_MAX_FIXED_KERNEL + 1>;
+
+#ifdef FASTCONV_X86
+
+template <std::size_t... K>
+constexpr Conv1DRowsKernelTable<float>
+conv1d_make_rows_table(SimdIsa isa, std::index_sequence<K...>)
+{
+   switch ( isa )
+   {
+   case SimdIsa::avx512:
+      return {&conv1d_avx512_rows4<0>, &conv1d_avx512_rows4<K + 1>...};
+   case SimdIsa::avx2:
+      return {&conv1d_avx2_rows4<0>, &conv1d_avx2_rows4<K + 1>...};
+   default:
+      return {};
+   }
+}
+
+#endif // FASTCONV_X86
+
+// Batched kernel table for the detected instruction set; all entries are
+// nullptr where only the single-row kernels exist
+template <typename FloatType>
+const Conv1DRowsKernelTable<FloatType>&
+conv1d_rows_kernel_table()
+{
+#ifdef FASTCONV_X86
+   if constexpr ( std::is_same_v<FloatType, float> )
+   {
+      static const Conv1DRowsKernelTable<float> table =
+            conv1d_make_rows_table(simd_isa(), std::make_index_sequence<FASTCONV_MAX_FIXED_KERNEL>{});
+      return table;
+   }
+#endif
+   static const Conv1DRowsKernelTable<FloatType> table{};
+   return table;
+}
+
+// Register-tiled kernel over a block of taps, continuing the partial sums in
+// y if accumulate is set (see conv1d_avx512_tile)
+template <typename FloatType>
+using Conv1DTileKernelFn = void (*)(const FloatType* x, const FloatType* k, FloatType* y,
+      std::size_t kernel_size, std::size_t output_size, bool accumulate);
+
+// Tiled kernel for the detected instruction set; nullptr where there is none
+// (SSE, scalar and non-float types), the callers then use conv1d_core
+template <typename FloatType>
+Conv1DTileKernelFn<FloatType>
+conv1d_tile_kernel()
+{
+#ifdef FASTCONV_X86
+   if constexpr ( std::is_same_v<FloatType, float> )
+   {
+      switch ( simd_isa() )
+      {
+      case SimdIsa::avx512:
+         return &conv1d_avx512_tile;
+      case SimdIsa::avx2:
+         return &conv1d_avx2_tile;
+      default:
+         return nullptr;
+      }
+   }
+#endif
+   return nullptr;
+}
+
+// Kernel over the nonzero taps of a sparse kernel (see conv1d_avx512_sparse)
+template <typename FloatType>
+using Conv1DSparseKernelFn = void (*)(const FloatType* x, const std::size_t* offsets, const FloatType* k,
+      FloatType* y, std::size_t num_taps, std::size_t output_size);
+
+// Sparse kernel for the detected instruction set; nullptr where there is none
+// (SSE, scalar and non-float types), the callers then use a portable loop
+template <typename FloatType>
+Conv1DSparseKernelFn<FloatType>
+conv1d_sparse_kernel()
+{
+#ifdef FASTCONV_X86
+   if constexpr ( std::is_same_v<FloatType, float> )
+   {
+      switch ( simd_isa() )
+      {
+      case SimdIsa::avx512:
+         return &conv1d_avx512_sparse;
+      case SimdIsa::avx2:
+         return &conv1d_avx2_sparse;
+      default:
+         return nullptr;
+      }
+   }
+#endif
+   return nullptr;
+}
+
+#endif // CONV1D_DISPATCH_HPP
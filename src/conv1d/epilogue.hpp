@@ -0,0 +1,373 @@
+#ifndef CONV1D_EPILOGUE_HPP
+#define CONV1D_EPILOGUE_HPP
+
+#include "boundary.hpp"
+#include "core.hpp"
+#include "myarray.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Outputs per epilogue block: the block is convolved, then transformed and
+// reduced while it is still in L1. Reductions are defined over these blocks
+// (see conv1d_epilogue), so the block size is part of the results.
+#ifndef FASTCONV_EPILOGUE_BLOCK
+#define FASTCONV_EPILOGUE_BLOCK 1024
+#endif
+
+// Pointwise epilogues: v -> op(v) on every convolution output
+
+struct Conv1DIdentity
+{
+   template <typename FloatType>
+   inline FloatType operator()(FloatType v) const
+   {
+      return v;
+   }
+};
+
+template <typename FloatType>
+struct Conv1DScaleBias
+{
+   FloatType scale = 1, bias = 0;
+
+   inline FloatType operator()(FloatType v) const
+   {
+      return v * scale + bias;
+   }
+};
+
+struct Conv1DRelu
+{
+   template <typename FloatType>
+   inline FloatType operator()(FloatType v) const
+   {
+      return v > FloatType(0) ? v : FloatType(0);
+   }
+};
+
+struct Conv1DAbs
+{
+   template <typename FloatType>
+   inline FloatType operator()(FloatType v) const
+   {
+      return std::abs(v);
+   }
+};
+
+struct Conv1DSquare
+{
+   template <typename FloatType>
+   inline FloatType operator()(FloatType v) const
+   {
+      return v * v;
+   }
+};
+
+// Epilogues applied one after the other, left to right
+template <typename... Ops>
+struct Conv1DChain
+{
+   std::tuple<Ops...> ops;
+
+   template <typename FloatType>
+   inline FloatType operator()(FloatType v) const
+   {
+      std::apply([&](const auto&... op) { ((v = op(v)), ...); }, ops);
+      return v;
+   }
+};
+
+template <typename... Ops>
+inline Conv1DChain<Ops...>
+conv1d_chain(Ops... ops)
+{
+   return {std::tuple<Ops...>(ops...)};
+}
+
+// Reductions over the final outputs: a block is folded with add starting
+// from init, the block results are merged left to right. Sums run in double.
+
+struct Conv1DNoReduction
+{
+   using value_type = int;
+   static constexpr bool enabled = false;
+
+   inline value_type init() const
+   {
+      return 0;
+   }
+   inline value_type add(value_type acc, double) const
+   {
+      return acc;
+   }
+   inline value_type merge(value_type a, value_type) const
+   {
+      return a;
+   }
+};
+
+struct Conv1DSum
+{
+   using value_type = double;
+   static constexpr bool enabled = true;
+
+   inline value_type init() const
+   {
+      return 0;
+   }
+   inline value_type add(value_type acc, double v) const
+   {
+      return acc + v;
+   }
+   inline value_type merge(value_type a, value_type b) const
+   {
+      return a + b;
+   }
+};
+
+struct Conv1DMax
+{
+   using value_type = double;
+   static constexpr bool enabled = true;
+
+   inline value_type init() const
+   {
+      return -std::numeric_limits<double>::infinity();
+   }
+   inline value_type add(value_type acc, double v) const
+   {
+      return v > acc ? v : acc;
+   }
+   inline value_type merge(value_type a, value_type b) const
+   {
+      return b > a ? b : a;
+   }
+};
+
+// Sum of squares
+struct Conv1DEnergy
+{
+   using value_type = double;
+   static constexpr bool enabled = true;
+
+   inline value_type init() const
+   {
+      return 0;
+   }
+   inline value_type add(value_type acc, double v) const
+   {
+      return acc + v * v;
+   }
+   inline value_type merge(value_type a, value_type b) const
+   {
+      return a + b;
+   }
+};
+
+// Partial reductions per block, output i goes to lane i % L, so that the
+// reduction is not bound by the latency of a single chain of additions
+#define FASTCONV_EPILOGUE_LANES 16
+
+// Epilogue of one block: y(i) = op(c(i)), or y(i) += op(c(i)) with
+// accumulate (c may alias y); returns the block's reduction, the lanes merged
+// in order. Not inlined, so that every caller runs the same machine code and
+// the fused and unfused reductions agree to the last bit (also under
+// -ffast-math).
+template <typename FloatType, typename Op, typename Reduction>
+__attribute__((noinline, noclone)) typename Reduction::value_type
+conv1d_epilogue_block(const FloatType* c, FloatType* y, std::size_t n, const Op& op,
+      const Reduction& reduction, bool accumulate)
+{
+   if ( accumulate )
+   {
+      for ( std::size_t i = 0; i < n; i++ )
+         y[i] += op(c[i]);
+   }
+   else if ( c == y )
+   {
+      for ( std::size_t i = 0; i < n; i++ )
+         y[i] = op(y[i]);
+   }
+   else
+   {
+      for ( std::size_t i = 0; i < n; i++ )
+         y[i] = op(c[i]);
+   }
+
+   typename Reduction::value_type acc = reduction.init();
+   if constexpr ( Reduction::enabled )
+   {
+      constexpr std::size_t L = FASTCONV_EPILOGUE_LANES;
+      typename Reduction::value_type lanes[L];
+      for ( std::size_t l = 0; l < L; l++ )
+         lanes[l] = reduction.init();
+      std::size_t i = 0;
+      for ( ; i + L <= n; i += L )
+      {
+         for ( std::size_t l = 0; l < L; l++ )
+            lanes[l] = reduction.add(lanes[l], y[i + l]);
+      }
+      for ( std::size_t l = 0; i < n; i++, l++ )
+         lanes[l] = reduction.add(lanes[l], y[i]);
+      for ( std::size_t l = 0; l < L; l++ )
+         acc = reduction.merge(acc, lanes[l]);
+   }
+   return acc;
+}
+
+// Merge of the block reductions in order (not inlined, see above)
+template <typename Reduction>
+__attribute__((noinline, noclone)) typename Reduction::value_type
+conv1d_merge_blocks(const std::vector<typename Reduction::value_type>& partials, const Reduction& reduction)
+{
+   typename Reduction::value_type total = reduction.init();
+   for ( const auto& partial : partials )
+      total = reduction.merge(total, partial);
+   return total;
+}
+
+// The unfused epilogue: a separate pass over the convolution outputs c that
+// writes y = op(c) (or y += op(c)) and returns the reduction of y. The fused
+// calls below give identical outputs and reductions. They convolve one block
+// at a time, so this relies on conv1d_core not depending on where the output
+// range is split, also for the SSE and scalar kernels (see FASTCONV_EXACT_FP).
+template <typename FloatType, typename Op, typename Reduction = Conv1DNoReduction>
+typename Reduction::value_type
+conv1d_epilogue(ConstArrayView1D<FloatType> c, ArrayView1D<FloatType> y, Op op, Reduction reduction = {},
+      bool accumulate = false)
+{
+   if ( c.size() != y.size() )
+   {
+      throw std::runtime_error("Incorrect output size for 1D convolution");
+   }
+   if ( !c.contiguous() || !y.contiguous() )
+   {
+      typename Reduction::value_type result;
+      conv1d_contiguous(c, y, [&](auto cc, auto yc) {
+         result = conv1d_epilogue<FloatType>(cc, yc, op, reduction, accumulate);
+      });
+      return result;
+   }
+   constexpr std::size_t B = FASTCONV_EPILOGUE_BLOCK;
+   std::vector<typename Reduction::value_type> partials((y.size() + B - 1) / B);
+   for ( std::size_t b = 0; b < partials.size(); b++ )
+   {
+      const std::size_t n = std::min(B, y.size() - b * B);
+      partials[b] = conv1d_epilogue_block(c.data_ptr() + b * B, y.data_ptr() + b * B, n, op, reduction,
+            accumulate);
+   }
+   return conv1d_merge_blocks(partials, reduction);
+}
+
+// Fused driver: produce(begin, end, out) writes the convolution outputs
+// [begin, end) to out, one epilogue block at a time (into y, or into a block
+// of scratch with accumulate), and the epilogue runs on the block right away.
+// With a pool, chunks of whole blocks run in parallel; the block reductions
+// are merged in order afterwards, so the results do not depend on threading.
+// A strided y is processed as a contiguous copy.
+template <typename FloatType, typename Producer, typename Op, typename Reduction>
+typename Reduction::value_type
+conv1d_fused(std::size_t output_size, const Producer& produce, ArrayView1D<FloatType> y, const Op& op,
+      const Reduction& reduction, bool accumulate, ThreadPool* pool = nullptr,
+      std::size_t threshold = FASTCONV_PARALLEL_THRESHOLD)
+{
+   constexpr std::size_t B = FASTCONV_EPILOGUE_BLOCK;
+   if ( y.size() != output_size )
+   {
+      throw std::runtime_error("Incorrect output size for 1D convolution");
+   }
+   if ( !y.contiguous() )
+   {
+      // the copy keeps the values that are accumulated into or left unwritten
+      Array1D<FloatType> y_copy(output_size);
+      for ( std::size_t i = 0; i < output_size; i++ )
+         y_copy(i) = y(i);
+      const auto result = conv1d_fused<FloatType>(output_size, produce, y_copy, op, reduction, accumulate,
+            pool, threshold);
+      for ( std::size_t i = 0; i < output_size; i++ )
+         y(i) = y_copy(i);
+      return result;
+   }
+   const std::size_t num_blocks = (output_size + B - 1) / B;
+
+   auto run_blocks = [&](std::size_t first, std::size_t last, typename Reduction::value_type* partials) {
+      thread_local std::vector<FloatType> scratch;
+      if ( accumulate )
+         scratch.resize(B);
+      for ( std::size_t b = first; b < last; b++ )
+      {
+         const std::size_t begin = b * B, end = std::min(begin + B, output_size);
+         FloatType* out = accumulate ? scratch.data() : y.data_ptr() + begin;
+         produce(begin, end, ArrayView1D<FloatType>(out, end - begin));
+         partials[b]
+               = conv1d_epilogue_block(out, y.data_ptr() + begin, end - begin, op, reduction, accumulate);
+      }
+   };
+
+   std::vector<typename Reduction::value_type> partials(num_blocks);
+   if ( !pool || pool->size() < 2 || output_size < threshold )
+   {
+      run_blocks(0, num_blocks, partials.data());
+   }
+   else
+   {
+      const std::size_t per_chunk = std::max<std::size_t>(
+            1, std::min<std::size_t>(FASTCONV_PARALLEL_CHUNK / B, num_blocks / (4 * pool->size())));
+      const std::size_t num_chunks = (num_blocks + per_chunk - 1) / per_chunk;
+      pool->parallel_for(num_chunks, [&](std::size_t i) {
+         run_blocks(i * per_chunk, std::min((i + 1) * per_chunk, num_blocks), partials.data());
+      });
+   }
+
+   return conv1d_merge_blocks(partials, reduction);
+}
+
+// conv1d_core followed by the epilogue in a single pass over y; identical to
+// conv1d_core and then conv1d_epilogue
+template <typename FloatType, typename Op, typename Reduction = Conv1DNoReduction>
+typename Reduction::value_type
+conv1d_core_fused(ConstArrayView1D<FloatType> x, ConstArrayView1D<FloatType> k, ArrayView1D<FloatType> y,
+      Op op, Reduction reduction = {}, bool accumulate = false, ThreadPool* pool = nullptr,
+      std::size_t threshold = FASTCONV_PARALLEL_THRESHOLD, Conv1DSymmetry symmetry = Conv1DSymmetry::none)
+{
+   const std::size_t kernel_size = k.size();
+   const std::size_t output_size = x.size() >= kernel_size ? x.size() - kernel_size + 1 : 0;
+   auto produce = [&](std::size_t begin, std::size_t end, ArrayView1D<FloatType> out) {
+      conv1d_core<FloatType>(x.view(begin, end + kernel_size - 1), k, out, symmetry);
+   };
+   return conv1d_fused<FloatType>(output_size, produce, y, op, reduction, accumulate, pool, threshold);
+}
+
+// Outputs [begin, begin + y.size()) of a convolution that may preserve the
+// shape: the interior part by interior(x, k, y) on views of x, the edges by
+// conv1d_boundary_range. Used as the block producer of the fused engines.
+template <typename FloatType, typename Interior>
+void
+conv1d_output_range(ConstArrayView1D<FloatType> x, ConstArrayView1D<FloatType> k, ArrayView1D<FloatType> y,
+      std::size_t begin, bool preserve_shape, Conv1DBoundary mode, FloatType value, Conv1DSymmetry symmetry,
+      const Interior& interior)
+{
+   const std::size_t kernel_size = k.size();
+   const std::size_t raw_output_size = x.size() >= kernel_size ? x.size() - kernel_size + 1 : 0;
+   const std::size_t offset = preserve_shape ? (kernel_size - 1) / 2 : 0;
+   const std::size_t lo = std::max(begin, offset);
+   const std::size_t hi = std::min(begin + y.size(), offset + raw_output_size);
+   if ( lo < hi )
+   {
+      interior(x.view(lo - offset, hi - offset + kernel_size - 1), k, y.view(lo - begin, hi - begin));
+   }
+   if ( preserve_shape )
+   {
+      conv1d_boundary_range<FloatType>(x, k, y, begin, mode, value, symmetry);
+   }
+}
+
+#endif // CONV1D_EPILOGUE_HPP
@@ -0,0 +1,173 @@
+#ifndef FFT_HPP
+#define FFT_HPP
+
+#include "boundary.hpp"
+#include "conv1.hpp"
+#include "perf.hpp"
+#include "rfft.hpp"
+
+#include <algorithm>
+#include <complex>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// Default FFT length is bounded so that the block buffers stay in L2
+#ifndef FASTCONV_FFT_MAX_BLOCK
+#define FASTCONV_FFT_MAX_BLOCK 65536
+#endif
+
+// Class definition for FFT-based 1D convolution (overlap-save)
+template <typename FloatType>
+class Conv1DFFT : Conv1DBase<FloatType>
+{
+ public:
+   using Complex = std::complex<FloatType>;
+
+   // Constructor, block_size = 0 picks the FFT length from the kernel size
+   inline Conv1DFFT(bool preserve_shape = false, std::size_t block_size = 0)
+         : preserve_shape(preserve_shape), requested_block_size(block_size), kernel_size(0),
+           boundary(Conv1DBoundary::zero), boundary_value(0)
+   {
+   }
+   inline Conv1DFFT(const ConstArrayView1D<FloatType>& init_kernel, bool preserve_shape = false,
+         std::size_t block_size = 0)
+         : preserve_shape(preserve_shape), requested_block_size(block_size), boundary(Conv1DBoundary::zero),
+           boundary_value(0)
+   {
+      set_kernel(init_kernel);
+   }
+
+   // Set the FFT length; it is rounded up to a power of two of at least
+   // twice the kernel size. Takes effect on the next set_kernel.
+   inline void set_block_size(std::size_t block_size)
+   {
+      requested_block_size = block_size;
+   }
+
+   inline std::size_t block_size() const
+   {
+      return fft.size();
+   }
+
+   // How the input is extended for the edge outputs of preserve_shape (zero
+   // by default); the edges are computed directly, not by the FFT
+   inline void set_boundary(Conv1DBoundary mode, FloatType value = 0)
+   {
+      boundary = mode;
+      boundary_value = value;
+   }
+
+   // Set the convolution kernel and precompute its spectrum
+   inline void set_kernel(const ConstArrayView1D<FloatType>& k)
+   {
+      kernel_size = k.size();
+      if ( kernel_size == 0 )
+      {
+         throw std::invalid_argument("Empty convolution kernel");
+      }
+
+      std::size_t n = requested_block_size > 0
+            ? requested_block_size
+            : std::min<std::size_t>(8 * kernel_size, FASTCONV_FFT_MAX_BLOCK);
+      n = std::max<std::size_t>(n, 2 * kernel_size);
+      std::size_t nfft = 4;
+      while ( nfft < n )
+         nfft *= 2;
+      fft.plan(nfft);
+
+      std::vector<FloatType> padded(nfft, FloatType(0));
+      for ( std::size_t i = 0; i < kernel_size; i++ )
+      {
+         padded[i] = k(i);
+      }
+      kernel_spectrum.resize(nfft / 2 + 1);
+      fft.forward(padded.data(), kernel_spectrum.data());
+
+      reversed_kernel = std::move(Array1D<FloatType>(kernel_size));
+      for ( std::size_t i = 0; i < kernel_size; i++ )
+      {
+         reversed_kernel(i) = k(kernel_size - 1 - i);
+      }
+   }
+
+   // Compute the output size based on input size
+   inline std::size_t output_size(std::size_t input_size) const
+   {
+      return input_size + (preserve_shape ? 0 : 1 - kernel_size);
+   }
+
+   // Perform the 1D convolution block by block
+   inline Array1D<FloatType> conv(const ConstArrayView1D<FloatType>& x) const
+   {
+      Array1D<FloatType> y(output_size(x.size()));
+      conv_into(x, y);
+      return y;
+   }
+
+   // Perform the 1D convolution block by block into a caller-owned buffer
+   inline void conv_into(const ConstArrayView1D<FloatType>& x, ArrayView1D<FloatType> y) const
+   {
+      if ( !x.contiguous() || !y.contiguous() )
+      {
+         conv1d_contiguous(x, y, [&](auto xc, auto yc) { conv_into(xc, yc); });
+         return;
+      }
+      FASTCONV_PERF_SCOPE("fft", kernel_size, y.size());
+      std::size_t input_size = x.size();
+      if ( y.size() != output_size(input_size) )
+      {
+         throw std::runtime_error("Incorrect output size for 1D convolution");
+      }
+
+      std::size_t raw_output_size = input_size >= kernel_size ? input_size - kernel_size + 1 : 0;
+      std::size_t offset = preserve_shape ? (kernel_size - 1) / 2 : 0;
+
+      if ( preserve_shape )
+      {
+         conv1d_boundary<FloatType>(x, reversed_kernel, y, boundary, boundary_value);
+      }
+
+      const std::size_t nfft = fft.size();
+      const std::size_t step = nfft - kernel_size + 1; // valid outputs per block
+      // per-thread scratch, reused so that steady-state calls do not allocate
+      thread_local std::vector<FloatType> block;
+      thread_local std::vector<Complex> spectrum;
+      block.resize(nfft);
+      spectrum.resize(nfft / 2 + 1);
+
+      // Each block reads x(i .. i + nfft) and produces outputs i .. i + step;
+      // the first kernel_size - 1 samples of the circular result wrap around.
+      for ( std::size_t i = 0; i < raw_output_size; i += step )
+      {
+         const std::size_t avail = std::min(nfft, input_size - i);
+         std::copy(x.data_ptr() + i, x.data_ptr() + i + avail, block.begin());
+         std::fill(block.begin() + avail, block.end(), FloatType(0));
+
+         fft.forward(block.data(), spectrum.data());
+         for ( std::size_t f = 0; f < spectrum.size(); f++ )
+         {
+            const Complex a = spectrum[f], b = kernel_spectrum[f];
+            spectrum[f] = Complex(a.real() * b.real() - a.imag() * b.imag(),
+                  a.real() * b.imag() + a.imag() * b.real());
+         }
+         fft.inverse(spectrum.data(), block.data());
+
+         const std::size_t count = std::min(step, raw_output_size - i);
+         std::copy(block.begin() + kernel_size - 1, block.begin() + kernel_size - 1 + count,
+               y.data_ptr() + offset + i);
+      }
+   }
+
+ private:
+   RealFFT<FloatType> fft;               // Transform of the block length
+   std::vector<Complex> kernel_spectrum; // Spectrum of the zero-padded kernel
+   Array1D<FloatType> reversed_kernel;   // Reversed kernel, for the edge outputs
+   bool preserve_shape;                  // Preserve shape of the input/output
+   std::size_t requested_block_size;     // Block length requested by the user (0 = auto)
+   std::size_t kernel_size;              // Size of the kernel
+   Conv1DBoundary boundary;              // Extension of the input for the edge outputs
+   FloatType boundary_value;             // Value of Conv1DBoundary::constant
+};
+
+#endif // FFT_HPP
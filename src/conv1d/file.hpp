@@ -0,0 +1,489 @@
+#ifndef CONV1D_FILE_HPP
+#define CONV1D_FILE_HPP
+
+#include "allocators.hpp"
+#include "conv1.hpp"
+#include "myarray.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Outputs per window by default: 16 MiB of float
+#ifndef FASTCONV_FILE_WINDOW
+#define FASTCONV_FILE_WINDOW (std::size_t(1) << 22)
+#endif
+
+// Sizes and time of one file convolution
+struct Conv1DFileStats
+{
+   std::uint64_t input_bytes = 0;
+   std::uint64_t output_bytes = 0;
+   std::size_t windows = 0;
+   double seconds = 0;
+};
+
+// Out-of-core 1D convolution of raw binary files (native-endian FloatType,
+// no header), for signals larger than memory (POSIX). The input is mapped
+// read-only and convolved in windows of `window` outputs that overlap by
+// kernel_size - 1 input samples, through the conv_into of any valid-mode,
+// unit-stride Conv1DBase engine (its threads are used as configured). The
+// output is written sequentially, either from two page-aligned buffers by a
+// writer thread while the next window is computed, or straight into an mmap
+// of the output file. Consumed input pages and written output pages are
+// dropped from the mapping and the page cache as the scan advances, so the
+// resident memory stays at a few windows whatever the file size. Optional
+// read-ahead threads fault in the next windows while the current one is
+// convolved.
+template <typename FloatType>
+class Conv1DFile
+{
+ public:
+   // Constructor
+   inline Conv1DFile(const Conv1DBase<FloatType>& engine)
+         : engine(engine), window(FASTCONV_FILE_WINDOW), read_ahead(0), map_output(false), drop_cache(true)
+   {
+   }
+
+   // Outputs per window, rounded up to whole pages
+   inline void set_window(std::size_t outputs)
+   {
+      const std::size_t page = page_elements();
+      window = std::max<std::size_t>((outputs + page - 1) / page, 1) * page;
+   }
+
+   // Number of read-ahead threads, each keeping one window ahead (0: rely on
+   // the kernel's own read-ahead)
+   inline void set_read_ahead(std::size_t threads)
+   {
+      read_ahead = threads;
+   }
+
+   // Write through an mmap of the output file instead of write()
+   inline void set_map_output(bool enable)
+   {
+      map_output = enable;
+   }
+
+   // Evict processed ranges from the page cache (on by default); turn off
+   // when the files are read again right after
+   inline void set_drop_cache(bool enable)
+   {
+      drop_cache = enable;
+   }
+
+   // Number of outputs for an input of input_size samples
+   inline std::size_t output_size(std::size_t input_size) const
+   {
+      const std::size_t overlap = input_overlap();
+      return input_size > overlap ? input_size - overlap : 0;
+   }
+
+   // Convolve the file input_path into output_path (created or truncated)
+   inline Conv1DFileStats conv_file(const std::string& input_path, const std::string& output_path) const
+   {
+      const auto start = std::chrono::steady_clock::now();
+      const std::size_t overlap = input_overlap();
+
+      FileHandle in(::open(input_path.c_str(), O_RDONLY), input_path);
+      struct stat st;
+      if ( ::fstat(in.fd, &st) != 0 )
+         throw_errno("Cannot stat " + input_path);
+      const std::size_t input_bytes = static_cast<std::size_t>(st.st_size);
+      if ( input_bytes % sizeof(FloatType) != 0 )
+      {
+         throw std::runtime_error("Size of " + input_path + " is not a multiple of the sample size");
+      }
+      const std::size_t input_size = input_bytes / sizeof(FloatType);
+      const std::size_t outputs = input_size > overlap ? input_size - overlap : 0;
+
+      FileHandle out(::open(output_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644), output_path);
+      Conv1DFileStats stats;
+      stats.input_bytes = input_bytes;
+      stats.output_bytes = outputs * sizeof(FloatType);
+      if ( outputs == 0 )
+         return stats;
+
+      Mapping input(nullptr, input_bytes, PROT_READ, MAP_SHARED, in.fd, 0, input_path);
+      ::madvise(input.ptr, input_bytes, MADV_SEQUENTIAL);
+      const FloatType* x = static_cast<const FloatType*>(input.ptr);
+      if ( map_output && ::ftruncate(out.fd, static_cast<off_t>(stats.output_bytes)) != 0 )
+         throw_errno("Cannot resize " + output_path);
+
+      // the buffers outlive the writer thread that reads them
+      std::vector<Array1D<FloatType, HugePageAllocator>> buffers;
+      if ( !map_output )
+      {
+         buffers.emplace_back(window);
+         buffers.emplace_back(window);
+      }
+      Writer writer(out.fd, output_path, drop_cache);
+      ReadAhead prefetch(x, outputs, window, overlap, read_ahead);
+
+      std::size_t released = 0; // input bytes already dropped
+      for ( std::size_t o = 0; o < outputs; o += window, stats.windows++ )
+      {
+         const std::size_t w = std::min(window, outputs - o);
+         const ConstArrayView1D<FloatType> xw(x + o, w + overlap);
+         prefetch.advance(stats.windows);
+
+         if ( map_output )
+         {
+            const std::size_t begin = o * sizeof(FloatType);
+            const std::size_t mapped = begin / page_bytes() * page_bytes();
+            const std::size_t end = (o + w) * sizeof(FloatType);
+            Mapping output(nullptr, end - mapped, PROT_READ | PROT_WRITE, MAP_SHARED, out.fd, mapped,
+                  output_path);
+            FloatType* y = reinterpret_cast<FloatType*>(static_cast<char*>(output.ptr) + (begin - mapped));
+            engine.conv_into(xw, ArrayView1D<FloatType>(y, w));
+            output.unmap();
+            writer.written(begin, end - begin);
+         }
+         else
+         {
+            // the writer thread still owns the buffer of two windows back
+            auto& buffer = buffers[stats.windows % 2];
+            writer.wait(stats.windows % 2);
+            engine.conv_into(xw, buffer.view(0, w));
+            writer.submit(stats.windows % 2, buffer.data_ptr(), o * sizeof(FloatType),
+                  w * sizeof(FloatType));
+         }
+
+         // the next window starts at input sample o + w
+         const std::size_t consumed = (o + w) * sizeof(FloatType) / page_bytes() * page_bytes();
+         if ( consumed > released )
+         {
+            ::madvise(static_cast<char*>(input.ptr) + released, consumed - released, MADV_DONTNEED);
+            if ( drop_cache )
+               ::posix_fadvise(in.fd, static_cast<off_t>(released), static_cast<off_t>(consumed - released),
+                     POSIX_FADV_DONTNEED);
+            released = consumed;
+         }
+      }
+      writer.finish();
+
+      stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      return stats;
+   }
+
+ private:
+   static inline std::size_t page_bytes()
+   {
+      static const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+      return page;
+   }
+
+   static inline std::size_t page_elements()
+   {
+      return std::max<std::size_t>(page_bytes() / sizeof(FloatType), 1);
+   }
+
+   [[noreturn]] static inline void throw_errno(const std::string& what)
+   {
+      throw std::runtime_error(what + ": " + std::strerror(errno));
+   }
+
+   // Input samples shared by consecutive windows (kernel_size - 1), derived
+   // from output_size so that any engine can be used
+   inline std::size_t input_overlap() const
+   {
+      const std::size_t probe = std::max<std::size_t>(window, 1 << 16);
+      const std::size_t n1 = engine.output_size(probe), n2 = engine.output_size(2 * probe);
+      if ( n1 > probe || n2 != n1 + probe )
+      {
+         throw std::invalid_argument("File convolution needs a valid-mode engine with unit stride");
+      }
+      return probe - n1;
+   }
+
+   // Owned file descriptor
+   struct FileHandle
+   {
+      int fd;
+
+      inline FileHandle(int fd, const std::string& path)
+            : fd(fd)
+      {
+         if ( fd < 0 )
+            throw_errno("Cannot open " + path);
+      }
+
+      inline ~FileHandle()
+      {
+         ::close(fd);
+      }
+
+      FileHandle(const FileHandle&) = delete;
+      FileHandle& operator=(const FileHandle&) = delete;
+   };
+
+   // Owned memory mapping
+   struct Mapping
+   {
+      void* ptr;
+      std::size_t bytes;
+
+      inline Mapping(void* addr, std::size_t bytes, int prot, int flags, int fd, std::size_t offset,
+            const std::string& path)
+            : bytes(bytes)
+      {
+         ptr = ::mmap(addr, bytes, prot, flags, fd, static_cast<off_t>(offset));
+         if ( ptr == MAP_FAILED )
+            throw_errno("Cannot map " + path);
+      }
+
+      inline void unmap()
+      {
+         if ( ptr )
+            ::munmap(ptr, bytes);
+         ptr = nullptr;
+      }
+
+      inline ~Mapping()
+      {
+         unmap();
+      }
+
+      Mapping(const Mapping&) = delete;
+      Mapping& operator=(const Mapping&) = delete;
+   };
+
+   // Threads touching the pages of the windows ahead of the current one
+   class ReadAhead
+   {
+    public:
+      inline ReadAhead(const FloatType* x, std::size_t outputs, std::size_t window, std::size_t overlap,
+            std::size_t threads)
+            : x(x), outputs(outputs), window(window), overlap(overlap), depth(threads)
+      {
+         for ( std::size_t t = 0; t < threads; t++ )
+            workers.emplace_back([this]() { worker_loop(); });
+      }
+
+      inline ~ReadAhead()
+      {
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+         }
+         wake.notify_all();
+         for ( auto& worker : workers )
+            worker.join();
+      }
+
+      // Window `current` is being convolved
+      inline void advance(std::size_t current)
+      {
+         if ( workers.empty() )
+            return;
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            this->current = current;
+            next = std::max(next, current + 1);
+         }
+         wake.notify_all();
+      }
+
+    private:
+      inline void worker_loop()
+      {
+         const std::size_t windows = (outputs + window - 1) / window;
+         for ( ;; )
+         {
+            std::size_t w;
+            {
+               std::unique_lock<std::mutex> lock(mutex);
+               wake.wait(lock, [&]() { return stopping || (next < windows && next <= current + depth); });
+               if ( stopping )
+                  return;
+               w = next++;
+            }
+            touch(w);
+         }
+      }
+
+      inline void touch(std::size_t w) const
+      {
+         const std::size_t begin = w * window;
+         const std::size_t end = std::min(begin + window, outputs) + overlap;
+         const std::size_t step = page_elements();
+         const volatile FloatType* p = x;
+         for ( std::size_t i = begin; i < end; i += step )
+            (void)p[i];
+      }
+
+      const FloatType* x;
+      std::size_t outputs, window, overlap, depth;
+      std::size_t current = 0, next = 1;
+      bool stopping = false;
+      std::mutex mutex;
+      std::condition_variable wake;
+      std::vector<std::thread> workers;
+   };
+
+   // Sequential writes from a background thread, with the written ranges
+   // flushed and evicted two windows behind
+   class Writer
+   {
+    public:
+      inline Writer(int fd, const std::string& path, bool drop_cache)
+            : fd(fd), path(path), drop_cache(drop_cache)
+      {
+      }
+
+      inline ~Writer()
+      {
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+         }
+         wake.notify_all();
+         if ( thread.joinable() )
+            thread.join();
+      }
+
+      // Wait until buffer b may be overwritten
+      inline void wait(std::size_t b)
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+         wake.wait(lock, [&]() { return !jobs[b].pending || !error.empty(); });
+         check();
+      }
+
+      // Queue bytes at data for the file offset
+      inline void submit(std::size_t b, const FloatType* data, std::size_t offset, std::size_t bytes)
+      {
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs[b] = {reinterpret_cast<const char*>(data), offset, bytes, true, order++};
+            if ( !thread.joinable() )
+               thread = std::thread([this]() { worker_loop(); });
+         }
+         wake.notify_all();
+      }
+
+      // A range was written through a mapping
+      inline void written(std::size_t offset, std::size_t bytes)
+      {
+         flush(offset, bytes);
+      }
+
+      // Wait for all queued writes
+      inline void finish()
+      {
+         wait(0);
+         wait(1);
+      }
+
+    private:
+      struct Job
+      {
+         const char* data;
+         std::size_t offset, bytes;
+         bool pending;
+         std::size_t order;
+      };
+
+      inline void check() const
+      {
+         if ( !error.empty() )
+            throw std::runtime_error(error);
+      }
+
+      inline void worker_loop()
+      {
+         for ( ;; )
+         {
+            Job job;
+            std::size_t b;
+            {
+               std::unique_lock<std::mutex> lock(mutex);
+               wake.wait(lock, [&]() { return stopping || jobs[0].pending || jobs[1].pending; });
+               if ( !jobs[0].pending && !jobs[1].pending )
+                  return;
+               b = !jobs[0].pending || (jobs[1].pending && jobs[1].order < jobs[0].order) ? 1 : 0;
+               job = jobs[b];
+            }
+            std::string failure;
+            std::size_t done = 0;
+            while ( done < job.bytes )
+            {
+               const ssize_t n = ::pwrite(fd, job.data + done, job.bytes - done,
+                     static_cast<off_t>(job.offset + done));
+               if ( n < 0 && errno == EINTR )
+                  continue;
+               if ( n <= 0 )
+               {
+                  failure = "Cannot write " + path + ": " + std::strerror(n < 0 ? errno : EIO);
+                  break;
+               }
+               done += static_cast<std::size_t>(n);
+            }
+            if ( failure.empty() )
+               flush(job.offset, job.bytes);
+            {
+               std::lock_guard<std::mutex> lock(mutex);
+               jobs[b].pending = false;
+               if ( !failure.empty() )
+                  error = failure;
+            }
+            wake.notify_all();
+         }
+      }
+
+      // Start the write-back of a range, then wait for the range before it
+      // and evict it, which keeps dirty and cached pages bounded
+      inline void flush(std::size_t offset, std::size_t bytes)
+      {
+#ifdef __linux__
+         ::sync_file_range(fd, static_cast<off_t>(offset), static_cast<off_t>(bytes),
+               SYNC_FILE_RANGE_WRITE);
+         if ( previous_bytes > 0 )
+         {
+            ::sync_file_range(fd, static_cast<off_t>(previous_offset), static_cast<off_t>(previous_bytes),
+                  SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+            if ( drop_cache )
+               ::posix_fadvise(fd, static_cast<off_t>(previous_offset), static_cast<off_t>(previous_bytes),
+                     POSIX_FADV_DONTNEED);
+         }
+#endif
+         previous_offset = offset;
+         previous_bytes = bytes;
+      }
+
+      int fd;
+      std::string path;
+      bool drop_cache;
+      Job jobs[2] = {};
+      std::size_t order = 0;
+      std::size_t previous_offset = 0, previous_bytes = 0; // used by one thread only
+      std::string error;
+      bool stopping = false;
+      std::mutex mutex;
+      std::condition_variable wake;
+      std::thread thread;
+   };
+
+   const Conv1DBase<FloatType>& engine;
+   std::size_t window;     // Outputs per window, whole pages
+   std::size_t read_ahead; // Number of read-ahead threads
+   bool map_output;        // Write through an mmap of the output
+   bool drop_cache;        // Evict processed ranges from the page cache
+};
+
+#endif // CONV1D_FILE_HPP
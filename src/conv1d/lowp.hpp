@@ -0,0 +1,297 @@
+#ifndef CONV1D_LOWP_HPP
+#define CONV1D_LOWP_HPP
+
+#include "convert.hpp"
+#include "core.hpp"
+#include "parallel.hpp"
+#include "perf.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Number of outputs per block of the reduced-precision engines; the block is
+// widened to float (or int32) in a per-thread buffer that stays in L1/L2
+#ifndef FASTCONV_LOWP_BLOCK
+#define FASTCONV_LOWP_BLOCK 4096
+#endif
+
+// Fixed-point kernels: y(i) = sum_j k(j) * x(i + j) on int16_t samples with
+// int32_t accumulators, for outputs [begin, end). The sums must fit in 32 bits.
+inline void
+conv1d_int16_scalar(const std::int16_t* x, const std::int16_t* k, std::int32_t* y, std::size_t kernel_size,
+      std::size_t begin, std::size_t end)
+{
+   for ( std::size_t i = begin; i < end; ++i )
+   {
+      std::int32_t acc = 0;
+      for ( std::size_t j = 0; j < kernel_size; ++j )
+      {
+         acc += std::int32_t(k[j]) * std::int32_t(x[i + j]);
+      }
+      y[i] = acc;
+   }
+}
+
+// Two taps packed into the 32-bit lanes of a multiply-add
+inline std::int32_t
+conv1d_int16_pair(const std::int16_t* k)
+{
+   return std::int32_t(std::uint32_t(std::uint16_t(k[1])) << 16 | std::uint16_t(k[0]));
+}
+
+#ifdef FASTCONV_X86
+
+// The vector kernels take the kernel zero-padded to an even padded_size and
+// handle two taps per pmaddwd: the samples x(i + j) and x(i + j + 1) are
+// interleaved and multiplied with the pair (k(j), k(j + 1)). Returns the
+// number of outputs done; the rest is left to conv1d_int16_scalar.
+__attribute__((target("avx2"))) inline std::size_t
+conv1d_avx2_int16(const std::int16_t* x, const std::int16_t* k, std::int32_t* y, std::size_t padded_size,
+      std::size_t input_size)
+{
+   constexpr std::size_t W = 16;
+   std::size_t i = 0;
+   for ( ; i + W + padded_size - 1 <= input_size; i += W )
+   {
+      __m256i lo = _mm256_setzero_si256(), hi = _mm256_setzero_si256();
+      for ( std::size_t j = 0; j < padded_size; j += 2 )
+      {
+         const __m256i kj = _mm256_set1_epi32(conv1d_int16_pair(k + j));
+         const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i + j));
+         const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i + j + 1));
+         lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), kj));
+         hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), kj));
+      }
+      // lo holds outputs 0-3 and 8-11, hi 4-7 and 12-15
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(y + i), _mm256_permute2x128_si256(lo, hi, 0x20));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(y + i + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+   }
+   return i;
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline std::size_t
+conv1d_avx512_int16(const std::int16_t* x, const std::int16_t* k, std::int32_t* y, std::size_t padded_size,
+      std::size_t input_size)
+{
+   constexpr std::size_t W = 32;
+   std::size_t i = 0;
+   const __m512i first = _mm512_set_epi64(11, 10, 3, 2, 9, 8, 1, 0);
+   const __m512i second = _mm512_set_epi64(15, 14, 7, 6, 13, 12, 5, 4);
+   for ( ; i + W + padded_size - 1 <= input_size; i += W )
+   {
+      __m512i lo = _mm512_setzero_si512(), hi = _mm512_setzero_si512();
+      for ( std::size_t j = 0; j < padded_size; j += 2 )
+      {
+         const __m512i kj = _mm512_set1_epi32(conv1d_int16_pair(k + j));
+         const __m512i a = _mm512_loadu_si512(x + i + j);
+         const __m512i b = _mm512_loadu_si512(x + i + j + 1);
+         lo = _mm512_add_epi32(lo, _mm512_madd_epi16(_mm512_unpacklo_epi16(a, b), kj));
+         hi = _mm512_add_epi32(hi, _mm512_madd_epi16(_mm512_unpackhi_epi16(a, b), kj));
+      }
+      // each 128-bit lane of lo holds 4 outputs, the next 4 are in hi
+      _mm512_storeu_si512(y + i, _mm512_permutex2var_epi64(lo, first, hi));
+      _mm512_storeu_si512(y + i + 16, _mm512_permutex2var_epi64(lo, second, hi));
+   }
+   return i;
+}
+
+#endif // FASTCONV_X86
+
+// Fixed-point convolution of a block with the vector kernel of the detected
+// instruction set. k has padded_size taps (even, zero-padded from kernel_size).
+inline void
+conv1d_int16(const std::int16_t* x, const std::int16_t* k, std::int32_t* y, std::size_t kernel_size,
+      std::size_t padded_size, std::size_t output_size)
+{
+   const std::size_t input_size = output_size + kernel_size - 1;
+   std::size_t done = 0;
+#ifdef FASTCONV_X86
+   static const bool avx512bw = simd_isa() == SimdIsa::avx512 && __builtin_cpu_supports("avx512bw");
+   if ( avx512bw )
+      done = conv1d_avx512_int16(x, k, y, padded_size, input_size);
+   else if ( simd_isa() >= SimdIsa::avx2 )
+      done = conv1d_avx2_int16(x, k, y, padded_size, input_size);
+#endif
+   conv1d_int16_scalar(x, k, y, kernel_size, done, output_size);
+}
+
+// Scale int32 accumulators back by 2^-shift: rounded arithmetic shift for
+// integer outputs (saturated for int16_t), exact scaling for float
+template <typename OutType>
+void
+conv1d_requantize(const std::int32_t* acc, OutType* y, std::size_t n, int shift)
+{
+   const std::int32_t round = shift > 0 ? std::int32_t(1) << (shift - 1) : 0;
+   const float scale = std::ldexp(1.0f, -shift);
+   for ( std::size_t i = 0; i < n; i++ )
+   {
+      if constexpr ( std::is_same_v<OutType, std::int32_t> )
+         y[i] = (acc[i] + round) >> shift;
+      else if constexpr ( std::is_same_v<OutType, std::int16_t> )
+         y[i] = std::int16_t(std::min(std::max((acc[i] + round) >> shift, -32768), 32767));
+      else
+         y[i] = conv1d_from_float<OutType>(float(acc[i]) * scale);
+   }
+}
+
+// Class definition for 1D convolution on 16-bit storage. Samples and kernel
+// are stored as StorageType and the result is written as OutType:
+//  - _Float16 or BFloat16 storage: blocks are widened to float, convolved
+//    with conv1d_core and narrowed to OutType (float, _Float16, BFloat16 or
+//    int16_t, which rounds and saturates).
+//  - int16_t storage (fixed point): int32 accumulation, then the sums are
+//    shifted right by `shift` with rounding (int16_t/int32_t outputs) or
+//    scaled by 2^-shift (floating-point outputs). E.g. Q15 samples and a Q15
+//    kernel give Q15 outputs with shift = 15.
+// Only the valid outputs are computed: output_size(N) = N - kernel_size + 1.
+template <typename StorageType, typename OutType = StorageType>
+class Conv1DLowp : public Conv1DParallel
+{
+ public:
+   static constexpr bool fixed_point = std::is_same_v<StorageType, std::int16_t>;
+   static_assert(fixed_point || conv1d_is_16bit<StorageType>,
+         "Storage must be _Float16, BFloat16 or int16_t");
+
+   // Constructor
+   inline Conv1DLowp(int shift = 0, std::size_t block_size = FASTCONV_LOWP_BLOCK)
+         : shift(0), block_size(std::max<std::size_t>(block_size, 64)), kernel_size(0)
+   {
+      set_shift(shift);
+   }
+   inline Conv1DLowp(const ConstArrayView1D<StorageType>& init_kernel, int shift = 0,
+         std::size_t block_size = FASTCONV_LOWP_BLOCK)
+         : Conv1DLowp(shift, block_size)
+   {
+      set_kernel(init_kernel);
+   }
+
+   // Set the convolution kernel (reverse it)
+   inline void set_kernel(const ConstArrayView1D<StorageType>& k)
+   {
+      kernel_size = k.size();
+      if ( kernel_size == 0 )
+      {
+         throw std::invalid_argument("Empty convolution kernel");
+      }
+
+      if constexpr ( fixed_point )
+      {
+         fixed_kernel = std::move(Array1D<std::int16_t>(kernel_size + kernel_size % 2));
+         for ( std::size_t i = 0; i < fixed_kernel.size(); i++ )
+         {
+            fixed_kernel(i) = i < kernel_size ? k(kernel_size - 1 - i) : std::int16_t(0);
+         }
+      }
+      else
+      {
+         kernel = std::move(Array1D<float>(kernel_size));
+         for ( std::size_t i = 0; i < kernel_size; i++ )
+         {
+            kernel(i) = conv1d_to_float(k(kernel_size - 1 - i));
+         }
+      }
+   }
+
+   // Right shift applied to the int32 sums (fixed point only)
+   inline void set_shift(int new_shift)
+   {
+      if ( new_shift < 0 || new_shift > 30 )
+      {
+         throw std::invalid_argument("Shift must be in [0, 30]");
+      }
+      shift = new_shift;
+   }
+
+   // Compute the output size based on input size
+   inline std::size_t output_size(std::size_t input_size) const
+   {
+      return input_size >= kernel_size ? input_size - kernel_size + 1 : 0;
+   }
+
+   // Perform the 1D convolution
+   inline Array1D<OutType> conv(const ConstArrayView1D<StorageType>& x) const
+   {
+      Array1D<OutType> y(output_size(x.size()));
+      conv_into(x, y);
+      return y;
+   }
+
+   // Perform the 1D convolution into a caller-owned buffer
+   inline void conv_into(const ConstArrayView1D<StorageType>& x, ArrayView1D<OutType> y) const
+   {
+      if ( !x.contiguous() || !y.contiguous() )
+      {
+         conv1d_contiguous(x, y, [&](auto xc, auto yc) { conv_into(xc, yc); });
+         return;
+      }
+      FASTCONV_PERF_SCOPE("lowp", kernel_size, y.size());
+      const std::size_t out_size = output_size(x.size());
+      if ( y.size() != out_size )
+      {
+         throw std::runtime_error("Incorrect output size for 1D convolution");
+      }
+
+      const std::size_t num_blocks = (out_size + block_size - 1) / block_size;
+      auto run_block = [&](std::size_t b) {
+         const std::size_t start = b * block_size;
+         const std::size_t count = std::min(block_size, out_size - start);
+         conv_block(x.data_ptr() + start, y.data_ptr() + start, count);
+      };
+
+      if ( pool && pool->size() > 1 && out_size >= parallel_threshold && num_blocks > 1 )
+      {
+         pool->parallel_for(num_blocks, run_block);
+      }
+      else
+      {
+         for ( std::size_t b = 0; b < num_blocks; b++ )
+         {
+            run_block(b);
+         }
+      }
+   }
+
+ private:
+   // count outputs from the count + kernel_size - 1 samples at x
+   inline void conv_block(const StorageType* x, OutType* y, std::size_t count) const
+   {
+      const std::size_t length = count + kernel_size - 1;
+      if constexpr ( fixed_point )
+      {
+         thread_local std::vector<std::int32_t> acc;
+         acc.resize(count);
+         conv1d_int16(x, fixed_kernel.data_ptr(), acc.data(), kernel_size, fixed_kernel.size(), count);
+         conv1d_requantize(acc.data(), y, count, shift);
+      }
+      else
+      {
+         // widened outputs half a page away from the inputs, so that the
+         // stores do not alias the loads in the cache
+         const std::size_t ld = (length + 1023) / 1024 * 1024 + 512;
+         thread_local std::vector<float> wide;
+         wide.resize(ld + count);
+         conv1d_convert(x, wide.data(), length);
+         const ConstArrayView1D<float> xs(wide.data(), length);
+         if constexpr ( std::is_same_v<OutType, float> )
+         {
+            conv1d_core<float>(xs, kernel, ArrayView1D<float>(y, count));
+            return;
+         }
+         conv1d_core<float>(xs, kernel, ArrayView1D<float>(wide.data() + ld, count));
+         conv1d_convert(wide.data() + ld, y, count);
+      }
+   }
+
+   Array1D<float> kernel;              // Reversed kernel widened to float
+   Array1D<std::int16_t> fixed_kernel; // Reversed fixed-point kernel, zero-padded to an even size
+   int shift;                          // Right shift of the fixed-point sums
+   std::size_t block_size;             // Outputs per block
+   std::size_t kernel_size;            // Size of the kernel
+};
+
+#endif // CONV1D_LOWP_HPP
@@ -9,22 +9,32 @@
 #include <string>
 #include <vector>
 
+#include "batch.hpp"
+#include "boundary.hpp"
 #include "conv1.hpp"
 #include "core.hpp"
+#include "epilogue.hpp"
+#include "parallel.hpp"
+#include "perf.hpp"
+#include "strided.hpp"
 
 // Class definition for padded 1D convolution
 template <typename FloatType>
-class Conv1DPad : Conv1DBase<FloatType>
+class Conv1DPad : Conv1DBase<FloatType>, public Conv1DParallel
 {
  public:
    // Constructor
    inline Conv1DPad(std::size_t pad_modulo, bool preserve_shape = false)
-         : pad_modulo(pad_modulo), preserve_shape(preserve_shape), padding(0), kernel_size(0)
+         : pad_modulo(pad_modulo), preserve_shape(preserve_shape), padding(0), kernel_size(0), stride(1),
+           dilation(1), folding(true), symmetry_tolerance(0), symmetry(Conv1DSymmetry::none),
+           boundary(Conv1DBoundary::zero), boundary_value(0)
    {
    }
    inline Conv1DPad(const ConstArrayView1D<FloatType>& k, std::size_t pad_modulo,
          bool preserve_shape = false)
-         : pad_modulo(pad_modulo), preserve_shape(preserve_shape)
+         : pad_modulo(pad_modulo), preserve_shape(preserve_shape), stride(1), dilation(1), folding(true),
+           symmetry_tolerance(0), symmetry(Conv1DSymmetry::none),
+           boundary(Conv1DBoundary::zero), boundary_value(0)
    {
       set_kernel(k);
    }
@@ -51,41 +61,262 @@ class Conv1DPad : Conv1DBase<FloatType>
             kernel(i) = 0;
          }
       }
+      update_plan();
+      update_symmetry();
+   }
+
+   // Use the folded kernels for (anti)symmetric kernels (on by default)
+   inline void set_folding(bool enable)
+   {
+      folding = enable;
+      update_symmetry();
+   }
+
+   // Treat the kernel as symmetric if mirrored taps differ by at most
+   // tolerance times the largest tap (0, the default, requires exact
+   // symmetry); the folded kernel then uses the first half of the taps
+   inline void set_symmetry_tolerance(FloatType tolerance)
+   {
+      symmetry_tolerance = tolerance;
+      update_symmetry();
+   }
+
+   // Symmetry used by the unit-stride path
+   inline Conv1DSymmetry kernel_symmetry() const
+   {
+      return symmetry;
+   }
+
+   // How the input is extended for the edge outputs of preserve_shape (zero
+   // by default; value is used by Conv1DBoundary::constant). The edges are
+   // computed separately from short extended copies of the input ends.
+   inline void set_boundary(Conv1DBoundary mode, FloatType value = 0)
+   {
+      boundary = mode;
+      boundary_value = value;
+   }
+
+   // Keep only every stride-th output (decimation); the others are not computed
+   inline void set_stride(std::size_t new_stride)
+   {
+      stride = new_stride;
+      update_plan();
+   }
+
+   // Space the kernel taps dilation samples apart
+   inline void set_dilation(std::size_t new_dilation)
+   {
+      dilation = new_dilation;
+      update_plan();
    }
 
    // Compute the output size based on input size
    inline std::size_t output_size(std::size_t input_size) const
    {
+      if ( strided() )
+         return plan.output_size(input_size, preserve_shape);
       return input_size + (preserve_shape ? 0 : 1 - kernel_size);
    }
 
    // Perform the padded 1D convolution
    inline Array1D<FloatType> conv(const ConstArrayView1D<FloatType>& x) const
    {
+      Array1D<FloatType> y(output_size(x.size()));
+      conv_into(x, y);
+      return y;
+   }
+
+   // Perform the padded 1D convolution into a caller-owned buffer
+   inline void conv_into(const ConstArrayView1D<FloatType>& x, ArrayView1D<FloatType> y) const
+   {
+      FASTCONV_PERF_SCOPE("pad", kernel_size, y.size());
+      if ( strided() )
+      {
+         plan.conv_into(x, y, preserve_shape, pool.get(), parallel_threshold, boundary, boundary_value);
+         return;
+      }
 
       std::size_t input_size = x.size();
-      Array1D<FloatType> y(output_size(input_size));
+      if ( y.size() != output_size(input_size) )
+      {
+         throw std::runtime_error("Incorrect output size for 1D convolution");
+      }
 
-      std::size_t raw_output_size = input_size - kernel_size + 1;
+      std::size_t raw_output_size = input_size >= kernel_size ? input_size - kernel_size + 1 : 0;
       std::size_t offset = preserve_shape ? (kernel_size - 1) / 2 : 0;
 
-      conv1d_core<FloatType>(x, kernel, y.view(offset, offset + raw_output_size - padding));
+      if ( preserve_shape )
+      {
+         conv1d_boundary<FloatType>(x, kernel.const_view(0, kernel_size), y, boundary, boundary_value,
+               symmetry);
+      }
 
-      if ( padding > 0 )
+      // zero padding would break the mirror symmetry; the folded kernels
+      // handle any length, so they run on the unpadded kernel
+      if ( symmetry != Conv1DSymmetry::none )
       {
-         conv1d_core<FloatType>(x.view(raw_output_size - padding, input_size),
-               kernel.const_view(0, kernel_size),
-               y.view(offset + raw_output_size - padding, raw_output_size + offset));
+         if ( raw_output_size > 0 )
+         {
+            conv1d_core_parallel<FloatType>(x, kernel.const_view(0, kernel_size),
+                  y.view(offset, offset + raw_output_size), pool.get(), parallel_threshold, symmetry);
+         }
+         return;
+      }
+
+      // the padded kernel covers all but the last `padding` outputs; inputs
+      // shorter than the padded kernel go entirely through the tail call
+      std::size_t padded_output_size = raw_output_size > padding ? raw_output_size - padding : 0;
+
+      if ( padded_output_size > 0 )
+      {
+         conv1d_core_parallel<FloatType>(x, kernel, y.view(offset, offset + padded_output_size), pool.get(),
+               parallel_threshold);
+      }
+
+      if ( padded_output_size < raw_output_size )
+      {
+         conv1d_core<FloatType>(x.view(padded_output_size, input_size), kernel.const_view(0, kernel_size),
+               y.view(offset + padded_output_size, raw_output_size + offset));
+      }
+   }
+
+   // Convolve into y and apply an epilogue and a reduction per block of
+   // outputs, like Conv1DRef::conv_fused_into. Each block splits its outputs
+   // between the padded and the unpadded kernel where conv_into does, so the
+   // results are identical to conv_into followed by conv1d_epilogue.
+   template <typename Op, typename Reduction = Conv1DNoReduction>
+   inline typename Reduction::value_type conv_fused_into(const ConstArrayView1D<FloatType>& x,
+         ArrayView1D<FloatType> y, Op op, Reduction reduction = {}, bool accumulate = false) const
+   {
+      FASTCONV_PERF_SCOPE("pad_fused", kernel_size, y.size());
+      if ( strided() )
+      {
+         // Outputs left unwritten (Conv1DBoundary::none) keep the value of y,
+         // or 0 when accumulating
+         Array1D<FloatType> c(y.size());
+         for ( std::size_t i = 0; i < c.size(); i++ )
+            c(i) = accumulate ? FloatType(0) : y(i);
+         conv_into(x, c);
+         return conv1d_epilogue<FloatType>(c, y, op, reduction, accumulate);
       }
+
+      const std::size_t raw_output_size = x.size() >= kernel_size ? x.size() - kernel_size + 1 : 0;
+      const std::size_t offset = preserve_shape ? (kernel_size - 1) / 2 : 0;
+      const std::size_t padded_output_size = symmetry == Conv1DSymmetry::none && raw_output_size > padding
+            ? raw_output_size - padding
+            : 0;
+      const bool zero_edges = accumulate && preserve_shape && boundary == Conv1DBoundary::none;
+      auto produce = [&](std::size_t begin, std::size_t end, ArrayView1D<FloatType> out) {
+         if ( zero_edges )
+            std::fill(out.data_ptr(), out.data_ptr() + (end - begin), FloatType(0));
+         // first raw output of the block's interior
+         const std::size_t first = std::max(begin, offset) - offset;
+         auto interior = [&](ConstArrayView1D<FloatType> xs, ConstArrayView1D<FloatType> ks,
+                               ArrayView1D<FloatType> ys) {
+            const std::size_t split
+                  = std::min(ys.size(), padded_output_size > first ? padded_output_size - first : 0);
+            if ( split > 0 )
+            {
+               conv1d_core<FloatType>(xs.view(0, split + kernel.size() - 1), kernel, ys.view(0, split));
+            }
+            if ( split < ys.size() )
+            {
+               conv1d_core<FloatType>(xs.view(split, xs.size()), ks, ys.view(split, ys.size()),
+                     symmetry);
+            }
+         };
+         conv1d_output_range<FloatType>(x, kernel.const_view(0, kernel_size), out, begin, preserve_shape,
+               boundary, boundary_value, symmetry, interior);
+      };
+      return conv1d_fused<FloatType>(output_size(x.size()), produce, y, op, reduction, accumulate,
+            pool.get(), parallel_threshold);
+   }
+
+   // Convolve every row of a (channels x samples) batch
+   inline Array2D<FloatType> conv_batch(const ConstArrayView2D<FloatType>& x) const
+   {
+      Array2D<FloatType> y(x.rows(), output_size(x.cols()));
+      conv_batch_into(x, y);
       return y;
    }
 
+   // Convolve every row of a batch into a caller-owned buffer
+   inline void conv_batch_into(const ConstArrayView2D<FloatType>& x, ArrayView2D<FloatType> y) const
+   {
+      FASTCONV_PERF_SCOPE("pad", kernel_size, y.rows() * y.cols());
+      if ( strided() )
+      {
+         Conv1DBase<FloatType>::conv_batch_into(x, y);
+         return;
+      }
+
+      std::size_t input_size = x.cols();
+      if ( y.cols() != output_size(input_size) )
+      {
+         throw std::runtime_error("Incorrect output size for 1D convolution");
+      }
+
+      std::size_t raw_output_size = input_size >= kernel_size ? input_size - kernel_size + 1 : 0;
+      std::size_t offset = preserve_shape ? (kernel_size - 1) / 2 : 0;
+      std::size_t padded_output_size = raw_output_size > padding ? raw_output_size - padding : 0;
+
+      if ( preserve_shape )
+      {
+         for ( std::size_t r = 0; r < x.rows(); r++ )
+         {
+            conv1d_boundary<FloatType>(x.row(r), kernel.const_view(0, kernel_size), y.row(r), boundary,
+                  boundary_value);
+         }
+      }
+
+      if ( padded_output_size > 0 )
+      {
+         conv1d_core_batch<FloatType>(x, kernel, y.view(0, y.rows(), offset, offset + padded_output_size),
+               pool.get(), parallel_threshold);
+      }
+
+      if ( padded_output_size < raw_output_size )
+      {
+         conv1d_core_batch<FloatType>(x.view(0, x.rows(), padded_output_size, input_size),
+               kernel.const_view(0, kernel_size),
+               y.view(0, y.rows(), offset + padded_output_size, raw_output_size + offset));
+      }
+   }
+
  private:
-   Array1D<FloatType> kernel; // Convolution kernel, including padding
-   std::size_t pad_modulo;    // Padding alignment constraint
-   bool preserve_shape;       // Preserve shape of the input/output
-   std::size_t padding;       // Computed padding size
-   std::size_t kernel_size;   // Size of the actual kernel
+   inline bool strided() const
+   {
+      return stride != 1 || dilation != 1;
+   }
+
+   // The strided plan uses the unpadded kernel: its sub-kernels are short
+   // and handled by the fixed-size kernels of conv1d_core
+   inline void update_plan()
+   {
+      if ( strided() && kernel_size > 0 )
+         plan.set(kernel.const_view(0, kernel_size), stride, dilation);
+   }
+
+   inline void update_symmetry()
+   {
+      symmetry = folding && kernel_size > 0
+            ? conv1d_symmetry<FloatType>(kernel.const_view(0, kernel_size), symmetry_tolerance)
+            : Conv1DSymmetry::none;
+   }
+
+   Array1D<FloatType> kernel;       // Convolution kernel, including padding
+   std::size_t pad_modulo;          // Padding alignment constraint
+   bool preserve_shape;             // Preserve shape of the input/output
+   std::size_t padding;             // Computed padding size
+   std::size_t kernel_size;         // Size of the actual kernel
+   std::size_t stride;              // Distance between kept outputs
+   std::size_t dilation;            // Distance between kernel taps
+   Conv1DPolyphase<FloatType> plan; // Strided/dilated plan, used unless both are 1
+   bool folding;                    // Fold (anti)symmetric kernels
+   FloatType symmetry_tolerance;    // Relative tolerance of the symmetry test
+   Conv1DSymmetry symmetry;         // Detected symmetry of the kernel
+   Conv1DBoundary boundary;         // Extension of the input for the edge outputs
+   FloatType boundary_value;        // Value of Conv1DBoundary::constant
 };
 
 #endif // PAD_HPP
@@ -0,0 +1,214 @@
+#ifndef CONV1D_PARALLEL_HPP
+#define CONV1D_PARALLEL_HPP
+
+#include "core.hpp"
+#include "myarray.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent pool of worker threads. The thread calling parallel_for takes
+// part in the work, so a pool of size n starts n - 1 workers.
+class ThreadPool
+{
+ public:
+   inline explicit ThreadPool(std::size_t num_threads = std::thread::hardware_concurrency())
+         : num_threads(std::max<std::size_t>(num_threads, 1))
+   {
+      for ( std::size_t i = 1; i < this->num_threads; i++ )
+      {
+         workers.emplace_back([this]() { worker_loop(); });
+      }
+   }
+
+   ThreadPool(const ThreadPool&) = delete;
+   ThreadPool& operator=(const ThreadPool&) = delete;
+
+   inline ~ThreadPool()
+   {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         stopping = true;
+      }
+      wake.notify_all();
+      for ( auto& worker : workers )
+      {
+         worker.join();
+      }
+   }
+
+   inline std::size_t size() const
+   {
+      return num_threads;
+   }
+
+   // Call fn(i) for every i in [0, num_tasks) and wait until all are done
+   inline void parallel_for(std::size_t num_tasks, const std::function<void(std::size_t)>& fn)
+   {
+      if ( num_tasks == 0 )
+         return;
+
+      std::lock_guard<std::mutex> submit_lock(submit_mutex);
+      std::unique_lock<std::mutex> lock(mutex);
+      // a worker that woke up late for the previous call may still be
+      // probing the task counter; it must leave before the counter is reset
+      done.wait(lock, [this]() { return active == 0; });
+      task = &fn;
+      task_count = num_tasks;
+      next_task.store(0);
+      pending = num_tasks;
+      generation++;
+      lock.unlock();
+      wake.notify_all();
+
+      run_tasks();
+
+      // wait for the tasks and for every worker to leave run_tasks, so that
+      // none of them touches fn (or the next call's counter) afterwards
+      lock.lock();
+      done.wait(lock, [this]() { return pending == 0 && active == 0; });
+      task = nullptr;
+   }
+
+ private:
+   inline void run_tasks()
+   {
+      std::size_t finished = 0;
+      for ( std::size_t i = next_task++; i < task_count; i = next_task++ )
+      {
+         (*task.load())(i);
+         finished++;
+      }
+      if ( finished > 0 )
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         pending -= finished;
+         if ( pending == 0 )
+            done.notify_all();
+      }
+   }
+
+   inline void worker_loop()
+   {
+      std::size_t seen_generation = 0;
+      for ( ;; )
+      {
+         {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopping || generation != seen_generation; });
+            if ( stopping )
+               return;
+            seen_generation = generation;
+            active++;
+         }
+         run_tasks();
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            if ( --active == 0 )
+               done.notify_all();
+         }
+      }
+   }
+
+   std::size_t num_threads;
+   std::vector<std::thread> workers;
+   std::mutex submit_mutex; // serializes parallel_for calls from different threads
+   std::mutex mutex;
+   std::condition_variable wake, done;
+   // atomic, as workers claim tasks without the mutex
+   std::atomic<const std::function<void(std::size_t)>*> task{nullptr};
+   std::atomic<std::size_t> task_count{0};
+   std::atomic<std::size_t> next_task{0};
+   std::size_t pending = 0;
+   std::size_t active = 0; // workers inside run_tasks
+   std::size_t generation = 0;
+   bool stopping = false;
+};
+
+// Number of outputs per task: the input slice of a chunk stays in L2
+#ifndef FASTCONV_PARALLEL_CHUNK
+#define FASTCONV_PARALLEL_CHUNK 16384
+#endif
+
+// Outputs below this count are computed on the calling thread
+#ifndef FASTCONV_PARALLEL_THRESHOLD
+#define FASTCONV_PARALLEL_THRESHOLD 65536
+#endif
+
+// conv1d_core with the output range split into chunks run on the pool. Each
+// output is computed exactly as in the serial call, so results are identical.
+template <typename FloatType>
+void
+conv1d_core_parallel(ConstArrayView1D<FloatType> x, ConstArrayView1D<FloatType> k, ArrayView1D<FloatType> y,
+      ThreadPool* pool, std::size_t threshold = FASTCONV_PARALLEL_THRESHOLD,
+      Conv1DSymmetry symmetry = Conv1DSymmetry::none)
+{
+   const std::size_t output_size = y.size();
+
+   if ( !pool || pool->size() < 2 || output_size < threshold )
+   {
+      conv1d_core<FloatType>(x, k, y, symmetry);
+      return;
+   }
+
+   if ( output_size != x.size() - k.size() + 1 )
+   {
+      throw std::runtime_error("Incorrect output shape for 1D convolution");
+   }
+
+   // at least a few chunks per thread for load balancing, multiples of 64
+   // so that chunk borders fall on full vector blocks
+   std::size_t chunk = std::min<std::size_t>(FASTCONV_PARALLEL_CHUNK, output_size / (4 * pool->size()));
+   chunk = std::max<std::size_t>(64, chunk - chunk % 64);
+   const std::size_t num_chunks = (output_size + chunk - 1) / chunk;
+
+   pool->parallel_for(num_chunks, [&](std::size_t i) {
+      const std::size_t start = i * chunk;
+      const std::size_t end = std::min(start + chunk, output_size);
+      conv1d_core<FloatType>(x.view(start, end + k.size() - 1), k, y.view(start, end), symmetry);
+   });
+}
+
+// Parallel execution settings shared by the convolution engines. The pool is
+// either created by set_threads or borrowed with set_thread_pool.
+class Conv1DParallel
+{
+ public:
+   // Use a private pool with num_threads threads; 0 or 1 disables threading
+   inline void set_threads(std::size_t num_threads)
+   {
+      if ( num_threads > 1 )
+         pool = std::make_shared<ThreadPool>(num_threads);
+      else
+         pool.reset();
+   }
+
+   // Share an existing pool (e.g. between several engines)
+   inline void set_thread_pool(std::shared_ptr<ThreadPool> shared_pool)
+   {
+      pool = std::move(shared_pool);
+   }
+
+   inline void set_parallel_threshold(std::size_t min_outputs)
+   {
+      parallel_threshold = min_outputs;
+   }
+
+   inline std::size_t threads() const
+   {
+      return pool ? pool->size() : 1;
+   }
+
+ protected:
+   std::shared_ptr<ThreadPool> pool;
+   std::size_t parallel_threshold = FASTCONV_PARALLEL_THRESHOLD;
+};
+
+#endif // CONV1D_PARALLEL_HPP
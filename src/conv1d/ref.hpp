@@ -1,8 +1,14 @@
 #ifndef SIMPLE_HPP
 #define SIMPLE_HPP
 
+#include "batch.hpp"
+#include "boundary.hpp"
 #include "conv1.hpp"
 #include "core.hpp"
+#include "epilogue.hpp"
+#include "parallel.hpp"
+#include "perf.hpp"
+#include "strided.hpp"
 
 #include <algorithm>
 #include <cassert>
@@ -13,16 +19,18 @@
 
 // Class definition for 1D Convolution
 template <typename FloatType>
-class Conv1DRef : Conv1DBase<FloatType>
+class Conv1DRef : Conv1DBase<FloatType>, public Conv1DParallel
 {
  public:
    // Constructor
    inline Conv1DRef(bool preserve_shape = false)
-         : preserve_shape(preserve_shape)
+         : preserve_shape(preserve_shape), stride(1), dilation(1), folding(true), symmetry_tolerance(0),
+           symmetry(Conv1DSymmetry::none), boundary(Conv1DBoundary::zero), boundary_value(0)
    {
    }
    inline Conv1DRef(const ConstArrayView1D<FloatType>& init_kernel, bool preserve_shape = false)
-         : preserve_shape(preserve_shape)
+         : preserve_shape(preserve_shape), stride(1), dilation(1), folding(true), symmetry_tolerance(0),
+           symmetry(Conv1DSymmetry::none), boundary(Conv1DBoundary::zero), boundary_value(0)
    {
       set_kernel(init_kernel);
    }
@@ -35,31 +43,207 @@ class Conv1DRef : Conv1DBase<FloatType>
       {
          kernel(i) = new_kernel(new_kernel.size() - 1 - i);
       }
+      update_plan();
+      update_symmetry();
+   }
+
+   // Use the folded kernels for (anti)symmetric kernels (on by default)
+   inline void set_folding(bool enable)
+   {
+      folding = enable;
+      update_symmetry();
+   }
+
+   // Treat the kernel as symmetric if mirrored taps differ by at most
+   // tolerance times the largest tap (0, the default, requires exact
+   // symmetry); the folded kernel then uses the first half of the taps
+   inline void set_symmetry_tolerance(FloatType tolerance)
+   {
+      symmetry_tolerance = tolerance;
+      update_symmetry();
+   }
+
+   // Symmetry used by the unit-stride path
+   inline Conv1DSymmetry kernel_symmetry() const
+   {
+      return symmetry;
+   }
+
+   // How the input is extended for the edge outputs of preserve_shape (zero
+   // by default; value is used by Conv1DBoundary::constant). The edges are
+   // computed separately from short extended copies of the input ends.
+   inline void set_boundary(Conv1DBoundary mode, FloatType value = 0)
+   {
+      boundary = mode;
+      boundary_value = value;
+   }
+
+   // Keep only every stride-th output (decimation); the others are not computed
+   inline void set_stride(std::size_t new_stride)
+   {
+      stride = new_stride;
+      update_plan();
+   }
+
+   // Space the kernel taps dilation samples apart
+   inline void set_dilation(std::size_t new_dilation)
+   {
+      dilation = new_dilation;
+      update_plan();
    }
 
    // Compute the output size based on input size
    inline std::size_t output_size(std::size_t input_size) const
    {
+      if ( strided() )
+         return plan.output_size(input_size, preserve_shape);
       return input_size + (preserve_shape ? 0 : 1 - kernel.size());
    }
 
    // Perform the 1D convolution
    inline Array1D<FloatType> conv(const ConstArrayView1D<FloatType>& x) const
    {
+      Array1D<FloatType> y(output_size(x.size()));
+      conv_into(x, y);
+      return y;
+   }
+
+   // Perform the 1D convolution into a caller-owned buffer
+   inline void conv_into(const ConstArrayView1D<FloatType>& x, ArrayView1D<FloatType> y) const
+   {
+      FASTCONV_PERF_SCOPE("ref", kernel.size(), y.size());
+      if ( strided() )
+      {
+         plan.conv_into(x, y, preserve_shape, pool.get(), parallel_threshold, boundary, boundary_value);
+         return;
+      }
+
       std::size_t input_size = x.size();
-      Array1D<FloatType> y(output_size(input_size));
+      if ( y.size() != output_size(input_size) )
+      {
+         throw std::runtime_error("Incorrect output size for 1D convolution");
+      }
 
       std::size_t kernel_size = kernel.size();
-      std::size_t raw_output_size = input_size - kernel_size + 1;
+      std::size_t raw_output_size = input_size >= kernel_size ? input_size - kernel_size + 1 : 0;
       std::size_t offset = preserve_shape ? (kernel_size - 1) / 2 : 0;
 
-      conv1d_core<FloatType>(x, kernel, y.view(offset, raw_output_size + offset));
+      if ( raw_output_size > 0 )
+      {
+         conv1d_core_parallel<FloatType>(x, kernel, y.view(offset, raw_output_size + offset), pool.get(),
+               parallel_threshold, symmetry);
+      }
+      if ( preserve_shape )
+      {
+         conv1d_boundary<FloatType>(x, kernel, y, boundary, boundary_value, symmetry);
+      }
+   }
+
+   // Convolve into y and apply a pointwise epilogue and a reduction (see
+   // epilogue.hpp) block by block while the outputs are still in cache:
+   // y = op(x * k), or y += op(x * k) with accumulate, returning the reduction
+   // of y. Identical to conv_into followed by conv1d_epilogue. With
+   // Conv1DBoundary::none the edge outputs count as 0 when accumulating.
+   template <typename Op, typename Reduction = Conv1DNoReduction>
+   inline typename Reduction::value_type conv_fused_into(const ConstArrayView1D<FloatType>& x,
+         ArrayView1D<FloatType> y, Op op, Reduction reduction = {}, bool accumulate = false) const
+   {
+      FASTCONV_PERF_SCOPE("ref_fused", kernel.size(), y.size());
+      if ( strided() )
+      {
+         // Outputs left unwritten (Conv1DBoundary::none) keep the value of y,
+         // or 0 when accumulating
+         Array1D<FloatType> c(y.size());
+         for ( std::size_t i = 0; i < c.size(); i++ )
+            c(i) = accumulate ? FloatType(0) : y(i);
+         conv_into(x, c);
+         return conv1d_epilogue<FloatType>(c, y, op, reduction, accumulate);
+      }
+
+      const bool zero_edges = accumulate && preserve_shape && boundary == Conv1DBoundary::none;
+      auto interior = [&](ConstArrayView1D<FloatType> xs, ConstArrayView1D<FloatType> ks,
+                            ArrayView1D<FloatType> ys) {
+         conv1d_core<FloatType>(xs, ks, ys, symmetry);
+      };
+      auto produce = [&](std::size_t begin, std::size_t end, ArrayView1D<FloatType> out) {
+         if ( zero_edges )
+            std::fill(out.data_ptr(), out.data_ptr() + (end - begin), FloatType(0));
+         conv1d_output_range<FloatType>(x, kernel, out, begin, preserve_shape, boundary, boundary_value,
+               symmetry, interior);
+      };
+      return conv1d_fused<FloatType>(output_size(x.size()), produce, y, op, reduction, accumulate,
+            pool.get(), parallel_threshold);
+   }
+
+   // Convolve every row of a (channels x samples) batch
+   inline Array2D<FloatType> conv_batch(const ConstArrayView2D<FloatType>& x) const
+   {
+      Array2D<FloatType> y(x.rows(), output_size(x.cols()));
+      conv_batch_into(x, y);
       return y;
    }
 
+   // Convolve every row of a batch into a caller-owned buffer
+   inline void conv_batch_into(const ConstArrayView2D<FloatType>& x, ArrayView2D<FloatType> y) const
+   {
+      FASTCONV_PERF_SCOPE("ref", kernel.size(), y.rows() * y.cols());
+      if ( strided() )
+      {
+         Conv1DBase<FloatType>::conv_batch_into(x, y);
+         return;
+      }
+
+      std::size_t input_size = x.cols();
+      if ( y.cols() != output_size(input_size) )
+      {
+         throw std::runtime_error("Incorrect output size for 1D convolution");
+      }
+
+      std::size_t kernel_size = kernel.size();
+      std::size_t raw_output_size = input_size >= kernel_size ? input_size - kernel_size + 1 : 0;
+      std::size_t offset = preserve_shape ? (kernel_size - 1) / 2 : 0;
+
+      if ( raw_output_size > 0 )
+      {
+         conv1d_core_batch<FloatType>(x, kernel, y.view(0, y.rows(), offset, raw_output_size + offset),
+               pool.get(), parallel_threshold);
+      }
+      if ( preserve_shape )
+      {
+         for ( std::size_t r = 0; r < x.rows(); r++ )
+         {
+            conv1d_boundary<FloatType>(x.row(r), kernel, y.row(r), boundary, boundary_value);
+         }
+      }
+   }
+
  private:
-   Array1D<FloatType> kernel; // Reversed convolution kernel
-   bool preserve_shape;       // Preserve shape of the input/output
+   inline bool strided() const
+   {
+      return stride != 1 || dilation != 1;
+   }
+
+   inline void update_plan()
+   {
+      if ( strided() && kernel.size() > 0 )
+         plan.set(kernel, stride, dilation);
+   }
+
+   inline void update_symmetry()
+   {
+      symmetry = folding ? conv1d_symmetry<FloatType>(kernel, symmetry_tolerance) : Conv1DSymmetry::none;
+   }
+
+   Array1D<FloatType> kernel;       // Reversed convolution kernel
+   bool preserve_shape;             // Preserve shape of the input/output
+   std::size_t stride;              // Distance between kept outputs
+   std::size_t dilation;            // Distance between kernel taps
+   Conv1DPolyphase<FloatType> plan; // Strided/dilated plan, used unless both are 1
+   bool folding;                    // Fold (anti)symmetric kernels
+   FloatType symmetry_tolerance;    // Relative tolerance of the symmetry test
+   Conv1DSymmetry symmetry;         // Detected symmetry of the kernel
+   Conv1DBoundary boundary;         // Extension of the input for the edge outputs
+   FloatType boundary_value;        // Value of Conv1DBoundary::constant
 };
 
 #endif // SIMPLE_HPP
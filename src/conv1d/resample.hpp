@@ -0,0 +1,344 @@
+#ifndef RESAMPLE_HPP
+#define RESAMPLE_HPP
+
+#include "conv1.hpp"
+#include "core.hpp"
+#include "parallel.hpp"
+#include "perf.hpp"
+#include "strided.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+// Outputs per task of the resampler; a block is a whole number of frames
+// (one output of every polyphase branch)
+#ifndef FASTCONV_RESAMPLE_BLOCK
+#define FASTCONV_RESAMPLE_BLOCK 8192
+#endif
+
+// Class definition for rational resampling by up/down: the input is
+// upsampled by `up` (zero-stuffing), convolved with the prototype kernel and
+// decimated by `down`, computing only the kept outputs and never multiplying
+// by the stuffed zeros.
+//
+// Output m depends on input samples floor(m * down / up) onwards through the
+// taps kernel(phase + i * up), phase = m * down % up; outputs m, m + P, ...
+// (P = up / gcd) share the phase and are down / gcd input samples apart. Each
+// such branch is split further by input phase (as in Conv1DPolyphase) into
+// dense sub-kernels run by conv1d_core on deinterleaved input.
+//
+// Output m is the full convolution of the upsampled signal at index
+// m * down + (Q - 1) * up, Q = ceil(kernel_size / up), so that every output
+// only reads existing samples (as in the valid mode of the other engines).
+// The gain of the kernel is not changed; scale it by `up` to preserve the
+// amplitude.
+template <typename FloatType>
+class Resampler1D : Conv1DBase<FloatType>, public Conv1DParallel
+{
+ public:
+   // Constructor
+   inline Resampler1D(std::size_t up, std::size_t down)
+         : up(up), down(down), kernel_size(0), phase_size(0), max_extent(0)
+   {
+      if ( up == 0 || down == 0 )
+      {
+         throw std::invalid_argument("Resampling factors must be positive");
+      }
+      const std::size_t common = std::gcd(up, down);
+      period = up / common;
+      step = down / common;
+      reset();
+   }
+   inline Resampler1D(const ConstArrayView1D<FloatType>& init_kernel, std::size_t up, std::size_t down)
+         : Resampler1D(up, down)
+   {
+      set_kernel(init_kernel);
+   }
+
+   // Set the prototype kernel and split it into polyphase sub-kernels; the
+   // stream is reset
+   inline void set_kernel(const ConstArrayView1D<FloatType>& k)
+   {
+      kernel_size = k.size();
+      if ( kernel_size == 0 )
+      {
+         throw std::invalid_argument("Empty convolution kernel");
+      }
+      phase_size = (kernel_size + up - 1) / up;
+
+      branches.clear();
+      branch_taps.clear();
+      residue_begin.assign(1, 0);
+      max_extent = 0;
+      for ( std::size_t r = 0; r < period; r++ )
+      {
+         const std::size_t start = r * down / up;
+         const std::size_t phase = r * down % up;
+         // taps of output r in input order: x(start + i) * g(i)
+         auto g = [&](std::size_t i) {
+            const std::size_t j = phase + (phase_size - 1 - i) * up;
+            return j < kernel_size ? k(j) : FloatType(0);
+         };
+         for ( std::size_t p = 0; p < step; p++ )
+         {
+            const std::size_t first = (p + step - start % step) % step;
+            if ( first >= phase_size )
+               continue;
+            const std::size_t size = (phase_size - first + step - 1) / step;
+
+            Branch branch{p, (start + first) / step, branch_taps.size(), size};
+            bool nonzero = false;
+            for ( std::size_t q = 0; q < size; q++ )
+            {
+               branch_taps.push_back(g(first + q * step));
+               nonzero = nonzero || branch_taps.back() != FloatType(0);
+            }
+            if ( !nonzero )
+            {
+               branch_taps.resize(branch.offset);
+               continue;
+            }
+            branches.push_back(branch);
+            max_extent = std::max(max_extent, branch.lag + size);
+         }
+         residue_begin.push_back(branches.size());
+      }
+      reset();
+   }
+
+   // Number of outputs for an input of input_size samples
+   inline std::size_t output_size(std::size_t input_size) const
+   {
+      // outputs m with floor(m * down / up) <= input_size - phase_size
+      if ( input_size < phase_size || phase_size == 0 )
+         return 0;
+      return ((input_size - phase_size + 1) * up + down - 1) / down;
+   }
+
+   // Resample a whole signal
+   inline Array1D<FloatType> conv(const ConstArrayView1D<FloatType>& x) const
+   {
+      Array1D<FloatType> y(output_size(x.size()));
+      conv_into(x, y);
+      return y;
+   }
+
+   // Resample a whole signal into a caller-owned buffer
+   inline void conv_into(const ConstArrayView1D<FloatType>& x, ArrayView1D<FloatType> y) const
+   {
+      if ( !x.contiguous() || !y.contiguous() )
+      {
+         conv1d_contiguous(x, y, [&](auto xc, auto yc) { conv_into(xc, yc); });
+         return;
+      }
+      FASTCONV_PERF_SCOPE("resample", kernel_size, y.size());
+      if ( y.size() != output_size(x.size()) )
+      {
+         throw std::runtime_error("Incorrect output size for resampling");
+      }
+      run(x.data_ptr(), 0, x.size(), 0, y.size(), y.data_ptr());
+   }
+
+   // Forget the stream history, the next push starts a new stream
+   inline void reset()
+   {
+      buffer_start = 0;
+      buffer_size = 0;
+      next_output = 0;
+   }
+
+   // Number of outputs the next push of chunk_size samples will emit
+   inline std::size_t stream_output_size(std::size_t chunk_size) const
+   {
+      return output_size(buffer_start + buffer_size + chunk_size) - next_output;
+   }
+
+   // Resample the next chunk of a stream; y must have stream_output_size(x.size())
+   // elements. The concatenated outputs equal conv() of the concatenated input.
+   inline void push(const ConstArrayView1D<FloatType>& x, ArrayView1D<FloatType> y)
+   {
+      if ( !x.contiguous() || !y.contiguous() )
+      {
+         conv1d_contiguous(x, y, [&](auto xc, auto yc) { push(xc, yc); });
+         return;
+      }
+      const std::size_t count = stream_output_size(x.size());
+      if ( y.size() != count )
+      {
+         throw std::runtime_error("Incorrect output size for resampling");
+      }
+
+      // the buffer holds the samples still needed, followed by the chunk; it
+      // only grows when a chunk is larger than all previous ones
+      const std::size_t total = buffer_size + x.size();
+      if ( buffer.size() < total )
+      {
+         buffer.resize(total);
+      }
+      std::copy(x.data_ptr(), x.data_ptr() + x.size(), buffer.data() + buffer_size);
+      run(buffer.data(), buffer_start, total, next_output, next_output + count, y.data_ptr());
+      next_output += count;
+
+      // keep the samples from the first input of the next output on
+      const std::size_t end = buffer_start + total;
+      const std::size_t keep_from
+            = std::min(next_output / period * step + next_output % period * down / up, end);
+      std::copy(buffer.data() + (keep_from - buffer_start), buffer.data() + total, buffer.data());
+      buffer_size = end - keep_from;
+      buffer_start = keep_from;
+   }
+
+ private:
+   // Dense sub-kernel applied to input phase `phase` of a residue
+   struct Branch
+   {
+      std::size_t phase;  // Input phase (index modulo step)
+      std::size_t lag;    // Row of the phase read by the first output of a block
+      std::size_t offset; // Position of the taps in branch_taps
+      std::size_t size;   // Number of taps
+   };
+
+   // Outputs [m_begin, m_end) from the samples x[0, x_size), which are input
+   // samples x_start onwards
+   inline void run(const FloatType* x, std::size_t x_start, std::size_t x_size, std::size_t m_begin,
+         std::size_t m_end, FloatType* y) const
+   {
+      if ( m_begin >= m_end )
+         return;
+
+      const std::size_t t_begin = m_begin / period;
+      const std::size_t t_end = (m_end - 1) / period + 1;
+      const std::size_t frames = std::max<std::size_t>(FASTCONV_RESAMPLE_BLOCK / period, 256);
+      const std::size_t num_blocks = (t_end - t_begin + frames - 1) / frames;
+
+      auto run_block = [&](std::size_t b) {
+         const std::size_t t0 = t_begin + b * frames;
+         const std::size_t t1 = std::min(t0 + frames, t_end);
+         run_frames(x, x_start, x_size, m_begin, m_end, t0, t1, y);
+      };
+
+      if ( pool && pool->size() > 1 && (m_end - m_begin) * phase_size >= parallel_threshold
+            && num_blocks > 1 )
+      {
+         pool->parallel_for(num_blocks, run_block);
+      }
+      else
+      {
+         for ( std::size_t b = 0; b < num_blocks; b++ )
+         {
+            run_block(b);
+         }
+      }
+   }
+
+   // Frames [t0, t1): frame t holds the outputs t * period + r, r < period
+   inline void run_frames(const FloatType* x, std::size_t x_start, std::size_t x_size, std::size_t m_begin,
+         std::size_t m_end, std::size_t t0, std::size_t t1, FloatType* y) const
+   {
+      // row c of input phase p is sample base + c * step + p
+      const std::size_t base = t0 * step;
+      const std::size_t rows = t1 - t0 + max_extent;
+      const std::size_t ld = (rows + 15) / 16 * 16 + 16;
+
+      thread_local std::vector<FloatType> acc, partial;
+      const std::vector<FloatType>& phases = phases_buffer();
+      if ( step > 1 )
+      {
+         deinterleave(x, x_start, x_size, base, rows, ld);
+      }
+
+      for ( std::size_t r = 0; r < period; r++ )
+      {
+         // frames of this block whose output r is requested
+         const std::size_t ta = std::max(t0, m_begin <= r ? 0 : (m_begin - r + period - 1) / period);
+         const std::size_t tb = std::min(t1, m_end <= r ? 0 : (m_end - r + period - 1) / period);
+         if ( ta >= tb )
+            continue;
+         const std::size_t count = tb - ta;
+         acc.assign(count, FloatType(0));
+         partial.resize(count);
+
+         for ( std::size_t n = residue_begin[r]; n < residue_begin[r + 1]; n++ )
+         {
+            const Branch& branch = branches[n];
+            const std::size_t c = branch.lag + (ta - t0);
+            const FloatType* src
+                  = step > 1 ? phases.data() + branch.phase * ld + c : x + (base + c - x_start);
+            const ConstArrayView1D<FloatType> xb(src, count + branch.size - 1);
+            const ConstArrayView1D<FloatType> kb(branch_taps.data() + branch.offset, branch.size);
+            if ( n == residue_begin[r] )
+            {
+               conv1d_core<FloatType>(xb, kb, ArrayView1D<FloatType>(acc.data(), count));
+               continue;
+            }
+            conv1d_core<FloatType>(xb, kb, ArrayView1D<FloatType>(partial.data(), count));
+            for ( std::size_t i = 0; i < count; i++ )
+            {
+               acc[i] += partial[i];
+            }
+         }
+
+         FloatType* out = y + (ta * period + r - m_begin);
+         for ( std::size_t i = 0; i < count; i++ )
+         {
+            out[i * period] = acc[i];
+         }
+      }
+   }
+
+   // Per-thread scratch for the deinterleaved input phases
+   static inline std::vector<FloatType>& phases_buffer()
+   {
+      thread_local std::vector<FloatType> phases;
+      return phases;
+   }
+
+   // Split input rows [0, rows) of the block into the step input phases;
+   // samples outside x (only read for outputs that are not requested) are 0
+   inline void deinterleave(const FloatType* x, std::size_t x_start, std::size_t x_size, std::size_t base,
+         std::size_t rows, std::size_t ld) const
+   {
+      std::vector<FloatType>& phases = phases_buffer();
+      phases.resize(step * ld);
+
+      const std::size_t x_end = x_start + x_size;
+      const std::size_t c_lo = std::min(rows, base >= x_start ? 0 : (x_start - base + step - 1) / step);
+      const std::size_t c_hi = std::max(c_lo, std::min(rows, x_end >= base ? (x_end - base) / step : 0));
+      if ( c_hi > c_lo )
+      {
+         conv1d_deinterleave(x + (base + c_lo * step - x_start), phases.data() + c_lo, c_hi - c_lo, ld,
+               step);
+      }
+      for ( std::size_t c = 0; c < rows; c++ )
+      {
+         if ( c == c_lo )
+            c = c_hi;
+         if ( c >= rows )
+            break;
+         for ( std::size_t p = 0; p < step; p++ )
+         {
+            const std::size_t i = base + c * step + p;
+            phases[p * ld + c] = i >= x_start && i < x_end ? x[i - x_start] : FloatType(0);
+         }
+      }
+   }
+
+   std::size_t up, down;                  // Resampling factors
+   std::size_t period;                    // Outputs per frame, up / gcd(up, down)
+   std::size_t step;                      // Input samples per frame, down / gcd(up, down)
+   std::size_t kernel_size;               // Size of the prototype kernel
+   std::size_t phase_size;                // Taps per output, ceil(kernel_size / up)
+   std::size_t max_extent;                // Phase rows read beyond the first frame, plus one
+   std::vector<Branch> branches;          // Sub-kernels, grouped by residue
+   std::vector<std::size_t> residue_begin; // First branch of each residue
+   std::vector<FloatType> branch_taps;    // Taps of all sub-kernels
+   std::vector<FloatType> buffer;         // Stream history followed by the current chunk
+   std::size_t buffer_start;              // Input index of buffer[0]
+   std::size_t buffer_size;               // Number of history samples in buffer
+   std::size_t next_output;               // Index of the next output of the stream
+};
+
+#endif // RESAMPLE_HPP
@@ -0,0 +1,168 @@
+#ifndef CONV1D_RFFT_HPP
+#define CONV1D_RFFT_HPP
+
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// Self-contained FFT of real sequences with a power-of-two length n. The
+// transform is computed as a complex FFT of length n/2 on the even/odd
+// samples packed into real/imaginary parts, followed by a split step.
+template <typename FloatType>
+class RealFFT
+{
+ public:
+   using Complex = std::complex<FloatType>;
+
+   inline RealFFT()
+         : n(0), m(0)
+   {
+   }
+
+   inline explicit RealFFT(std::size_t size)
+   {
+      plan(size);
+   }
+
+   // Precompute bit reversal and twiddle tables for the given length
+   inline void plan(std::size_t size)
+   {
+      if ( size < 4 || (size & (size - 1)) != 0 )
+      {
+         throw std::invalid_argument("RealFFT size must be a power of two >= 4");
+      }
+      n = size;
+      m = size / 2;
+
+      std::size_t log2m = 0;
+      while ( (std::size_t(1) << log2m) < m )
+         log2m++;
+      bitrev.resize(m);
+      for ( std::size_t i = 0; i < m; i++ )
+      {
+         std::size_t r = 0;
+         for ( std::size_t b = 0; b < log2m; b++ )
+            r |= ((i >> b) & 1) << (log2m - 1 - b);
+         bitrev[i] = r;
+      }
+
+      // twiddles of all butterfly stages stored back to back, stage with
+      // half-length h starts at offset h - 1
+      const double pi = std::acos(-1.0);
+      stage_twiddles.resize(m > 1 ? m - 1 : 0);
+      for ( std::size_t h = 1; h < m; h *= 2 )
+      {
+         for ( std::size_t j = 0; j < h; j++ )
+         {
+            stage_twiddles[h - 1 + j] = Complex(std::cos(-pi * j / h), std::sin(-pi * j / h));
+         }
+      }
+
+      split_twiddles.resize(m);
+      for ( std::size_t k = 0; k < m; k++ )
+      {
+         split_twiddles[k] = Complex(std::cos(-2 * pi * k / n), std::sin(-2 * pi * k / n));
+      }
+   }
+
+   inline std::size_t size() const
+   {
+      return n;
+   }
+
+   // Spectrum bins 0..n/2 of the real input x(0..n-1)
+   inline void forward(const FloatType* x, Complex* spectrum) const
+   {
+      for ( std::size_t i = 0; i < m; i++ )
+      {
+         spectrum[bitrev[i]] = Complex(x[2 * i], x[2 * i + 1]);
+      }
+      transform(spectrum, false);
+
+      const Complex z0 = spectrum[0];
+      spectrum[0] = Complex(z0.real() + z0.imag(), 0);
+      spectrum[m] = Complex(z0.real() - z0.imag(), 0);
+      for ( std::size_t k = 1; k <= m / 2; k++ )
+      {
+         const Complex a = spectrum[k], b = spectrum[m - k];
+         spectrum[k] = split(a, std::conj(b), split_twiddles[k]);
+         spectrum[m - k] = split(b, std::conj(a), split_twiddles[m - k]);
+      }
+   }
+
+   // Real sequence x(0..n-1) from spectrum bins 0..n/2, including the 1/n
+   // scaling. The spectrum is used as scratch space and overwritten.
+   inline void inverse(Complex* spectrum, FloatType* x) const
+   {
+      for ( std::size_t k = 0; k <= m / 2; k++ )
+      {
+         const Complex a = spectrum[k], b = spectrum[m - k];
+         spectrum[k] = unsplit(a, std::conj(b), split_twiddles[k]);
+         spectrum[m - k] = unsplit(b, std::conj(a), std::conj(split_twiddles[k]) * FloatType(-1));
+      }
+      for ( std::size_t i = 0; i < m; i++ )
+      {
+         if ( i < bitrev[i] )
+            std::swap(spectrum[i], spectrum[bitrev[i]]);
+      }
+      transform(spectrum, true);
+
+      const FloatType scale = FloatType(1) / m;
+      for ( std::size_t i = 0; i < m; i++ )
+      {
+         x[2 * i] = spectrum[i].real() * scale;
+         x[2 * i + 1] = spectrum[i].imag() * scale;
+      }
+   }
+
+ private:
+   // plain complex product (avoids the NaN handling of std::complex)
+   static inline Complex mul(const Complex& a, const Complex& b)
+   {
+      return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+   }
+
+   // X(k) from Z(k) and conj(Z(m - k)) of the packed half-length transform
+   static inline Complex split(const Complex& a, const Complex& b, const Complex& w)
+   {
+      const Complex even = (a + b) * FloatType(0.5);
+      const Complex odd = mul(a - b, Complex(0, -0.5));
+      return even + mul(w, odd);
+   }
+
+   // Z(k) from X(k) and conj(X(m - k)), the inverse of split
+   static inline Complex unsplit(const Complex& a, const Complex& b, const Complex& w)
+   {
+      const Complex even = (a + b) * FloatType(0.5);
+      const Complex odd = mul(a - b, std::conj(w)) * FloatType(0.5);
+      return even + mul(Complex(0, 1), odd);
+   }
+
+   // in-place radix-2 butterflies on bit-reversed input
+   inline void transform(Complex* z, bool inverse) const
+   {
+      for ( std::size_t h = 1; h < m; h *= 2 )
+      {
+         const Complex* w = stage_twiddles.data() + h - 1;
+         for ( std::size_t s = 0; s < m; s += 2 * h )
+         {
+            for ( std::size_t j = 0; j < h; j++ )
+            {
+               const Complex wj = inverse ? std::conj(w[j]) : w[j];
+               const Complex t = mul(wj, z[s + j + h]);
+               z[s + j + h] = z[s + j] - t;
+               z[s + j] = z[s + j] + t;
+            }
+         }
+      }
+   }
+
+   std::size_t n, m;
+   std::vector<std::size_t> bitrev;
+   std::vector<Complex> stage_twiddles;
+   std::vector<Complex> split_twiddles;
+};
+
+#endif // CONV1D_RFFT_HPP
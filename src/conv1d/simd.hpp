@@ -0,0 +1,815 @@
+#ifndef CONV1D_SIMD_HPP
+#define CONV1D_SIMD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FASTCONV_X86 1
+#endif
+
+// Instruction sets for which vectorized float kernels are available
+enum class SimdIsa
+{
+   scalar,
+   sse,
+   avx2,
+   avx512
+};
+
+inline const char*
+simd_isa_name(SimdIsa isa)
+{
+   switch ( isa )
+   {
+   case SimdIsa::sse:
+      return "sse";
+   case SimdIsa::avx2:
+      return "avx2";
+   case SimdIsa::avx512:
+      return "avx512";
+   default:
+      return "scalar";
+   }
+}
+
+// Detect the best instruction set supported by the running CPU. The choice
+// can be lowered (never raised) with the FASTCONV_ISA environment variable.
+inline SimdIsa
+simd_isa_detect()
+{
+   SimdIsa isa = SimdIsa::scalar;
+#ifdef FASTCONV_X86
+   __builtin_cpu_init();
+   if ( __builtin_cpu_supports("avx512f") )
+      isa = SimdIsa::avx512;
+   else if ( __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") )
+      isa = SimdIsa::avx2;
+   else if ( __builtin_cpu_supports("sse") )
+      isa = SimdIsa::sse;
+#endif
+
+   const char* buf = std::getenv("FASTCONV_ISA");
+   if ( buf )
+   {
+      for ( SimdIsa req : {SimdIsa::scalar, SimdIsa::sse, SimdIsa::avx2, SimdIsa::avx512} )
+      {
+         if ( std::strcmp(buf, simd_isa_name(req)) == 0 && req < isa )
+            isa = req;
+      }
+   }
+   return isa;
+}
+
+// Instruction set used by conv1d_core, detected once per process
+inline SimdIsa
+simd_isa()
+{
+   static const SimdIsa isa = simd_isa_detect();
+   return isa;
+}
+
+// Kernels whose peeled outputs (alignment head, remainder, or the scalar
+// iterations around a loop the compiler vectorized) must round exactly like
+// the vector body: -ffast-math would otherwise let GCC reassociate the sums
+// and contract mul + add into FMA differently in the two, and the results
+// would depend on how the output range is split and aligned. Used by the SSE
+// and scalar kernels; the AVX2 and AVX-512 kernels spell out their FMAs.
+#if defined(__GNUC__) && !defined(__clang__)
+#define FASTCONV_EXACT_FP __attribute__((optimize("no-associative-math", "fp-contract=off")))
+#define FASTCONV_HAS_EXACT_FP 1
+#else
+#define FASTCONV_EXACT_FP
+#endif
+
+// Whether the kernels for the instruction set in use give the same outputs
+// however the output range is split (threads, blocks, alignment)
+inline bool
+simd_split_invariant()
+{
+#ifdef FASTCONV_HAS_EXACT_FP
+   return true;
+#else
+   return simd_isa() == SimdIsa::avx2 || simd_isa() == SimdIsa::avx512;
+#endif
+}
+
+#ifdef FASTCONV_X86
+
+// Number of leading outputs computed one by one so that the vector stores
+// start at a multiple of `bytes` (0 if y is not float-aligned at all)
+inline std::size_t
+simd_head(const float* y, std::size_t bytes, std::size_t output_size)
+{
+   const std::size_t misalign = reinterpret_cast<std::uintptr_t>(y) % bytes;
+   const std::size_t head = misalign % sizeof(float) != 0 ? 0 : (bytes - misalign) % bytes / sizeof(float);
+   return head < output_size ? head : output_size;
+}
+
+// The kernels below compute y(i) = sum_j k(j) * x(i + j) for a block of
+// outputs held in registers: each tap is broadcast once and multiplied with
+// shifted input vectors. Every output is produced by the same sequence of
+// operations, independent of its position in the block, so splitting the
+// output range never changes the results. A few leading outputs are peeled
+// off so that the vector stores do not straddle cache lines. If K is
+// nonzero, it is the compile-time kernel size and kernel_size is ignored.
+
+__attribute__((target("sse"))) FASTCONV_EXACT_FP inline void
+conv1d_sse_single(const float* x, const float* k, float* y, std::size_t ks, std::size_t begin,
+      std::size_t end)
+{
+   for ( std::size_t i = begin; i < end; ++i )
+   {
+      __m128 acc = _mm_setzero_ps();
+      for ( std::size_t j = 0; j < ks; ++j )
+      {
+         acc = _mm_add_ss(acc, _mm_mul_ss(_mm_set_ss(k[j]), _mm_load_ss(x + i + j)));
+      }
+      _mm_store_ss(y + i, acc);
+   }
+}
+
+template <std::size_t K>
+__attribute__((target("sse"))) FASTCONV_EXACT_FP void
+conv1d_sse(const float* x, const float* k, float* y, std::size_t kernel_size, std::size_t output_size)
+{
+   constexpr std::size_t W = 4, R = 4;
+   const std::size_t ks = K > 0 ? K : kernel_size;
+   std::size_t i = simd_head(y, W * sizeof(float), output_size);
+
+   conv1d_sse_single(x, k, y, ks, 0, i);
+
+   for ( ; i + R * W <= output_size; i += R * W )
+   {
+      __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+      __m128 acc2 = _mm_setzero_ps(), acc3 = _mm_setzero_ps();
+      for ( std::size_t j = 0; j < ks; ++j )
+      {
+         const __m128 kj = _mm_set1_ps(k[j]);
+         const float* xj = x + i + j;
+         acc0 = _mm_add_ps(acc0, _mm_mul_ps(kj, _mm_loadu_ps(xj)));
+         acc1 = _mm_add_ps(acc1, _mm_mul_ps(kj, _mm_loadu_ps(xj + W)));
+         acc2 = _mm_add_ps(acc2, _mm_mul_ps(kj, _mm_loadu_ps(xj + 2 * W)));
+         acc3 = _mm_add_ps(acc3, _mm_mul_ps(kj, _mm_loadu_ps(xj + 3 * W)));
+      }
+      _mm_storeu_ps(y + i, acc0);
+      _mm_storeu_ps(y + i + W, acc1);
+      _mm_storeu_ps(y + i + 2 * W, acc2);
+      _mm_storeu_ps(y + i + 3 * W, acc3);
+   }
+
+   for ( ; i + W <= output_size; i += W )
+   {
+      __m128 acc = _mm_setzero_ps();
+      for ( std::size_t j = 0; j < ks; ++j )
+      {
+         acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(k[j]), _mm_loadu_ps(x + i + j)));
+      }
+      _mm_storeu_ps(y + i, acc);
+   }
+
+   conv1d_sse_single(x, k, y, ks, i, output_size);
+}
+
+__attribute__((target("avx2,fma"))) inline void
+conv1d_avx2_single(const float* x, const float* k, float* y, std::size_t ks, std::size_t begin,
+      std::size_t end)
+{
+   for ( std::size_t i = begin; i < end; ++i )
+   {
+      __m128 acc = _mm_setzero_ps();
+      for ( std::size_t j = 0; j < ks; ++j )
+      {
+         acc = _mm_fmadd_ss(_mm_set_ss(k[j]), _mm_load_ss(x + i + j), acc);
+      }
+      _mm_store_ss(y + i, acc);
+   }
+}
+
+template <std::size_t K>
+__attribute__((target("avx2,fma"))) void
+conv1d_avx2(const float* x, const float* k, float* y, std::size_t kernel_size, std::size_t output_size)
+{
+   constexpr std::size_t W = 8, R = 4;
+   const std::size_t ks = K > 0 ? K : kernel_size;
+   std::size_t i = simd_head(y, W * sizeof(float), output_size);
+
+   conv1d_avx2_single(x, k, y, ks, 0, i);
+
+   for ( ; i + R * W <= output_size; i += R * W )
+   {
+      __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+      __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+      for ( std::size_t j = 0; j < ks; ++j )
+      {
+         const __m256 kj = _mm256_broadcast_ss(k + j);
+         const float* xj = x + i + j;
+         acc0 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj), acc0);
+         acc1 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj + W), acc1);
+         acc2 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj + 2 * W), acc2);
+         acc3 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj + 3 * W), acc3);
+      }
+      _mm256_storeu_ps(y + i, acc0);
+      _mm256_storeu_ps(y + i + W, acc1);
+      _mm256_storeu_ps(y + i + 2 * W, acc2);
+      _mm256_storeu_ps(y + i + 3 * W, acc3);
+   }
+
+   for ( ; i + W <= output_size; i += W )
+   {
+      __m256 acc = _mm256_setzero_ps();
+      for ( std::size_t j = 0; j < ks; ++j )
+      {
+         acc = _mm256_fmadd_ps(_mm256_broadcast_ss(k + j), _mm256_loadu_ps(x + i + j), acc);
+      }
+      _mm256_storeu_ps(y + i, acc);
+   }
+
+   conv1d_avx2_single(x, k, y, ks, i, output_size);
+}
+
+// Up to 16 outputs starting at i with masked loads and stores
+__attribute__((target("avx512f"))) inline void
+conv1d_avx512_masked(const float* x, const float* k, float* y, std::size_t ks, std::size_t i, std::size_t n)
+{
+   const __mmask16 mask = static_cast<__mmask16>((1u << n) - 1u);
+   __m512 acc = _mm512_setzero_ps();
+   for ( std::size_t j = 0; j < ks; ++j )
+   {
+      acc = _mm512_fmadd_ps(_mm512_set1_ps(k[j]), _mm512_maskz_loadu_ps(mask, x + i + j), acc);
+   }
+   _mm512_mask_storeu_ps(y + i, mask, acc);
+}
+
+template <std::size_t K>
+__attribute__((target("avx512f"))) void
+conv1d_avx512(const float* x, const float* k, float* y, std::size_t kernel_size, std::size_t output_size)
+{
+   constexpr std::size_t W = 16, R = 4;
+   const std::size_t ks = K > 0 ? K : kernel_size;
+   std::size_t i = simd_head(y, W * sizeof(float), output_size);
+
+   if ( i > 0 )
+      conv1d_avx512_masked(x, k, y, ks, 0, i);
+
+   for ( ; i + R * W <= output_size; i += R * W )
+   {
+      __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+      __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+      for ( std::size_t j = 0; j < ks; ++j )
+      {
+         const __m512 kj = _mm512_set1_ps(k[j]);
+         const float* xj = x + i + j;
+         acc0 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj), acc0);
+         acc1 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj + W), acc1);
+         acc2 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj + 2 * W), acc2);
+         acc3 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj + 3 * W), acc3);
+      }
+      _mm512_storeu_ps(y + i, acc0);
+      _mm512_storeu_ps(y + i + W, acc1);
+      _mm512_storeu_ps(y + i + 2 * W, acc2);
+      _mm512_storeu_ps(y + i + 3 * W, acc3);
+   }
+
+   // the remaining outputs use masked loads and stores
+   for ( ; i < output_size; i += W )
+   {
+      conv1d_avx512_masked(x, k, y, ks, i, output_size - i < W ? output_size - i : W);
+   }
+}
+
+// Folded kernels for (anti)symmetric kernels, k(K - 1 - j) = +/- k(j): the
+// mirrored inputs are combined first, y(i) = sum_{j < K/2} k(j) *
+// (x(i + j) +/- x(i + K - 1 - j)) [+ k(K/2) * x(i + K/2) for odd K], which
+// halves the multiplies. Only the first ceil(K/2) taps of k are read; the
+// center tap of an antisymmetric kernel is zero and skipped.
+
+template <bool Anti>
+__attribute__((target("sse"))) FASTCONV_EXACT_FP inline __m128
+simd_fold_sse(__m128 a, __m128 b)
+{
+   return Anti ? _mm_sub_ps(a, b) : _mm_add_ps(a, b);
+}
+
+template <bool Anti>
+__attribute__((target("sse"))) FASTCONV_EXACT_FP inline void
+conv1d_sse_folded_single(const float* x, const float* k, float* y, std::size_t ks, std::size_t begin,
+      std::size_t end)
+{
+   const std::size_t half = ks / 2;
+   for ( std::size_t i = begin; i < end; ++i )
+   {
+      __m128 acc = _mm_setzero_ps();
+      for ( std::size_t j = 0; j < half; ++j )
+      {
+         const __m128 pair = simd_fold_sse<Anti>(_mm_load_ss(x + i + j), _mm_load_ss(x + i + ks - 1 - j));
+         acc = _mm_add_ss(acc, _mm_mul_ss(_mm_set_ss(k[j]), pair));
+      }
+      if ( !Anti && ks % 2 == 1 )
+         acc = _mm_add_ss(acc, _mm_mul_ss(_mm_set_ss(k[half]), _mm_load_ss(x + i + half)));
+      _mm_store_ss(y + i, acc);
+   }
+}
+
+template <std::size_t K, bool Anti>
+__attribute__((target("sse"))) FASTCONV_EXACT_FP void
+conv1d_sse_folded(const float* x, const float* k, float* y, std::size_t kernel_size,
+      std::size_t output_size)
+{
+   constexpr std::size_t W = 4, R = 4;
+   const std::size_t ks = K > 0 ? K : kernel_size;
+   const std::size_t half = ks / 2;
+   std::size_t i = simd_head(y, W * sizeof(float), output_size);
+
+   conv1d_sse_folded_single<Anti>(x, k, y, ks, 0, i);
+
+   for ( ; i + R * W <= output_size; i += R * W )
+   {
+      __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+      __m128 acc2 = _mm_setzero_ps(), acc3 = _mm_setzero_ps();
+      for ( std::size_t j = 0; j < half; ++j )
+      {
+         const __m128 kj = _mm_set1_ps(k[j]);
+         const float* lo = x + i + j;
+         const float* hi = x + i + ks - 1 - j;
+         acc0 = _mm_add_ps(acc0, _mm_mul_ps(kj, simd_fold_sse<Anti>(_mm_loadu_ps(lo), _mm_loadu_ps(hi))));
+         acc1 = _mm_add_ps(acc1,
+               _mm_mul_ps(kj, simd_fold_sse<Anti>(_mm_loadu_ps(lo + W), _mm_loadu_ps(hi + W))));
+         acc2 = _mm_add_ps(acc2,
+               _mm_mul_ps(kj, simd_fold_sse<Anti>(_mm_loadu_ps(lo + 2 * W), _mm_loadu_ps(hi + 2 * W))));
+         acc3 = _mm_add_ps(acc3,
+               _mm_mul_ps(kj, simd_fold_sse<Anti>(_mm_loadu_ps(lo + 3 * W), _mm_loadu_ps(hi + 3 * W))));
+      }
+      if ( !Anti && ks % 2 == 1 )
+      {
+         const __m128 kc = _mm_set1_ps(k[half]);
+         const float* xc = x + i + half;
+         acc0 = _mm_add_ps(acc0, _mm_mul_ps(kc, _mm_loadu_ps(xc)));
+         acc1 = _mm_add_ps(acc1, _mm_mul_ps(kc, _mm_loadu_ps(xc + W)));
+         acc2 = _mm_add_ps(acc2, _mm_mul_ps(kc, _mm_loadu_ps(xc + 2 * W)));
+         acc3 = _mm_add_ps(acc3, _mm_mul_ps(kc, _mm_loadu_ps(xc + 3 * W)));
+      }
+      _mm_storeu_ps(y + i, acc0);
+      _mm_storeu_ps(y + i + W, acc1);
+      _mm_storeu_ps(y + i + 2 * W, acc2);
+      _mm_storeu_ps(y + i + 3 * W, acc3);
+   }
+
+   conv1d_sse_folded_single<Anti>(x, k, y, ks, i, output_size);
+}
+
+template <bool Anti>
+__attribute__((target("avx2,fma"))) inline void
+conv1d_avx2_folded_single(const float* x, const float* k, float* y, std::size_t ks, std::size_t begin,
+      std::size_t end)
+{
+   const std::size_t half = ks / 2;
+   for ( std::size_t i = begin; i < end; ++i )
+   {
+      __m128 acc = _mm_setzero_ps();
+      for ( std::size_t j = 0; j < half; ++j )
+      {
+         const __m128 a = _mm_load_ss(x + i + j), b = _mm_load_ss(x + i + ks - 1 - j);
+         acc = _mm_fmadd_ss(_mm_set_ss(k[j]), Anti ? _mm_sub_ss(a, b) : _mm_add_ss(a, b), acc);
+      }
+      if ( !Anti && ks % 2 == 1 )
+         acc = _mm_fmadd_ss(_mm_set_ss(k[half]), _mm_load_ss(x + i + half), acc);
+      _mm_store_ss(y + i, acc);
+   }
+}
+
+template <bool Anti>
+__attribute__((target("avx2,fma"))) inline __m256
+simd_fold_avx2(const float* a, const float* b)
+{
+   return Anti ? _mm256_sub_ps(_mm256_loadu_ps(a), _mm256_loadu_ps(b))
+               : _mm256_add_ps(_mm256_loadu_ps(a), _mm256_loadu_ps(b));
+}
+
+template <std::size_t K, bool Anti>
+__attribute__((target("avx2,fma"))) void
+conv1d_avx2_folded(const float* x, const float* k, float* y, std::size_t kernel_size,
+      std::size_t output_size)
+{
+   constexpr std::size_t W = 8, R = 4;
+   const std::size_t ks = K > 0 ? K : kernel_size;
+   const std::size_t half = ks / 2;
+   std::size_t i = simd_head(y, W * sizeof(float), output_size);
+
+   conv1d_avx2_folded_single<Anti>(x, k, y, ks, 0, i);
+
+   for ( ; i + R * W <= output_size; i += R * W )
+   {
+      __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+      __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+      for ( std::size_t j = 0; j < half; ++j )
+      {
+         const __m256 kj = _mm256_broadcast_ss(k + j);
+         const float* lo = x + i + j;
+         const float* hi = x + i + ks - 1 - j;
+         acc0 = _mm256_fmadd_ps(kj, simd_fold_avx2<Anti>(lo, hi), acc0);
+         acc1 = _mm256_fmadd_ps(kj, simd_fold_avx2<Anti>(lo + W, hi + W), acc1);
+         acc2 = _mm256_fmadd_ps(kj, simd_fold_avx2<Anti>(lo + 2 * W, hi + 2 * W), acc2);
+         acc3 = _mm256_fmadd_ps(kj, simd_fold_avx2<Anti>(lo + 3 * W, hi + 3 * W), acc3);
+      }
+      if ( !Anti && ks % 2 == 1 )
+      {
+         const __m256 kc = _mm256_broadcast_ss(k + half);
+         const float* xc = x + i + half;
+         acc0 = _mm256_fmadd_ps(kc, _mm256_loadu_ps(xc), acc0);
+         acc1 = _mm256_fmadd_ps(kc, _mm256_loadu_ps(xc + W), acc1);
+         acc2 = _mm256_fmadd_ps(kc, _mm256_loadu_ps(xc + 2 * W), acc2);
+         acc3 = _mm256_fmadd_ps(kc, _mm256_loadu_ps(xc + 3 * W), acc3);
+      }
+      _mm256_storeu_ps(y + i, acc0);
+      _mm256_storeu_ps(y + i + W, acc1);
+      _mm256_storeu_ps(y + i + 2 * W, acc2);
+      _mm256_storeu_ps(y + i + 3 * W, acc3);
+   }
+
+   conv1d_avx2_folded_single<Anti>(x, k, y, ks, i, output_size);
+}
+
+// Up to 16 folded outputs starting at i with masked loads and stores
+template <bool Anti>
+__attribute__((target("avx512f"))) inline void
+conv1d_avx512_folded_masked(const float* x, const float* k, float* y, std::size_t ks, std::size_t i,
+      std::size_t n)
+{
+   const __mmask16 mask = static_cast<__mmask16>((1u << n) - 1u);
+   const std::size_t half = ks / 2;
+   __m512 acc = _mm512_setzero_ps();
+   for ( std::size_t j = 0; j < half; ++j )
+   {
+      const __m512 a = _mm512_maskz_loadu_ps(mask, x + i + j);
+      const __m512 b = _mm512_maskz_loadu_ps(mask, x + i + ks - 1 - j);
+      acc = _mm512_fmadd_ps(_mm512_set1_ps(k[j]), Anti ? _mm512_sub_ps(a, b) : _mm512_add_ps(a, b), acc);
+   }
+   if ( !Anti && ks % 2 == 1 )
+      acc = _mm512_fmadd_ps(_mm512_set1_ps(k[half]), _mm512_maskz_loadu_ps(mask, x + i + half), acc);
+   _mm512_mask_storeu_ps(y + i, mask, acc);
+}
+
+template <bool Anti>
+__attribute__((target("avx512f"))) inline __m512
+simd_fold_avx512(const float* a, const float* b)
+{
+   return Anti ? _mm512_sub_ps(_mm512_loadu_ps(a), _mm512_loadu_ps(b))
+               : _mm512_add_ps(_mm512_loadu_ps(a), _mm512_loadu_ps(b));
+}
+
+template <std::size_t K, bool Anti>
+__attribute__((target("avx512f"))) void
+conv1d_avx512_folded(const float* x, const float* k, float* y, std::size_t kernel_size,
+      std::size_t output_size)
+{
+   constexpr std::size_t W = 16, R = 4;
+   const std::size_t ks = K > 0 ? K : kernel_size;
+   const std::size_t half = ks / 2;
+   std::size_t i = simd_head(y, W * sizeof(float), output_size);
+
+   if ( i > 0 )
+      conv1d_avx512_folded_masked<Anti>(x, k, y, ks, 0, i);
+
+   for ( ; i + R * W <= output_size; i += R * W )
+   {
+      __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+      __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+      for ( std::size_t j = 0; j < half; ++j )
+      {
+         const __m512 kj = _mm512_set1_ps(k[j]);
+         const float* lo = x + i + j;
+         const float* hi = x + i + ks - 1 - j;
+         acc0 = _mm512_fmadd_ps(kj, simd_fold_avx512<Anti>(lo, hi), acc0);
+         acc1 = _mm512_fmadd_ps(kj, simd_fold_avx512<Anti>(lo + W, hi + W), acc1);
+         acc2 = _mm512_fmadd_ps(kj, simd_fold_avx512<Anti>(lo + 2 * W, hi + 2 * W), acc2);
+         acc3 = _mm512_fmadd_ps(kj, simd_fold_avx512<Anti>(lo + 3 * W, hi + 3 * W), acc3);
+      }
+      if ( !Anti && ks % 2 == 1 )
+      {
+         const __m512 kc = _mm512_set1_ps(k[half]);
+         const float* xc = x + i + half;
+         acc0 = _mm512_fmadd_ps(kc, _mm512_loadu_ps(xc), acc0);
+         acc1 = _mm512_fmadd_ps(kc, _mm512_loadu_ps(xc + W), acc1);
+         acc2 = _mm512_fmadd_ps(kc, _mm512_loadu_ps(xc + 2 * W), acc2);
+         acc3 = _mm512_fmadd_ps(kc, _mm512_loadu_ps(xc + 3 * W), acc3);
+      }
+      _mm512_storeu_ps(y + i, acc0);
+      _mm512_storeu_ps(y + i + W, acc1);
+      _mm512_storeu_ps(y + i + 2 * W, acc2);
+      _mm512_storeu_ps(y + i + 3 * W, acc3);
+   }
+
+   for ( ; i < output_size; i += W )
+   {
+      conv1d_avx512_folded_masked<Anti>(x, k, y, ks, i, output_size - i < W ? output_size - i : W);
+   }
+}
+
+// Batched kernels: four rows (signals) at once, so that every tap broadcast
+// is shared by 4 rows x 2 vectors of outputs. They cover the largest multiple
+// of 2 vectors of outputs per row and return its size; the caller finishes
+// the remaining outputs with the single-row kernels, which perform the same
+// operations per output.
+
+template <std::size_t K>
+__attribute__((target("avx2,fma"))) std::size_t
+conv1d_avx2_rows4(const float* x, std::size_t x_stride, const float* k, float* y, std::size_t y_stride,
+      std::size_t kernel_size, std::size_t output_size)
+{
+   constexpr std::size_t W = 8, R = 4, V = 2;
+   const std::size_t ks = K > 0 ? K : kernel_size;
+   std::size_t i = 0;
+
+   for ( ; i + V * W <= output_size; i += V * W )
+   {
+      __m256 acc[R][V];
+      for ( std::size_t r = 0; r < R; r++ )
+         for ( std::size_t v = 0; v < V; v++ )
+            acc[r][v] = _mm256_setzero_ps();
+
+      for ( std::size_t j = 0; j < ks; ++j )
+      {
+         const __m256 kj = _mm256_broadcast_ss(k + j);
+         for ( std::size_t r = 0; r < R; r++ )
+            for ( std::size_t v = 0; v < V; v++ )
+               acc[r][v]
+                     = _mm256_fmadd_ps(kj, _mm256_loadu_ps(x + r * x_stride + i + j + v * W), acc[r][v]);
+      }
+
+      for ( std::size_t r = 0; r < R; r++ )
+         for ( std::size_t v = 0; v < V; v++ )
+            _mm256_storeu_ps(y + r * y_stride + i + v * W, acc[r][v]);
+   }
+   return i;
+}
+
+template <std::size_t K>
+__attribute__((target("avx512f"))) std::size_t
+conv1d_avx512_rows4(const float* x, std::size_t x_stride, const float* k, float* y, std::size_t y_stride,
+      std::size_t kernel_size, std::size_t output_size)
+{
+   constexpr std::size_t W = 16, R = 4, V = 2;
+   const std::size_t ks = K > 0 ? K : kernel_size;
+   std::size_t i = 0;
+
+   for ( ; i + V * W <= output_size; i += V * W )
+   {
+      __m512 acc[R][V];
+      for ( std::size_t r = 0; r < R; r++ )
+         for ( std::size_t v = 0; v < V; v++ )
+            acc[r][v] = _mm512_setzero_ps();
+
+      for ( std::size_t j = 0; j < ks; ++j )
+      {
+         const __m512 kj = _mm512_set1_ps(k[j]);
+         for ( std::size_t r = 0; r < R; r++ )
+            for ( std::size_t v = 0; v < V; v++ )
+               acc[r][v]
+                     = _mm512_fmadd_ps(kj, _mm512_loadu_ps(x + r * x_stride + i + j + v * W), acc[r][v]);
+      }
+
+      for ( std::size_t r = 0; r < R; r++ )
+         for ( std::size_t v = 0; v < V; v++ )
+            _mm512_storeu_ps(y + r * y_stride + i + v * W, acc[r][v]);
+   }
+   return i;
+}
+
+// Register-tiled kernels for long kernels: a pass over the taps accumulates
+// eight vectors of outputs, enough independent FMA chains to hide the FMA
+// latency (the kernels above keep four, which long tap loops cannot overlap
+// with the next block). With accumulate, the partial sums already in y are
+// continued, so a kernel split into consecutive tap blocks performs the same
+// operations per output as one pass, and as the kernels above.
+
+__attribute__((target("avx2,fma"))) inline void
+conv1d_avx2_tile(const float* x, const float* k, float* y, std::size_t kernel_size, std::size_t output_size,
+      bool accumulate)
+{
+   constexpr std::size_t W = 8, R = 8;
+   std::size_t i = 0;
+
+   for ( ; i + R * W <= output_size; i += R * W )
+   {
+      __m256 acc0 = accumulate ? _mm256_loadu_ps(y + i) : _mm256_setzero_ps();
+      __m256 acc1 = accumulate ? _mm256_loadu_ps(y + i + W) : _mm256_setzero_ps();
+      __m256 acc2 = accumulate ? _mm256_loadu_ps(y + i + 2 * W) : _mm256_setzero_ps();
+      __m256 acc3 = accumulate ? _mm256_loadu_ps(y + i + 3 * W) : _mm256_setzero_ps();
+      __m256 acc4 = accumulate ? _mm256_loadu_ps(y + i + 4 * W) : _mm256_setzero_ps();
+      __m256 acc5 = accumulate ? _mm256_loadu_ps(y + i + 5 * W) : _mm256_setzero_ps();
+      __m256 acc6 = accumulate ? _mm256_loadu_ps(y + i + 6 * W) : _mm256_setzero_ps();
+      __m256 acc7 = accumulate ? _mm256_loadu_ps(y + i + 7 * W) : _mm256_setzero_ps();
+      for ( std::size_t j = 0; j < kernel_size; ++j )
+      {
+         const __m256 kj = _mm256_broadcast_ss(k + j);
+         const float* xj = x + i + j;
+         acc0 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj), acc0);
+         acc1 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj + W), acc1);
+         acc2 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj + 2 * W), acc2);
+         acc3 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj + 3 * W), acc3);
+         acc4 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj + 4 * W), acc4);
+         acc5 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj + 5 * W), acc5);
+         acc6 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj + 6 * W), acc6);
+         acc7 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj + 7 * W), acc7);
+      }
+      _mm256_storeu_ps(y + i, acc0);
+      _mm256_storeu_ps(y + i + W, acc1);
+      _mm256_storeu_ps(y + i + 2 * W, acc2);
+      _mm256_storeu_ps(y + i + 3 * W, acc3);
+      _mm256_storeu_ps(y + i + 4 * W, acc4);
+      _mm256_storeu_ps(y + i + 5 * W, acc5);
+      _mm256_storeu_ps(y + i + 6 * W, acc6);
+      _mm256_storeu_ps(y + i + 7 * W, acc7);
+   }
+
+   for ( ; i + W <= output_size; i += W )
+   {
+      __m256 acc = accumulate ? _mm256_loadu_ps(y + i) : _mm256_setzero_ps();
+      for ( std::size_t j = 0; j < kernel_size; ++j )
+      {
+         acc = _mm256_fmadd_ps(_mm256_broadcast_ss(k + j), _mm256_loadu_ps(x + i + j), acc);
+      }
+      _mm256_storeu_ps(y + i, acc);
+   }
+
+   for ( ; i < output_size; ++i )
+   {
+      __m128 acc = accumulate ? _mm_load_ss(y + i) : _mm_setzero_ps();
+      for ( std::size_t j = 0; j < kernel_size; ++j )
+      {
+         acc = _mm_fmadd_ss(_mm_set_ss(k[j]), _mm_load_ss(x + i + j), acc);
+      }
+      _mm_store_ss(y + i, acc);
+   }
+}
+
+__attribute__((target("avx512f"))) inline void
+conv1d_avx512_tile(const float* x, const float* k, float* y, std::size_t kernel_size,
+      std::size_t output_size, bool accumulate)
+{
+   constexpr std::size_t W = 16, R = 8;
+   std::size_t i = 0;
+
+   for ( ; i + R * W <= output_size; i += R * W )
+   {
+      __m512 acc0 = accumulate ? _mm512_loadu_ps(y + i) : _mm512_setzero_ps();
+      __m512 acc1 = accumulate ? _mm512_loadu_ps(y + i + W) : _mm512_setzero_ps();
+      __m512 acc2 = accumulate ? _mm512_loadu_ps(y + i + 2 * W) : _mm512_setzero_ps();
+      __m512 acc3 = accumulate ? _mm512_loadu_ps(y + i + 3 * W) : _mm512_setzero_ps();
+      __m512 acc4 = accumulate ? _mm512_loadu_ps(y + i + 4 * W) : _mm512_setzero_ps();
+      __m512 acc5 = accumulate ? _mm512_loadu_ps(y + i + 5 * W) : _mm512_setzero_ps();
+      __m512 acc6 = accumulate ? _mm512_loadu_ps(y + i + 6 * W) : _mm512_setzero_ps();
+      __m512 acc7 = accumulate ? _mm512_loadu_ps(y + i + 7 * W) : _mm512_setzero_ps();
+      for ( std::size_t j = 0; j < kernel_size; ++j )
+      {
+         const __m512 kj = _mm512_set1_ps(k[j]);
+         const float* xj = x + i + j;
+         acc0 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj), acc0);
+         acc1 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj + W), acc1);
+         acc2 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj + 2 * W), acc2);
+         acc3 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj + 3 * W), acc3);
+         acc4 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj + 4 * W), acc4);
+         acc5 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj + 5 * W), acc5);
+         acc6 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj + 6 * W), acc6);
+         acc7 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj + 7 * W), acc7);
+      }
+      _mm512_storeu_ps(y + i, acc0);
+      _mm512_storeu_ps(y + i + W, acc1);
+      _mm512_storeu_ps(y + i + 2 * W, acc2);
+      _mm512_storeu_ps(y + i + 3 * W, acc3);
+      _mm512_storeu_ps(y + i + 4 * W, acc4);
+      _mm512_storeu_ps(y + i + 5 * W, acc5);
+      _mm512_storeu_ps(y + i + 6 * W, acc6);
+      _mm512_storeu_ps(y + i + 7 * W, acc7);
+   }
+
+   for ( ; i < output_size; i += W )
+   {
+      const std::size_t n = output_size - i < W ? output_size - i : W;
+      const __mmask16 mask = static_cast<__mmask16>((1u << n) - 1u);
+      __m512 acc = accumulate ? _mm512_maskz_loadu_ps(mask, y + i) : _mm512_setzero_ps();
+      for ( std::size_t j = 0; j < kernel_size; ++j )
+      {
+         acc = _mm512_fmadd_ps(_mm512_set1_ps(k[j]), _mm512_maskz_loadu_ps(mask, x + i + j), acc);
+      }
+      _mm512_mask_storeu_ps(y + i, mask, acc);
+   }
+}
+
+// Sparse kernels: y(i) = sum_j k[j] * x(i + offsets[j]) over the num_taps
+// nonzero taps of a kernel, blocked over outputs like the tiled kernels. The
+// taps are visited in increasing offset order, so an output gets the same
+// FMAs as from the dense kernel minus those with a zero tap.
+
+__attribute__((target("avx2,fma"))) inline void
+conv1d_avx2_sparse(const float* x, const std::size_t* offsets, const float* k, float* y,
+      std::size_t num_taps, std::size_t output_size)
+{
+   constexpr std::size_t W = 8, R = 8;
+   std::size_t i = 0;
+
+   for ( ; i + R * W <= output_size; i += R * W )
+   {
+      __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps(), acc2 = _mm256_setzero_ps();
+      __m256 acc3 = _mm256_setzero_ps(), acc4 = _mm256_setzero_ps(), acc5 = _mm256_setzero_ps();
+      __m256 acc6 = _mm256_setzero_ps(), acc7 = _mm256_setzero_ps();
+      for ( std::size_t j = 0; j < num_taps; ++j )
+      {
+         const __m256 kj = _mm256_broadcast_ss(k + j);
+         const float* xj = x + i + offsets[j];
+         acc0 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj), acc0);
+         acc1 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj + W), acc1);
+         acc2 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj + 2 * W), acc2);
+         acc3 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj + 3 * W), acc3);
+         acc4 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj + 4 * W), acc4);
+         acc5 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj + 5 * W), acc5);
+         acc6 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj + 6 * W), acc6);
+         acc7 = _mm256_fmadd_ps(kj, _mm256_loadu_ps(xj + 7 * W), acc7);
+      }
+      _mm256_storeu_ps(y + i, acc0);
+      _mm256_storeu_ps(y + i + W, acc1);
+      _mm256_storeu_ps(y + i + 2 * W, acc2);
+      _mm256_storeu_ps(y + i + 3 * W, acc3);
+      _mm256_storeu_ps(y + i + 4 * W, acc4);
+      _mm256_storeu_ps(y + i + 5 * W, acc5);
+      _mm256_storeu_ps(y + i + 6 * W, acc6);
+      _mm256_storeu_ps(y + i + 7 * W, acc7);
+   }
+
+   for ( ; i + W <= output_size; i += W )
+   {
+      __m256 acc = _mm256_setzero_ps();
+      for ( std::size_t j = 0; j < num_taps; ++j )
+      {
+         acc = _mm256_fmadd_ps(_mm256_broadcast_ss(k + j), _mm256_loadu_ps(x + i + offsets[j]), acc);
+      }
+      _mm256_storeu_ps(y + i, acc);
+   }
+
+   for ( ; i < output_size; ++i )
+   {
+      __m128 acc = _mm_setzero_ps();
+      for ( std::size_t j = 0; j < num_taps; ++j )
+      {
+         acc = _mm_fmadd_ss(_mm_set_ss(k[j]), _mm_load_ss(x + i + offsets[j]), acc);
+      }
+      _mm_store_ss(y + i, acc);
+   }
+}
+
+__attribute__((target("avx512f"))) inline void
+conv1d_avx512_sparse(const float* x, const std::size_t* offsets, const float* k, float* y,
+      std::size_t num_taps, std::size_t output_size)
+{
+   constexpr std::size_t W = 16, R = 8;
+   std::size_t i = 0;
+
+   for ( ; i + R * W <= output_size; i += R * W )
+   {
+      __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps(), acc2 = _mm512_setzero_ps();
+      __m512 acc3 = _mm512_setzero_ps(), acc4 = _mm512_setzero_ps(), acc5 = _mm512_setzero_ps();
+      __m512 acc6 = _mm512_setzero_ps(), acc7 = _mm512_setzero_ps();
+      for ( std::size_t j = 0; j < num_taps; ++j )
+      {
+         const __m512 kj = _mm512_set1_ps(k[j]);
+         const float* xj = x + i + offsets[j];
+         acc0 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj), acc0);
+         acc1 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj + W), acc1);
+         acc2 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj + 2 * W), acc2);
+         acc3 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj + 3 * W), acc3);
+         acc4 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj + 4 * W), acc4);
+         acc5 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj + 5 * W), acc5);
+         acc6 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj + 6 * W), acc6);
+         acc7 = _mm512_fmadd_ps(kj, _mm512_loadu_ps(xj + 7 * W), acc7);
+      }
+      _mm512_storeu_ps(y + i, acc0);
+      _mm512_storeu_ps(y + i + W, acc1);
+      _mm512_storeu_ps(y + i + 2 * W, acc2);
+      _mm512_storeu_ps(y + i + 3 * W, acc3);
+      _mm512_storeu_ps(y + i + 4 * W, acc4);
+      _mm512_storeu_ps(y + i + 5 * W, acc5);
+      _mm512_storeu_ps(y + i + 6 * W, acc6);
+      _mm512_storeu_ps(y + i + 7 * W, acc7);
+   }
+
+   for ( ; i < output_size; i += W )
+   {
+      const std::size_t n = output_size - i < W ? output_size - i : W;
+      const __mmask16 mask = static_cast<__mmask16>((1u << n) - 1u);
+      __m512 acc = _mm512_setzero_ps();
+      for ( std::size_t j = 0; j < num_taps; ++j )
+      {
+         acc = _mm512_fmadd_ps(_mm512_set1_ps(k[j]), _mm512_maskz_loadu_ps(mask, x + i + offsets[j]), acc);
+      }
+      _mm512_mask_storeu_ps(y + i, mask, acc);
+   }
+}
+
+#endif // FASTCONV_X86
+
+#endif // CONV1D_SIMD_HPP
@@ -0,0 +1,227 @@
+#ifndef CONV1D_SPARSE_HPP
+#define CONV1D_SPARSE_HPP
+
+#include "boundary.hpp"
+#include "conv1.hpp"
+#include "core.hpp"
+#include "dispatch.hpp"
+#include "parallel.hpp"
+#include "perf.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// Kernels whose fraction of nonzero taps is at most this are stored as
+// (offset, value) pairs; denser ones run through conv1d_core
+#ifndef FASTCONV_SPARSE_DENSITY
+#define FASTCONV_SPARSE_DENSITY 0.5
+#endif
+
+// Portable sparse kernel: blocks of outputs stay in L1 while every nonzero tap
+// is added to the whole block, a loop the compiler vectorizes across outputs
+template <typename FloatType>
+void
+conv1d_sparse_generic(const FloatType* x, const std::size_t* offsets, const FloatType* k, FloatType* y,
+      std::size_t num_taps, std::size_t output_size)
+{
+   constexpr std::size_t B = 256;
+   for ( std::size_t o = 0; o < output_size; o += B )
+   {
+      const std::size_t n = std::min(B, output_size - o);
+      FloatType* yo = y + o;
+      std::fill(yo, yo + n, FloatType(0));
+      for ( std::size_t j = 0; j < num_taps; ++j )
+      {
+         const FloatType kj = k[j];
+         const FloatType* xj = x + o + offsets[j];
+         for ( std::size_t i = 0; i < n; ++i )
+            yo[i] += kj * xj[i];
+      }
+   }
+}
+
+// y(i) = sum_j values(j) * x(i + offsets[j]), the nonzero taps of a reversed
+// kernel of kernel_size taps; the cost is proportional to the nonzero taps
+template <typename FloatType>
+void
+conv1d_sparse(ConstArrayView1D<FloatType> x, const std::vector<std::size_t>& offsets,
+      ConstArrayView1D<FloatType> values, std::size_t kernel_size, ArrayView1D<FloatType> y)
+{
+   if ( y.size() != x.size() - kernel_size + 1 )
+   {
+      throw std::runtime_error("Incorrect output shape for 1D convolution");
+   }
+   if ( !x.contiguous() || !y.contiguous() )
+   {
+      conv1d_contiguous(x, y, [&](auto xc, auto yc) {
+         conv1d_sparse<FloatType>(xc, offsets, values, kernel_size, yc);
+      });
+      return;
+   }
+   const auto kernel = conv1d_sparse_kernel<FloatType>();
+   if ( kernel )
+      kernel(x.data_ptr(), offsets.data(), values.data_ptr(), y.data_ptr(), offsets.size(), y.size());
+   else
+      conv1d_sparse_generic<FloatType>(x.data_ptr(), offsets.data(), values.data_ptr(), y.data_ptr(),
+            offsets.size(), y.size());
+}
+
+// conv1d_sparse with the output range split into chunks run on the pool
+template <typename FloatType>
+void
+conv1d_sparse_parallel(ConstArrayView1D<FloatType> x, const std::vector<std::size_t>& offsets,
+      ConstArrayView1D<FloatType> values, std::size_t kernel_size, ArrayView1D<FloatType> y,
+      ThreadPool* pool, std::size_t threshold = FASTCONV_PARALLEL_THRESHOLD)
+{
+   const std::size_t output_size = y.size();
+   if ( !pool || pool->size() < 2 || output_size < threshold )
+   {
+      conv1d_sparse<FloatType>(x, offsets, values, kernel_size, y);
+      return;
+   }
+
+   std::size_t chunk = std::min<std::size_t>(FASTCONV_PARALLEL_CHUNK, output_size / (4 * pool->size()));
+   chunk = std::max<std::size_t>(128, chunk - chunk % 128);
+   const std::size_t num_chunks = (output_size + chunk - 1) / chunk;
+
+   pool->parallel_for(num_chunks, [&](std::size_t i) {
+      const std::size_t start = i * chunk;
+      const std::size_t end = std::min(start + chunk, output_size);
+      conv1d_sparse<FloatType>(x.view(start, end + kernel_size - 1), offsets, values, kernel_size,
+            y.view(start, end));
+   });
+}
+
+// Class definition for kernels that are mostly zeros (comb filters, templates
+// with gaps, dilated wavelets): set_kernel keeps only the nonzero taps when
+// the kernel is sparse enough, and only those are multiplied, vectorized
+// across outputs. Denser kernels fall back to conv1d_core.
+template <typename FloatType>
+class Conv1DSparse : Conv1DBase<FloatType>, public Conv1DParallel
+{
+ public:
+   // Constructor
+   inline Conv1DSparse(bool preserve_shape = false)
+         : preserve_shape(preserve_shape), density_threshold(FASTCONV_SPARSE_DENSITY), sparse(false),
+           symmetry(Conv1DSymmetry::none), boundary(Conv1DBoundary::zero), boundary_value(0)
+   {
+   }
+   inline Conv1DSparse(const ConstArrayView1D<FloatType>& init_kernel, bool preserve_shape = false)
+         : Conv1DSparse(preserve_shape)
+   {
+      set_kernel(init_kernel);
+   }
+
+   // Set the convolution kernel (reverse it and collect the nonzero taps)
+   inline void set_kernel(const ConstArrayView1D<FloatType>& new_kernel)
+   {
+      kernel = std::move(Array1D<FloatType>(new_kernel.size()));
+      for ( std::size_t i = 0; i < kernel.size(); i++ )
+      {
+         kernel(i) = new_kernel(new_kernel.size() - 1 - i);
+      }
+      update_taps();
+   }
+
+   // Largest fraction of nonzero taps stored sparse (0 always runs dense, 1
+   // always sparse)
+   inline void set_density_threshold(double threshold)
+   {
+      density_threshold = threshold;
+      update_taps();
+   }
+
+   // Whether the current kernel runs on its nonzero taps only
+   inline bool is_sparse() const
+   {
+      return sparse;
+   }
+
+   // Number of nonzero taps
+   inline std::size_t num_taps() const
+   {
+      return offsets.size();
+   }
+
+   // How the input is extended for the edge outputs of preserve_shape
+   inline void set_boundary(Conv1DBoundary mode, FloatType value = 0)
+   {
+      boundary = mode;
+      boundary_value = value;
+   }
+
+   // Compute the output size based on input size
+   inline std::size_t output_size(std::size_t input_size) const
+   {
+      return input_size + (preserve_shape ? 0 : 1 - kernel.size());
+   }
+
+   // Perform the 1D convolution
+   inline Array1D<FloatType> conv(const ConstArrayView1D<FloatType>& x) const
+   {
+      Array1D<FloatType> y(output_size(x.size()));
+      conv_into(x, y);
+      return y;
+   }
+
+   // Perform the 1D convolution into a caller-owned buffer
+   inline void conv_into(const ConstArrayView1D<FloatType>& x, ArrayView1D<FloatType> y) const
+   {
+      FASTCONV_PERF_SCOPE("sparse", offsets.size(), y.size());
+      std::size_t input_size = x.size();
+      if ( y.size() != output_size(input_size) )
+      {
+         throw std::runtime_error("Incorrect output size for 1D convolution");
+      }
+
+      std::size_t kernel_size = kernel.size();
+      std::size_t raw_output_size = input_size >= kernel_size ? input_size - kernel_size + 1 : 0;
+      std::size_t offset = preserve_shape ? (kernel_size - 1) / 2 : 0;
+
+      if ( raw_output_size > 0 )
+      {
+         ArrayView1D<FloatType> interior = y.view(offset, raw_output_size + offset);
+         if ( sparse )
+            conv1d_sparse_parallel<FloatType>(x, offsets, values, kernel_size, interior, pool.get(),
+                  parallel_threshold);
+         else
+            conv1d_core_parallel<FloatType>(x, kernel, interior, pool.get(), parallel_threshold, symmetry);
+      }
+      if ( preserve_shape )
+      {
+         conv1d_boundary<FloatType>(x, kernel, y, boundary, boundary_value, symmetry);
+      }
+   }
+
+ private:
+   inline void update_taps()
+   {
+      offsets.clear();
+      for ( std::size_t i = 0; i < kernel.size(); i++ )
+      {
+         if ( kernel(i) != FloatType(0) )
+            offsets.push_back(i);
+      }
+      values = std::move(Array1D<FloatType>(offsets.size()));
+      for ( std::size_t j = 0; j < offsets.size(); j++ )
+      {
+         values(j) = kernel(offsets[j]);
+      }
+      sparse = kernel.size() > 0 && double(offsets.size()) <= density_threshold * double(kernel.size());
+      symmetry = sparse ? Conv1DSymmetry::none : conv1d_symmetry<FloatType>(kernel);
+   }
+
+   Array1D<FloatType> kernel;        // Reversed convolution kernel
+   std::vector<std::size_t> offsets; // Positions of the nonzero taps in kernel
+   Array1D<FloatType> values;        // Nonzero taps, in the order of offsets
+   bool preserve_shape;              // Preserve shape of the input/output
+   double density_threshold;         // Largest density stored sparse
+   bool sparse;                      // Run on the nonzero taps only
+   Conv1DSymmetry symmetry;          // Symmetry of the dense kernel
+   Conv1DBoundary boundary;          // Extension of the input for the edge outputs
+   FloatType boundary_value;         // Value of Conv1DBoundary::constant
+};
+
+#endif // CONV1D_SPARSE_HPP
@@ -0,0 +1,128 @@
+#ifndef STREAM_HPP
+#define STREAM_HPP
+
+#include "core.hpp"
+#include "myarray.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+// Class definition for streaming 1D convolution: the signal is pushed in
+// chunks of any size and each push emits exactly the outputs that became
+// valid, so the concatenated outputs equal the one-shot (valid) convolution
+// of the concatenated input. The last kernel_size - 1 samples are kept as
+// history; all buffers are sized in set_kernel, pushes do not allocate.
+template <typename FloatType>
+class Conv1DStream
+{
+ public:
+   // Constructor
+   inline Conv1DStream()
+         : kernel_size(0), history_size(0)
+   {
+   }
+   inline Conv1DStream(const ConstArrayView1D<FloatType>& init_kernel)
+   {
+      set_kernel(init_kernel);
+   }
+
+   // Set the convolution kernel (reverse it) and clear the history
+   inline void set_kernel(const ConstArrayView1D<FloatType>& new_kernel)
+   {
+      kernel_size = new_kernel.size();
+      if ( kernel_size == 0 )
+      {
+         throw std::invalid_argument("Empty convolution kernel");
+      }
+      kernel = std::move(Array1D<FloatType>(kernel_size));
+      for ( std::size_t i = 0; i < kernel_size; i++ )
+      {
+         kernel(i) = new_kernel(kernel_size - 1 - i);
+      }
+      history = std::move(Array1D<FloatType>(kernel_size - 1));
+      bridge = std::move(Array1D<FloatType>(2 * (kernel_size - 1)));
+      history_size = 0;
+   }
+
+   // Forget the history, the next push starts a new stream
+   inline void reset()
+   {
+      history_size = 0;
+   }
+
+   // Number of outputs the next push of chunk_size samples will emit; throws
+   // if no kernel has been set
+   inline std::size_t output_size(std::size_t chunk_size) const
+   {
+      if ( kernel_size == 0 )
+      {
+         throw std::runtime_error("Convolution kernel not set");
+      }
+      const std::size_t available = history_size + chunk_size;
+      return available >= kernel_size ? available - kernel_size + 1 : 0;
+   }
+
+   // Convolve the next chunk; y must have output_size(x.size()) elements
+   inline void push(const ConstArrayView1D<FloatType>& x, ArrayView1D<FloatType> y)
+   {
+      if ( kernel_size == 0 )
+      {
+         throw std::runtime_error("Convolution kernel not set");
+      }
+      if ( !x.contiguous() || !y.contiguous() )
+      {
+         conv1d_contiguous(x, y, [&](auto xc, auto yc) { push(xc, yc); });
+         return;
+      }
+      const std::size_t chunk_size = x.size();
+      if ( y.size() != output_size(chunk_size) )
+      {
+         throw std::runtime_error("Incorrect output size for streaming convolution");
+      }
+
+      // outputs whose window starts in the history: convolve the history
+      // followed by the first (up to) kernel_size - 1 new samples
+      const std::size_t head = std::min(chunk_size, kernel_size - 1);
+      const std::size_t bridge_size = history_size + head;
+      std::size_t done = 0;
+      if ( bridge_size >= kernel_size )
+      {
+         std::copy(history.data_ptr(), history.data_ptr() + history_size, bridge.data_ptr());
+         std::copy(x.data_ptr(), x.data_ptr() + head, bridge.data_ptr() + history_size);
+         done = bridge_size - kernel_size + 1;
+         conv1d_core<FloatType>(bridge.const_view(0, bridge_size), kernel, y.view(0, done));
+      }
+
+      // outputs whose window lies entirely in the new chunk
+      if ( chunk_size >= kernel_size )
+      {
+         conv1d_core<FloatType>(x, kernel, y.view(done, y.size()));
+      }
+
+      // keep the last kernel_size - 1 samples seen
+      const std::size_t capacity = kernel_size - 1;
+      if ( chunk_size >= capacity )
+      {
+         std::copy(x.data_ptr() + chunk_size - capacity, x.data_ptr() + chunk_size, history.data_ptr());
+         history_size = capacity;
+      }
+      else
+      {
+         const std::size_t keep = std::min(history_size, capacity - chunk_size);
+         std::copy(history.data_ptr() + history_size - keep, history.data_ptr() + history_size,
+               history.data_ptr());
+         std::copy(x.data_ptr(), x.data_ptr() + chunk_size, history.data_ptr() + keep);
+         history_size = keep + chunk_size;
+      }
+   }
+
+ private:
+   Array1D<FloatType> kernel;  // Reversed convolution kernel
+   Array1D<FloatType> history; // Last kernel_size - 1 input samples
+   Array1D<FloatType> bridge;  // History plus the head of the new chunk
+   std::size_t kernel_size;    // Size of the kernel
+   std::size_t history_size;   // Number of valid samples in history
+};
+
+#endif // STREAM_HPP
@@ -0,0 +1,342 @@
+#ifndef CONV1D_STRIDED_HPP
+#define CONV1D_STRIDED_HPP
+
+#include "boundary.hpp"
+#include "core.hpp"
+#include "myarray2d.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Number of outputs per task of the strided/dilated convolution; the gathered
+// phases of a block stay in L1/L2
+#ifndef FASTCONV_STRIDED_BLOCK
+#define FASTCONV_STRIDED_BLOCK 4096
+#endif
+
+// Strides up to this value get a deinterleaving loop with a compile-time stride
+#ifndef FASTCONV_MAX_FIXED_STRIDE
+#define FASTCONV_MAX_FIXED_STRIDE 16
+#endif
+
+// Split length * S samples into S phases: dst[p * ld + n] = src[n * S + p].
+// With S known at compile time the loop becomes contiguous loads and shuffles.
+template <typename FloatType, std::size_t S>
+void
+conv1d_deinterleave_fixed(const FloatType* src, FloatType* dst, std::size_t length, std::size_t ld)
+{
+   for ( std::size_t n = 0; n < length; n++ )
+   {
+      for ( std::size_t p = 0; p < S; p++ )
+      {
+         dst[p * ld + n] = src[n * S + p];
+      }
+   }
+}
+
+template <typename FloatType, std::size_t... S>
+constexpr std::array<void (*)(const FloatType*, FloatType*, std::size_t, std::size_t), sizeof...(S) + 1>
+conv1d_make_deinterleave_table(std::index_sequence<S...>)
+{
+   return {nullptr, &conv1d_deinterleave_fixed<FloatType, S + 1>...};
+}
+
+template <typename FloatType>
+void
+conv1d_deinterleave(const FloatType* src, FloatType* dst, std::size_t length, std::size_t ld,
+      std::size_t stride)
+{
+   static constexpr auto table =
+         conv1d_make_deinterleave_table<FloatType>(std::make_index_sequence<FASTCONV_MAX_FIXED_STRIDE>{});
+   if ( stride < table.size() )
+   {
+      table[stride](src, dst, length, ld);
+      return;
+   }
+   for ( std::size_t p = 0; p < stride; p++ )
+   {
+      for ( std::size_t n = 0; n < length; n++ )
+      {
+         dst[p * ld + n] = src[n * stride + p];
+      }
+   }
+}
+
+// Plan for y(m) = sum_j k(j) * x(m * stride + j * dilation), computing only
+// the kept outputs with unit-stride calls to conv1d_core:
+//  - stride > 1: polyphase decomposition. Tap j reads input phase
+//    p = (j * dilation) % stride at lag (j * dilation) / stride, so y is the
+//    sum over p of the phase x_p(n) = x(n * stride + p) convolved with the
+//    sub-kernel h_p of the taps falling into that phase.
+//  - stride == 1, dilation > 1: outputs r, r + dilation, ... only read the
+//    samples r, r + dilation, ..., so each output phase is a plain
+//    convolution of the matching input phase with the dense kernel.
+// Phases are gathered into contiguous scratch buffers block by block.
+template <typename FloatType>
+class Conv1DPolyphase
+{
+ public:
+   inline Conv1DPolyphase()
+         : stride(1), dilation(1), kernel_size(0)
+   {
+   }
+
+   // Build the plan for a (reversed) kernel
+   inline void set(const ConstArrayView1D<FloatType>& k, std::size_t new_stride, std::size_t new_dilation)
+   {
+      if ( new_stride == 0 || new_dilation == 0 )
+      {
+         throw std::invalid_argument("Stride and dilation must be positive");
+      }
+      stride = new_stride;
+      dilation = new_dilation;
+      kernel_size = k.size();
+
+      kernel = std::move(Array1D<FloatType>(kernel_size));
+      for ( std::size_t j = 0; j < kernel_size; j++ )
+      {
+         kernel(j) = k(j);
+      }
+
+      phase_sizes.assign(stride, 0);
+      if ( stride == 1 )
+      {
+         return;
+      }
+      for ( std::size_t j = 0; j < kernel_size; j++ )
+      {
+         const std::size_t p = j * dilation % stride;
+         phase_sizes[p] = std::max(phase_sizes[p], j * dilation / stride + 1);
+      }
+      const std::size_t max_phase_size = *std::max_element(phase_sizes.begin(), phase_sizes.end());
+      phase_kernels = std::move(Array2D<FloatType>(stride, max_phase_size));
+      for ( std::size_t p = 0; p < stride; p++ )
+      {
+         for ( std::size_t q = 0; q < max_phase_size; q++ )
+         {
+            phase_kernels(p, q) = 0;
+         }
+      }
+      for ( std::size_t j = 0; j < kernel_size; j++ )
+      {
+         phase_kernels(j * dilation % stride, j * dilation / stride) = k(j);
+      }
+   }
+
+   // Number of input samples covered by the dilated kernel
+   inline std::size_t span() const
+   {
+      return (kernel_size - 1) * dilation + 1;
+   }
+
+   // Number of kept outputs for an input of input_size samples. With
+   // preserve_shape, output m sits at input position m * stride of the
+   // centered convolution; the outputs whose window leaves the input are
+   // computed from the input extended by `boundary` (not written for none).
+   inline std::size_t output_size(std::size_t input_size, bool preserve_shape = false) const
+   {
+      if ( preserve_shape )
+         return (input_size + stride - 1) / stride;
+      return input_size >= span() ? (input_size - span()) / stride + 1 : 0;
+   }
+
+   inline void conv_into(const ConstArrayView1D<FloatType>& x, ArrayView1D<FloatType> y,
+         bool preserve_shape, ThreadPool* pool = nullptr,
+         std::size_t threshold = FASTCONV_PARALLEL_THRESHOLD,
+         Conv1DBoundary boundary = Conv1DBoundary::none, FloatType value = 0) const
+   {
+      if ( !x.contiguous() || !y.contiguous() )
+      {
+         conv1d_contiguous(x, y, [&](auto xc, auto yc) {
+            conv_into(xc, yc, preserve_shape, pool, threshold, boundary, value);
+         });
+         return;
+      }
+      const std::size_t input_size = x.size();
+      if ( y.size() != output_size(input_size, preserve_shape) )
+      {
+         throw std::runtime_error("Incorrect output size for 1D convolution");
+      }
+      if ( !preserve_shape )
+      {
+         conv_valid(x, y, pool, threshold);
+         return;
+      }
+
+      // first kept output whose window lies inside the input
+      const std::size_t offset = (span() - 1) / 2;
+      const std::size_t m0 = (offset + stride - 1) / stride;
+      const std::size_t i0 = m0 * stride - offset;
+      const std::size_t count = output_size(input_size > i0 ? input_size - i0 : 0);
+      if ( count > 0 )
+      {
+         conv_valid(x.view(i0, input_size), y.view(m0, m0 + count), pool, threshold);
+      }
+
+      const std::size_t left_end = std::min(m0, y.size());
+      conv_edges(x, y, 0, left_end, offset, boundary, value);
+      conv_edges(x, y, std::max(m0 + count, left_end), y.size(), offset, boundary, value);
+   }
+
+ private:
+   // Compute y(m) for m < y.size()
+   inline void conv_valid(const ConstArrayView1D<FloatType>& x, ArrayView1D<FloatType> y, ThreadPool* pool,
+         std::size_t threshold) const
+   {
+      const std::size_t output_size = y.size();
+      if ( output_size == 0 )
+      {
+         return;
+      }
+
+      if ( stride == 1 && dilation == 1 )
+      {
+         conv1d_core_parallel<FloatType>(x.view(0, output_size + kernel_size - 1), kernel, y, pool,
+               threshold);
+         return;
+      }
+
+      // for stride == 1 tasks are (output phase, block) pairs, otherwise blocks
+      const std::size_t num_phases = stride == 1 ? dilation : 1;
+      const std::size_t phase_outputs = (output_size + num_phases - 1) / num_phases;
+      const std::size_t blocks_per_phase
+            = (phase_outputs + FASTCONV_STRIDED_BLOCK - 1) / FASTCONV_STRIDED_BLOCK;
+      const std::size_t num_tasks = num_phases * blocks_per_phase;
+
+      auto run_task = [&](std::size_t t) {
+         const std::size_t block_start = (t % blocks_per_phase) * FASTCONV_STRIDED_BLOCK;
+         if ( stride == 1 )
+            dilated_block(x, y, t / blocks_per_phase, block_start);
+         else
+            polyphase_block(x, y, block_start);
+      };
+
+      if ( pool && pool->size() > 1 && output_size * kernel_size >= threshold && num_tasks > 1 )
+      {
+         pool->parallel_for(num_tasks, run_task);
+      }
+      else
+      {
+         for ( std::size_t t = 0; t < num_tasks; t++ )
+         {
+            run_task(t);
+         }
+      }
+   }
+
+   // Edge outputs [m0, m1) of a preserve_shape convolution, tap by tap: there
+   // are only about span / stride of them at each end
+   inline void conv_edges(const ConstArrayView1D<FloatType>& x, ArrayView1D<FloatType> y, std::size_t m0,
+         std::size_t m1, std::size_t offset, Conv1DBoundary boundary, FloatType value) const
+   {
+      if ( boundary == Conv1DBoundary::none || x.size() == 0 )
+         return;
+      for ( std::size_t m = m0; m < m1; m++ )
+      {
+         const std::ptrdiff_t first
+               = static_cast<std::ptrdiff_t>(m * stride) - static_cast<std::ptrdiff_t>(offset);
+         FloatType sum = 0;
+         for ( std::size_t j = 0; j < kernel_size; j++ )
+         {
+            sum += kernel(j)
+                  * conv1d_extended(x, first + static_cast<std::ptrdiff_t>(j * dilation), boundary, value);
+         }
+         y(m) = sum;
+      }
+   }
+
+   // Outputs [m0, m0 + block) of a stride > 1 convolution
+   inline void polyphase_block(const ConstArrayView1D<FloatType>& x, ArrayView1D<FloatType> y,
+         std::size_t m0) const
+   {
+      const std::size_t m1 = std::min<std::size_t>(m0 + FASTCONV_STRIDED_BLOCK, y.size());
+      const std::size_t count = m1 - m0;
+
+      // deinterleave the rows of stride samples that lie inside x at once,
+      // the few missing samples of shorter phases are fetched one by one
+      const std::size_t rows = count + phase_kernels.cols() - 1;
+      const std::size_t full_rows = std::min(rows, (x.size() - m0 * stride) / stride);
+      // phase rows 64 bytes apart from a power of two, so that the stores
+      // of the deinterleaving loop do not alias in the cache
+      const std::size_t ld = (rows + 15) / 16 * 16 + 16;
+      const FloatType* src = x.data_ptr() + m0 * stride;
+
+      thread_local std::vector<FloatType> phase, partial;
+      phase.resize(stride * ld);
+      partial.resize(count);
+      conv1d_deinterleave(src, phase.data(), full_rows, ld, stride);
+
+      bool first = true;
+      for ( std::size_t p = 0; p < stride; p++ )
+      {
+         const std::size_t size = phase_sizes[p];
+         if ( size == 0 )
+            continue;
+
+         const std::size_t length = count + size - 1;
+         for ( std::size_t n = full_rows; n < length; n++ )
+         {
+            phase[p * ld + n] = src[n * stride + p];
+         }
+
+         const ConstArrayView1D<FloatType> xp(phase.data() + p * ld, length);
+         const ConstArrayView1D<FloatType> hp = phase_kernels.row(p).view(0, size);
+         if ( first )
+         {
+            conv1d_core<FloatType>(xp, hp, y.view(m0, m1));
+            first = false;
+            continue;
+         }
+         conv1d_core<FloatType>(xp, hp, ArrayView1D<FloatType>(partial.data(), count));
+         FloatType* out = y.data_ptr() + m0;
+         for ( std::size_t m = 0; m < count; m++ )
+         {
+            out[m] += partial[m];
+         }
+      }
+   }
+
+   // Outputs r + dilation * [i0, i0 + block) of a stride == 1 convolution
+   inline void dilated_block(const ConstArrayView1D<FloatType>& x, ArrayView1D<FloatType> y, std::size_t r,
+         std::size_t i0) const
+   {
+      const std::size_t phase_outputs = r < y.size() ? (y.size() - r + dilation - 1) / dilation : 0;
+      if ( i0 >= phase_outputs )
+         return;
+      const std::size_t i1 = std::min<std::size_t>(i0 + FASTCONV_STRIDED_BLOCK, phase_outputs);
+      const std::size_t count = i1 - i0;
+      const std::size_t length = count + kernel_size - 1;
+
+      thread_local std::vector<FloatType> phase, partial;
+      phase.resize(length);
+      partial.resize(count);
+
+      const FloatType* src = x.data_ptr() + r + i0 * dilation;
+      for ( std::size_t n = 0; n < length; n++ )
+      {
+         phase[n] = src[n * dilation];
+      }
+      conv1d_core<FloatType>(ConstArrayView1D<FloatType>(phase.data(), length), kernel,
+            ArrayView1D<FloatType>(partial.data(), count));
+
+      FloatType* out = y.data_ptr() + r + i0 * dilation;
+      for ( std::size_t i = 0; i < count; i++ )
+      {
+         out[i * dilation] = partial[i];
+      }
+   }
+
+   Array1D<FloatType> kernel;             // Reversed kernel
+   Array2D<FloatType> phase_kernels;      // Sub-kernel of each input phase (stride > 1)
+   std::vector<std::size_t> phase_sizes;  // Length of each sub-kernel, 0 if the phase has no taps
+   std::size_t stride;                    // Distance between kept outputs
+   std::size_t dilation;                  // Distance between kernel taps
+   std::size_t kernel_size;               // Size of the kernel
+};
+
+#endif // CONV1D_STRIDED_HPP
@@ -0,0 +1,266 @@
+#ifndef CONV1D_TILED_HPP
+#define CONV1D_TILED_HPP
+
+#include "boundary.hpp"
+#include "conv1.hpp"
+#include "core.hpp"
+#include "dispatch.hpp"
+#include "epilogue.hpp"
+#include "parallel.hpp"
+#include "perf.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+#include <unistd.h>
+
+// Data cache sizes in bytes, detected once per process (32 KiB / 1 MiB where
+// the system does not report them)
+struct Conv1DCacheSizes
+{
+   std::size_t l1d;
+   std::size_t l2;
+};
+
+inline const Conv1DCacheSizes&
+conv1d_cache_sizes()
+{
+   static const Conv1DCacheSizes sizes = []() {
+      Conv1DCacheSizes s{std::size_t(32) << 10, std::size_t(1) << 20};
+#if defined(_SC_LEVEL1_DCACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE)
+      const long l1d = sysconf(_SC_LEVEL1_DCACHE_SIZE), l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+      if ( l1d > 0 )
+         s.l1d = static_cast<std::size_t>(l1d);
+      if ( l2 > 0 )
+         s.l2 = static_cast<std::size_t>(l2);
+#endif
+      return s;
+   }();
+   return sizes;
+}
+
+// Outputs per tile and taps per block of the tiled direct method
+struct Conv1DTiles
+{
+   std::size_t outputs;
+   std::size_t taps;
+};
+
+// Tile sizes from the cache sizes: a tap block and the input it reads for one
+// register block fill half of L1; the partial sums and the input of an output
+// tile fill half of L2. Outputs are a multiple of 128 (one register block).
+template <typename FloatType>
+inline Conv1DTiles
+conv1d_tiles(std::size_t kernel_size)
+{
+   const Conv1DCacheSizes& caches = conv1d_cache_sizes();
+   const std::size_t l1 = caches.l1d / sizeof(FloatType), l2 = caches.l2 / sizeof(FloatType);
+   Conv1DTiles tiles;
+   tiles.taps = std::min(kernel_size, std::max<std::size_t>(l1 / 4, 64));
+   const std::size_t outputs = l2 / 2 > tiles.taps ? (l2 / 2 - tiles.taps) / 2 : 0;
+   tiles.outputs = std::max<std::size_t>(outputs - outputs % 128, 1024);
+   return tiles;
+}
+
+// Direct convolution blocked over outputs and taps: every output tile is
+// swept once per tap block, its partial sums staying in L2 while the tap
+// block stays in L1, and each sweep keeps eight vectors of outputs in
+// registers. The FMAs per output run in the same order as in conv1d_core, so
+// the results are identical. Without a tiled kernel for the instruction set
+// (SSE, scalar, double) conv1d_core is used.
+template <typename FloatType>
+void
+conv1d_tiled(ConstArrayView1D<FloatType> x, ConstArrayView1D<FloatType> k, ArrayView1D<FloatType> y,
+      Conv1DTiles tiles)
+{
+   const std::size_t kernel_size = k.size();
+   const std::size_t output_size = y.size();
+   if ( output_size != x.size() - kernel_size + 1 )
+   {
+      throw std::runtime_error("Incorrect output shape for 1D convolution");
+   }
+
+   const auto kernel = conv1d_tile_kernel<FloatType>();
+   if ( !kernel )
+   {
+      conv1d_core<FloatType>(x, k, y);
+      return;
+   }
+   if ( !x.contiguous() || !y.contiguous() )
+   {
+      conv1d_contiguous(x, y, [&](auto xc, auto yc) { conv1d_tiled<FloatType>(xc, k, yc, tiles); });
+      return;
+   }
+
+   const std::size_t tile = std::max<std::size_t>(tiles.outputs, 1);
+   const std::size_t block = std::max<std::size_t>(tiles.taps, 1);
+   for ( std::size_t o = 0; o < output_size; o += tile )
+   {
+      const std::size_t n = std::min(tile, output_size - o);
+      for ( std::size_t j = 0; j < kernel_size; j += block )
+      {
+         kernel(x.data_ptr() + o + j, k.data_ptr() + j, y.data_ptr() + o, std::min(block, kernel_size - j),
+               n, j > 0);
+      }
+   }
+}
+
+// conv1d_tiled with the output tiles run on the pool, smaller tiles if needed
+// so that every thread gets a few
+template <typename FloatType>
+void
+conv1d_tiled_parallel(ConstArrayView1D<FloatType> x, ConstArrayView1D<FloatType> k,
+      ArrayView1D<FloatType> y, Conv1DTiles tiles, ThreadPool* pool,
+      std::size_t threshold = FASTCONV_PARALLEL_THRESHOLD)
+{
+   const std::size_t output_size = y.size();
+   if ( !pool || pool->size() < 2 || output_size < threshold )
+   {
+      conv1d_tiled<FloatType>(x, k, y, tiles);
+      return;
+   }
+   if ( output_size != x.size() - k.size() + 1 )
+   {
+      throw std::runtime_error("Incorrect output shape for 1D convolution");
+   }
+
+   std::size_t chunk = std::min(tiles.outputs, output_size / (4 * pool->size()));
+   chunk = std::max<std::size_t>(128, chunk - chunk % 128);
+   const std::size_t num_chunks = (output_size + chunk - 1) / chunk;
+
+   pool->parallel_for(num_chunks, [&](std::size_t i) {
+      const std::size_t start = i * chunk;
+      const std::size_t end = std::min(start + chunk, output_size);
+      conv1d_tiled<FloatType>(x.view(start, end + k.size() - 1), k, y.view(start, end), tiles);
+   });
+}
+
+// Class definition for the cache-blocked direct convolution, meant for
+// kernels of about 64 to a few thousand taps on inputs too short for the
+// FFT engine to pay off
+template <typename FloatType>
+class Conv1DTiled : Conv1DBase<FloatType>, public Conv1DParallel
+{
+ public:
+   // Constructor
+   inline Conv1DTiled(bool preserve_shape = false)
+         : preserve_shape(preserve_shape), tile_outputs(0), tile_taps(0), boundary(Conv1DBoundary::zero),
+           boundary_value(0)
+   {
+   }
+   inline Conv1DTiled(const ConstArrayView1D<FloatType>& init_kernel, bool preserve_shape = false)
+         : Conv1DTiled(preserve_shape)
+   {
+      set_kernel(init_kernel);
+   }
+
+   // Set the convolution kernel (reverse it)
+   inline void set_kernel(const ConstArrayView1D<FloatType>& new_kernel)
+   {
+      kernel = std::move(Array1D<FloatType>(new_kernel.size()));
+      for ( std::size_t i = 0; i < kernel.size(); i++ )
+      {
+         kernel(i) = new_kernel(new_kernel.size() - 1 - i);
+      }
+   }
+
+   // Override the tile sizes (0 keeps the size derived from the caches)
+   inline void set_tiles(std::size_t outputs, std::size_t taps)
+   {
+      tile_outputs = outputs;
+      tile_taps = taps;
+   }
+
+   // Tile sizes used for the current kernel
+   inline Conv1DTiles tiles() const
+   {
+      Conv1DTiles t = conv1d_tiles<FloatType>(kernel.size());
+      if ( tile_outputs > 0 )
+         t.outputs = tile_outputs;
+      if ( tile_taps > 0 )
+         t.taps = tile_taps;
+      return t;
+   }
+
+   // How the input is extended for the edge outputs of preserve_shape
+   inline void set_boundary(Conv1DBoundary mode, FloatType value = 0)
+   {
+      boundary = mode;
+      boundary_value = value;
+   }
+
+   // Compute the output size based on input size
+   inline std::size_t output_size(std::size_t input_size) const
+   {
+      return input_size + (preserve_shape ? 0 : 1 - kernel.size());
+   }
+
+   // Perform the 1D convolution
+   inline Array1D<FloatType> conv(const ConstArrayView1D<FloatType>& x) const
+   {
+      Array1D<FloatType> y(output_size(x.size()));
+      conv_into(x, y);
+      return y;
+   }
+
+   // Perform the 1D convolution into a caller-owned buffer
+   inline void conv_into(const ConstArrayView1D<FloatType>& x, ArrayView1D<FloatType> y) const
+   {
+      FASTCONV_PERF_SCOPE("tiled", kernel.size(), y.size());
+      std::size_t input_size = x.size();
+      if ( y.size() != output_size(input_size) )
+      {
+         throw std::runtime_error("Incorrect output size for 1D convolution");
+      }
+
+      std::size_t kernel_size = kernel.size();
+      std::size_t raw_output_size = input_size >= kernel_size ? input_size - kernel_size + 1 : 0;
+      std::size_t offset = preserve_shape ? (kernel_size - 1) / 2 : 0;
+
+      if ( raw_output_size > 0 )
+      {
+         conv1d_tiled_parallel<FloatType>(x, kernel, y.view(offset, raw_output_size + offset), tiles(),
+               pool.get(), parallel_threshold);
+      }
+      if ( preserve_shape )
+      {
+         conv1d_boundary<FloatType>(x, kernel, y, boundary, boundary_value);
+      }
+   }
+
+   // Convolve into y and apply an epilogue and a reduction per block of
+   // outputs, like Conv1DRef::conv_fused_into. The epilogue blocks take the
+   // place of the output tiles, which leaves the sums unchanged, so the results
+   // are identical to conv_into followed by conv1d_epilogue.
+   template <typename Op, typename Reduction = Conv1DNoReduction>
+   inline typename Reduction::value_type conv_fused_into(const ConstArrayView1D<FloatType>& x,
+         ArrayView1D<FloatType> y, Op op, Reduction reduction = {}, bool accumulate = false) const
+   {
+      FASTCONV_PERF_SCOPE("tiled_fused", kernel.size(), y.size());
+      const Conv1DTiles t = tiles();
+      const bool zero_edges = accumulate && preserve_shape && boundary == Conv1DBoundary::none;
+      auto interior = [&](ConstArrayView1D<FloatType> xs, ConstArrayView1D<FloatType> ks,
+                            ArrayView1D<FloatType> ys) {
+         conv1d_tiled<FloatType>(xs, ks, ys, t);
+      };
+      auto produce = [&](std::size_t begin, std::size_t end, ArrayView1D<FloatType> out) {
+         if ( zero_edges )
+            std::fill(out.data_ptr(), out.data_ptr() + (end - begin), FloatType(0));
+         conv1d_output_range<FloatType>(x, kernel, out, begin, preserve_shape, boundary, boundary_value,
+               Conv1DSymmetry::none, interior);
+      };
+      return conv1d_fused<FloatType>(output_size(x.size()), produce, y, op, reduction, accumulate,
+            pool.get(), parallel_threshold);
+   }
+
+ private:
+   Array1D<FloatType> kernel;   // Reversed convolution kernel
+   bool preserve_shape;         // Preserve shape of the input/output
+   std::size_t tile_outputs;    // Outputs per tile, 0 for the cache-derived size
+   std::size_t tile_taps;       // Taps per block, 0 for the cache-derived size
+   Conv1DBoundary boundary;     // Extension of the input for the edge outputs
+   FloatType boundary_value;    // Value of Conv1DBoundary::constant
+};
+
+#endif // CONV1D_TILED_HPP
@@ -0,0 +1,282 @@
+#ifndef CONV2D_SEPARABLE_HPP
+#define CONV2D_SEPARABLE_HPP
+
+#include "batch.hpp"
+#include "boundary.hpp"
+#include "core.hpp"
+#include "myarray2d.hpp"
+#include "parallel.hpp"
+#include "perf.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// Output rows per band: the row-filtered band (plus the kernel halo) stays in
+// L2 while the column pass runs over it. The halo rows are carried over to the
+// next band of the same thread, not filtered again.
+#ifndef FASTCONV_SEPARABLE_BAND
+#define FASTCONV_SEPARABLE_BAND 32
+#endif
+
+// Columns per strip of the vertical pass, so that the strip of y stays in L1
+#ifndef FASTCONV_SEPARABLE_STRIP
+#define FASTCONV_SEPARABLE_STRIP 1024
+#endif
+
+// Vertical 1D convolution for one output row: y(c) = sum_j k(j) * x(j, c).
+// The taps are applied to whole rows of x, so all accesses are contiguous and
+// the inner loop vectorizes across columns.
+template <typename FloatType>
+void
+conv1d_vertical(ConstArrayView2D<FloatType> x, ConstArrayView1D<FloatType> k, ArrayView1D<FloatType> y)
+{
+   const std::size_t kernel_size = k.size();
+   const std::size_t cols = y.size();
+
+   if ( x.rows() != kernel_size || x.cols() != cols )
+   {
+      throw std::runtime_error("Incorrect output shape for vertical 1D convolution");
+   }
+
+   FloatType* out = y.data_ptr();
+   for ( std::size_t c0 = 0; c0 < cols; c0 += FASTCONV_SEPARABLE_STRIP )
+   {
+      const std::size_t c1 = std::min<std::size_t>(c0 + FASTCONV_SEPARABLE_STRIP, cols);
+      for ( std::size_t c = c0; c < c1; c++ )
+      {
+         out[c] = FloatType(0);
+      }
+      for ( std::size_t j = 0; j < kernel_size; j++ )
+      {
+         const FloatType kj = k(j);
+         const FloatType* in = x.row(j).data_ptr();
+         for ( std::size_t c = c0; c < c1; c++ )
+         {
+            out[c] += kj * in[c];
+         }
+      }
+   }
+}
+
+// Class definition for separable 2D convolution: the image is convolved with
+// a row kernel along each row and then with a column kernel along each
+// column. Each thread takes one span of output rows and walks it in bands;
+// each band is row-filtered into a scratch buffer (reusing the batched 1D
+// core) and the column pass runs on it while it is still in cache. With
+// preserve_shape, the edges are computed as if the image were extended by the
+// boundary mode in both directions (zero by default, as in Conv1DRef).
+template <typename FloatType>
+class Conv2DSeparable : public Conv1DParallel
+{
+ public:
+   // Constructor
+   inline Conv2DSeparable(bool preserve_shape = false, std::size_t band_rows = FASTCONV_SEPARABLE_BAND)
+         : preserve_shape(preserve_shape), band_rows(std::max<std::size_t>(band_rows, 1)),
+           boundary(Conv1DBoundary::zero), boundary_value(0)
+   {
+   }
+   inline Conv2DSeparable(const ConstArrayView1D<FloatType>& init_row_kernel,
+         const ConstArrayView1D<FloatType>& init_col_kernel, bool preserve_shape = false,
+         std::size_t band_rows = FASTCONV_SEPARABLE_BAND)
+         : Conv2DSeparable(preserve_shape, band_rows)
+   {
+      set_kernels(init_row_kernel, init_col_kernel);
+   }
+
+   // Set the row and column kernels (reverse them)
+   inline void set_kernels(const ConstArrayView1D<FloatType>& new_row_kernel,
+         const ConstArrayView1D<FloatType>& new_col_kernel)
+   {
+      if ( new_row_kernel.size() == 0 || new_col_kernel.size() == 0 )
+      {
+         throw std::invalid_argument("Empty convolution kernel");
+      }
+      row_kernel = std::move(Array1D<FloatType>(new_row_kernel.size()));
+      for ( std::size_t i = 0; i < row_kernel.size(); i++ )
+      {
+         row_kernel(i) = new_row_kernel(new_row_kernel.size() - 1 - i);
+      }
+      col_kernel = std::move(Array1D<FloatType>(new_col_kernel.size()));
+      for ( std::size_t i = 0; i < col_kernel.size(); i++ )
+      {
+         col_kernel(i) = new_col_kernel(new_col_kernel.size() - 1 - i);
+      }
+   }
+
+   // Set how the image is extended for the edges of preserve_shape (the same
+   // mode along rows and columns); Conv1DBoundary::none leaves them unwritten
+   inline void set_boundary(Conv1DBoundary mode, FloatType value = 0)
+   {
+      boundary = mode;
+      boundary_value = value;
+   }
+
+   // Compute the output shape based on the input shape
+   inline std::size_t output_rows(std::size_t input_rows) const
+   {
+      return input_rows + (preserve_shape ? 0 : 1 - col_kernel.size());
+   }
+
+   inline std::size_t output_cols(std::size_t input_cols) const
+   {
+      return input_cols + (preserve_shape ? 0 : 1 - row_kernel.size());
+   }
+
+   // Perform the 2D convolution
+   inline Array2D<FloatType> conv(const ConstArrayView2D<FloatType>& x) const
+   {
+      Array2D<FloatType> y(output_rows(x.rows()), output_cols(x.cols()));
+      conv_into(x, y);
+      return y;
+   }
+
+   // Perform the 2D convolution into a caller-owned buffer
+   inline void conv_into(const ConstArrayView2D<FloatType>& x, ArrayView2D<FloatType> y) const
+   {
+      FASTCONV_PERF_SCOPE("sep2d", row_kernel.size() + col_kernel.size(), y.rows() * y.cols());
+      if ( y.rows() != output_rows(x.rows()) || y.cols() != output_cols(x.cols()) )
+      {
+         throw std::runtime_error("Incorrect output shape for 2D convolution");
+      }
+      const bool edges = preserve_shape && boundary != Conv1DBoundary::none;
+      if ( !edges && (x.rows() < col_kernel.size() || x.cols() < row_kernel.size()) )
+      {
+         return;
+      }
+
+      const std::size_t kernel_rows = col_kernel.size();
+      const std::size_t raw_rows = x.rows() >= kernel_rows ? x.rows() - kernel_rows + 1 : 0;
+      const std::size_t raw_cols = x.cols() >= row_kernel.size() ? x.cols() - row_kernel.size() + 1 : 0;
+      const std::size_t row_offset = preserve_shape ? (kernel_rows - 1) / 2 : 0;
+      const std::size_t col_offset = preserve_shape ? (row_kernel.size() - 1) / 2 : 0;
+      // filtered rows hold the edge columns too if they are computed
+      const std::size_t first_col = edges ? 0 : col_offset;
+      const std::size_t width = edges ? y.cols() : raw_cols;
+      const auto out = y.view(row_offset, row_offset + raw_rows, first_col, first_col + width);
+
+      // row pass of the input rows [p0, p1) into f
+      auto filter_rows = [&](std::size_t p0, std::size_t p1, ArrayView2D<FloatType> f) {
+         if ( raw_cols > 0 )
+         {
+            conv1d_core_batch<FloatType>(x.view(p0, p1, 0, x.cols()), row_kernel,
+                  f.view(0, p1 - p0, col_offset - first_col, col_offset - first_col + raw_cols));
+         }
+         if ( edges )
+         {
+            for ( std::size_t p = p0; p < p1; p++ )
+               conv1d_boundary<FloatType>(x.row(p), row_kernel, f.row(p - p0), boundary, boundary_value);
+         }
+      };
+
+      // One span of output rows in bands; the last kernel_rows - 1 filtered
+      // rows of a band are the first ones of the next
+      const std::size_t halo = kernel_rows - 1;
+      auto run_span = [&](std::size_t r_begin, std::size_t r_end) {
+         thread_local std::vector<FloatType> scratch;
+         scratch.resize((std::min(band_rows, r_end - r_begin) + halo) * width);
+         std::size_t carried = 0;
+         for ( std::size_t r0 = r_begin; r0 < r_end; r0 += band_rows )
+         {
+            const std::size_t r1 = std::min(r0 + band_rows, r_end);
+            const std::size_t in_rows = r1 - r0 + halo;
+            ArrayView2D<FloatType> band(scratch.data(), in_rows, width, width);
+            filter_rows(r0 + carried, r0 + in_rows, band.view(carried, in_rows, 0, width));
+
+            // column pass, one output row at a time
+            const ConstArrayView2D<FloatType> filtered(band);
+            for ( std::size_t r = r0; r < r1; r++ )
+            {
+               conv1d_vertical<FloatType>(filtered.view(r - r0, r - r0 + kernel_rows, 0, width), col_kernel,
+                     out.row(r));
+            }
+
+            std::copy(scratch.begin() + (r1 - r0) * width, scratch.begin() + in_rows * width,
+                  scratch.begin());
+            carried = halo;
+         }
+      };
+
+      // one span per thread, so each thread filters the halo rows only once
+      const std::size_t max_spans = (raw_rows + band_rows - 1) / band_rows;
+      const bool threaded
+            = pool && pool->size() > 1 && raw_rows * width >= parallel_threshold && max_spans > 1;
+      const std::size_t num_spans = threaded ? std::min(pool->size(), max_spans) : 1;
+      const std::size_t span_rows = (raw_rows + num_spans - 1) / num_spans;
+      if ( threaded )
+      {
+         pool->parallel_for(num_spans, [&](std::size_t s) {
+            run_span(s * span_rows, std::min((s + 1) * span_rows, raw_rows));
+         });
+      }
+      else if ( raw_rows > 0 )
+      {
+         run_span(0, raw_rows);
+      }
+
+      if ( edges )
+      {
+         const std::size_t top_end = std::min(row_offset, y.rows());
+         edge_rows(x, y, 0, top_end);
+         edge_rows(x, y, std::max(row_offset + raw_rows, top_end), y.rows());
+      }
+   }
+
+ private:
+   // Row pass with the edge columns of a single row, y has x.size() elements
+   inline void filter_row(const ConstArrayView1D<FloatType>& x, ArrayView1D<FloatType> y) const
+   {
+      const std::size_t kernel_size = row_kernel.size();
+      if ( x.size() >= kernel_size )
+      {
+         const std::size_t offset = (kernel_size - 1) / 2;
+         conv1d_core<FloatType>(x, row_kernel, y.view(offset, offset + x.size() - kernel_size + 1));
+      }
+      conv1d_boundary<FloatType>(x, row_kernel, y, boundary, boundary_value);
+   }
+
+   // Output rows [i0, i1) of preserve_shape whose column window leaves the
+   // image: the rows of the extended image (rows of the extension value for
+   // zero and constant) are row-filtered into a buffer for the column pass
+   inline void edge_rows(const ConstArrayView2D<FloatType>& x, ArrayView2D<FloatType> y, std::size_t i0,
+         std::size_t i1) const
+   {
+      if ( i0 >= i1 )
+         return;
+      const std::size_t kernel_rows = col_kernel.size();
+      const std::size_t cols = y.cols();
+      const std::size_t num_rows = i1 - i0 + kernel_rows - 1;
+      const std::ptrdiff_t first
+            = static_cast<std::ptrdiff_t>(i0) - static_cast<std::ptrdiff_t>((kernel_rows - 1) / 2);
+
+      std::vector<FloatType> buffer(num_rows * cols);
+      std::vector<FloatType> fill(cols,
+            boundary == Conv1DBoundary::constant ? boundary_value : FloatType(0));
+      ArrayView2D<FloatType> extended(buffer.data(), num_rows, cols, cols);
+      for ( std::size_t t = 0; t < num_rows; t++ )
+      {
+         const std::ptrdiff_t q = conv1d_extended_index(
+               static_cast<std::ptrdiff_t>(x.rows()), first + static_cast<std::ptrdiff_t>(t), boundary);
+         filter_row(q >= 0 ? x.row(static_cast<std::size_t>(q))
+                           : ConstArrayView1D<FloatType>(fill.data(), cols),
+               extended.row(t));
+      }
+
+      const ConstArrayView2D<FloatType> filtered(extended);
+      for ( std::size_t i = i0; i < i1; i++ )
+      {
+         conv1d_vertical<FloatType>(filtered.view(i - i0, i - i0 + kernel_rows, 0, cols), col_kernel,
+               y.row(i));
+      }
+   }
+
+   Array1D<FloatType> row_kernel; // Reversed kernel applied along the rows
+   Array1D<FloatType> col_kernel; // Reversed kernel applied along the columns
+   bool preserve_shape;           // Preserve shape of the input/output
+   std::size_t band_rows;         // Output rows per band
+   Conv1DBoundary boundary;       // Extension of the image for the edges
+   FloatType boundary_value;      // Value of Conv1DBoundary::constant
+};
+
+#endif // CONV2D_SEPARABLE_HPP
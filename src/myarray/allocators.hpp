@@ -0,0 +1,220 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// Alignment of array storage, enough for a full AVX-512 register / cache line
+#ifndef FASTCONV_ARRAY_ALIGNMENT
+#define FASTCONV_ARRAY_ALIGNMENT 64
+#endif
+
+// Largest power of two (up to FASTCONV_ARRAY_ALIGNMENT) dividing the address
+inline std::size_t
+pointer_alignment(const void* ptr) noexcept
+{
+   const auto addr = reinterpret_cast<std::uintptr_t>(ptr);
+   std::size_t alignment = FASTCONV_ARRAY_ALIGNMENT;
+   while ( alignment > 1 && addr % alignment != 0 )
+      alignment /= 2;
+   return alignment;
+}
+
+// Allocator policies for Array1D. A policy provides static
+// allocate(bytes)/deallocate(ptr, bytes); allocate(0) returns nullptr.
+
+// Plain aligned heap memory
+struct AlignedAllocator
+{
+   static inline void* allocate(std::size_t bytes)
+   {
+      if ( bytes == 0 )
+         return nullptr;
+      return ::operator new(bytes, std::align_val_t(FASTCONV_ARRAY_ALIGNMENT));
+   }
+
+   static inline void deallocate(void* ptr, std::size_t) noexcept
+   {
+      if ( ptr )
+         ::operator delete(ptr, std::align_val_t(FASTCONV_ARRAY_ALIGNMENT));
+   }
+};
+
+// Number of released buffers of one size kept by each thread
+#ifndef FASTCONV_POOL_DEPTH
+#define FASTCONV_POOL_DEPTH 4
+#endif
+
+// Total bytes of released buffers kept by each thread
+#ifndef FASTCONV_POOL_MAX_BYTES
+#define FASTCONV_POOL_MAX_BYTES (std::size_t(64) << 20)
+#endif
+
+// Aligned memory recycled through a thread-local free list per buffer size,
+// so that arrays of the same size allocated in a loop reuse warm pages.
+// Arrays released after the thread's lists are destroyed (e.g. static arrays
+// at exit) go straight back to the heap.
+struct PoolAllocator
+{
+   static inline void* allocate(std::size_t bytes)
+   {
+      if ( bytes == 0 )
+         return nullptr;
+      if ( state() == State::destroyed )
+         return AlignedAllocator::allocate(bytes);
+      FreeLists& lists = free_lists();
+      auto& list = lists.lists[bytes];
+      if ( !list.empty() )
+      {
+         void* ptr = list.back();
+         list.pop_back();
+         lists.cached_bytes -= bytes;
+         return ptr;
+      }
+      return AlignedAllocator::allocate(bytes);
+   }
+
+   static inline void deallocate(void* ptr, std::size_t bytes) noexcept
+   {
+      if ( !ptr )
+         return;
+      if ( state() == State::destroyed )
+      {
+         AlignedAllocator::deallocate(ptr, bytes);
+         return;
+      }
+      FreeLists& lists = free_lists();
+      auto& list = lists.lists[bytes];
+      if ( list.size() < FASTCONV_POOL_DEPTH && lists.cached_bytes + bytes <= FASTCONV_POOL_MAX_BYTES )
+      {
+         list.push_back(ptr);
+         lists.cached_bytes += bytes;
+      }
+      else
+      {
+         AlignedAllocator::deallocate(ptr, bytes);
+      }
+   }
+
+   // Free all buffers cached by the calling thread
+   static inline void release()
+   {
+      if ( state() != State::destroyed )
+         free_lists().clear();
+   }
+
+ private:
+   enum class State
+   {
+      unused,
+      alive,
+      destroyed
+   };
+
+   // Trivially destructible, so it can still be read after ~FreeLists
+   static inline State& state() noexcept
+   {
+      thread_local State value = State::unused;
+      return value;
+   }
+
+   struct FreeLists
+   {
+      std::unordered_map<std::size_t, std::vector<void*>> lists;
+      std::size_t cached_bytes = 0;
+
+      inline FreeLists()
+      {
+         state() = State::alive;
+      }
+
+      inline void clear()
+      {
+         for ( auto& [bytes, list] : lists )
+         {
+            for ( void* ptr : list )
+               AlignedAllocator::deallocate(ptr, bytes);
+            list.clear();
+         }
+         cached_bytes = 0;
+      }
+
+      inline ~FreeLists()
+      {
+         clear();
+         state() = State::destroyed;
+      }
+   };
+
+   static inline FreeLists& free_lists()
+   {
+      thread_local FreeLists lists;
+      return lists;
+   }
+};
+
+// Arrays at least this large are backed by huge pages
+#ifndef FASTCONV_HUGEPAGE_THRESHOLD
+#define FASTCONV_HUGEPAGE_THRESHOLD (std::size_t(2) << 20)
+#endif
+
+// Large arrays are mapped directly and marked for transparent huge pages,
+// which cuts TLB misses on multi-megabyte buffers. Small arrays, and all
+// arrays on systems without mmap, fall back to AlignedAllocator.
+struct HugePageAllocator
+{
+   static inline void* allocate(std::size_t bytes)
+   {
+#ifdef __linux__
+      if ( bytes >= FASTCONV_HUGEPAGE_THRESHOLD )
+      {
+         // over-map by one huge page and trim both ends, so that the mapping
+         // starts on a 2 MB boundary and every 2 MB of it can be a huge page
+         const std::size_t size = mapped_size(bytes);
+         void* raw = mmap(nullptr, size + huge_page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+               -1, 0);
+         if ( raw == MAP_FAILED )
+            throw std::bad_alloc();
+         const auto base = reinterpret_cast<std::uintptr_t>(raw);
+         const std::uintptr_t aligned = (base + huge_page - 1) / huge_page * huge_page;
+         if ( aligned > base )
+            munmap(raw, aligned - base);
+         if ( aligned - base < huge_page )
+            munmap(reinterpret_cast<void*>(aligned + size), huge_page - (aligned - base));
+         void* ptr = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+         madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+         return ptr;
+      }
+#endif
+      return AlignedAllocator::allocate(bytes);
+   }
+
+   static inline void deallocate(void* ptr, std::size_t bytes) noexcept
+   {
+#ifdef __linux__
+      if ( ptr && bytes >= FASTCONV_HUGEPAGE_THRESHOLD )
+      {
+         munmap(ptr, mapped_size(bytes));
+         return;
+      }
+#endif
+      AlignedAllocator::deallocate(ptr, bytes);
+   }
+
+ private:
+   static constexpr std::size_t huge_page = std::size_t(2) << 20;
+
+   // mappings are 2 MB aligned and rounded up to whole 2 MB pages
+   static inline std::size_t mapped_size(std::size_t bytes)
+   {
+      return (bytes + huge_page - 1) / huge_page * huge_page;
+   }
+};
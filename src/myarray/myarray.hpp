@@ -1,20 +1,41 @@
 #pragma once
 
+#include "allocators.hpp"
+
 #include <cassert>
 #include <exception>
 #include <iostream>
+#include <memory>
 
+template <typename Numeric, typename Allocator = AlignedAllocator>
+class Array1D;
 template <typename Numeric>
 class ArrayView1D;
 template <typename Numeric>
 class ConstArrayView1D;
 
-template <typename Numeric>
+// Storage comes from the Allocator policy (see allocators.hpp): 64-byte
+// aligned heap memory by default, PoolAllocator to recycle buffers of the
+// same size within a thread, HugePageAllocator for large arrays.
+template <typename Numeric, typename Allocator>
 class Array1D
 {
    Numeric* data;
    std::size_t data_size;
 
+   static inline Numeric* allocate(std::size_t size)
+   {
+      Numeric* ptr = static_cast<Numeric*>(Allocator::allocate(size * sizeof(Numeric)));
+      std::uninitialized_default_construct_n(ptr, size);
+      return ptr;
+   }
+
+   static inline void deallocate(Numeric* ptr, std::size_t size) noexcept
+   {
+      std::destroy_n(ptr, size);
+      Allocator::deallocate(ptr, size * sizeof(Numeric));
+   }
+
  public:
    inline Array1D()
          : data(nullptr), data_size(0)
@@ -24,36 +45,37 @@ class Array1D
    inline Array1D(std::size_t size)
          : data_size(size)
    {
-      data = new Numeric[data_size];
+      data = allocate(data_size);
    }
 
-   inline Array1D(const Array1D<Numeric>& other)
+   inline Array1D(const Array1D& other)
          : data_size(other.data_size)
    {
-      data = new Numeric[data_size];
+      data = allocate(data_size);
       for ( std::size_t i = 0; i < data_size; i++ )
       {
          data[i] = other.data[i];
       }
    }
 
-   inline Array1D(Array1D<Numeric>&& other)
+   inline Array1D(Array1D&& other)
          : data(other.data), data_size(other.data_size)
    {
       other.data = nullptr;
+      other.data_size = 0;
 #ifndef NDEBUG
       std::cout << "Move constructor called with size " << data_size << std::endl;
 #endif
    }
 
    inline Array1D(const ConstArrayView1D<Numeric>& view)
-         : data_size(view.length)
+         : data_size(view.size())
    {
       std::cout << "Array1D" << " c-tor from ConstArrayView" << std::endl;
-      data = new Numeric[data_size];
+      data = allocate(data_size);
       for ( std::size_t i = 0; i < data_size; i++ )
       {
-         data[i] = view.data[view.offset + i];
+         data[i] = view(i);
       }
    }
 
@@ -63,7 +85,7 @@ class Array1D
       std::cout << "Destructor called with size " << data_size << std::endl;
 #endif
       if ( data )
-         delete[] data;
+         deallocate(data, data_size);
    }
 
    inline std::size_t size() const
@@ -101,20 +123,20 @@ class Array1D
       return data[idx];
    }
 
-   inline Array1D<Numeric>& operator=(const Array1D<Numeric>& other)
+   inline Array1D& operator=(const Array1D& other)
    {
 #ifndef NDEBUG
       std::cout << "copy assignment " << describe() << " -> " << other.describe() << std::endl;
 #endif
       if ( data )
       {
-         delete[] data;
+         deallocate(data, data_size);
          data = nullptr;
       }
-      if ( !other.data )
-         return *this;
+      // an empty other has no storage (allocate(0) is nullptr) but still
+      // sets the size
       data_size = other.data_size;
-      data = new Numeric[data_size];
+      data = allocate(data_size);
       for ( std::size_t i = 0; i < data_size; i++ )
       {
          data[i] = other.data[i];
@@ -122,24 +144,40 @@ class Array1D
       return *this;
    }
 
-   inline Array1D<Numeric>& operator=(Array1D<Numeric>&& other)
+   inline Array1D& operator=(Array1D&& other)
    {
 #ifndef NDEBUG
       std::cout << "move assignment " << describe() << " -> " << other.describe() << std::endl;
 #endif
       if ( data )
       {
-         delete[] data;
+         deallocate(data, data_size);
          data = nullptr;
       }
-      if ( !other.data )
-         return *this;
       data_size = other.data_size;
       data = other.data;
       other.data = nullptr;
+      other.data_size = 0;
       return *this;
    }
 
+   // Raw pointer to the first element, for vectorized kernels
+   inline Numeric* data_ptr() noexcept
+   {
+      return data;
+   }
+
+   inline const Numeric* data_ptr() const noexcept
+   {
+      return data;
+   }
+
+   // Alignment of the storage in bytes (power of two, at most FASTCONV_ARRAY_ALIGNMENT)
+   inline std::size_t alignment() const noexcept
+   {
+      return pointer_alignment(data);
+   }
+
    std::string describe() const
    {
       if ( !data )
@@ -155,48 +193,60 @@ class Array1D
    {
       return {*this, start, end - start};
    }
-
-   friend class ArrayView1D<Numeric>;
-   friend class ConstArrayView1D<Numeric>;
 };
 
 template <typename Numeric>
 class ArrayView1D
 {
    Numeric* data;
-   std::size_t offset, length;
+   std::size_t offset, length, step;
 
  public:
    // Array c-tors
 
-   ArrayView1D(Array1D<Numeric>& array)
-         : data(array.data), offset(0), length(array.data_size)
+   template <typename Allocator>
+   ArrayView1D(Array1D<Numeric, Allocator>& array)
+         : data(array.data_ptr()), offset(0), length(array.size()), step(1)
    {
 #ifndef NDEBUG
       std::cout << "ArrayView1D" << " c-tor from array" << std::endl;
 #endif
    }
-   ArrayView1D(Array1D<Numeric>& array, std::size_t offset, std::size_t length)
-         : data(array.data), offset(offset), length(length)
+   template <typename Allocator>
+   ArrayView1D(Array1D<Numeric, Allocator>& array, std::size_t offset, std::size_t length)
+         : data(array.data_ptr()), offset(offset), length(length), step(1)
    {
 #ifndef NDEBUG
       std::cout << "ArrayView1D" << " c-tor from array (offset, length)" << std::endl;
 #endif
       assert(offset >= 0);
-      assert(offset + length <= array.data_size);
+      assert(offset + length <= array.size());
+   }
+
+   // Raw memory c-tors (e.g. one row of a 2D array, or with a stride one
+   // column of it or one channel of interleaved samples)
+
+   ArrayView1D(Numeric* data, std::size_t length)
+         : data(data), offset(0), length(length), step(1)
+   {
+   }
+   ArrayView1D(Numeric* data, std::size_t length, std::size_t stride)
+         : data(data), offset(0), length(length), step(stride)
+   {
+      assert(stride > 0);
    }
 
    // ArrayView c-tors
 
    ArrayView1D(const ArrayView1D<Numeric>& view)
-         : data(view.data), offset(view.offset), length(view.length)
+         : data(view.data), offset(view.offset), length(view.length), step(view.step)
    {
 #ifndef NDEBUG
       std::cout << "ArrayView1D" << " c-tor from view" << std::endl;
 #endif
    }
    ArrayView1D(const ArrayView1D<Numeric>& view, std::size_t offset, std::size_t length)
-         : data(view.data), offset(view.offset + offset), length(length)
+         : data(view.data), offset(view.offset + offset * view.step), length(length), step(view.step)
    {
 #ifndef NDEBUG
       std::cout << "ArrayView1D" << " c-tor from view (offset, length)" << std::endl;
@@ -205,6 +255,9 @@ class ArrayView1D
       assert(offset + length <= view.length);
    }
 
+   // Rebinds the view (the elements are not copied)
+   inline ArrayView1D& operator=(const ArrayView1D&) = default;
+
    inline ~ArrayView1D() = default;
 
    inline std::size_t size() const
@@ -224,7 +277,7 @@ class ArrayView1D
       }
 #endif
       // std::cout << "ArrayView: Access operator at index " << idx << std::endl;
-      return data[idx + offset];
+      return data[offset + idx * step];
    }
 
    inline const Numeric& operator()(std::size_t idx) const
@@ -240,7 +293,31 @@ class ArrayView1D
 #endif
       // std::cout << "ArrayView: Const access operator at index " << idx <<
       // std::endl;
-      return data[idx + offset];
+      return data[offset + idx * step];
+   }
+
+   // Raw pointer to the first element of the view; the elements are stride()
+   // apart, the raw-pointer kernels require contiguous() views
+   inline Numeric* data_ptr() const noexcept
+   {
+      return data + offset;
+   }
+
+   // Distance between consecutive elements, 1 for contiguous views
+   inline std::size_t stride() const noexcept
+   {
+      return step;
+   }
+
+   inline bool contiguous() const noexcept
+   {
+      return step == 1;
+   }
+
+   // Alignment of the first element in bytes, for picking aligned fast paths
+   inline std::size_t alignment() const noexcept
+   {
+      return pointer_alignment(data_ptr());
    }
 
    inline ArrayView1D<Numeric> view(std::size_t start, std::size_t end) const
@@ -255,32 +332,47 @@ template <typename Numeric>
 class ConstArrayView1D
 {
    const Numeric* data;
-   std::size_t offset, length;
+   std::size_t offset, length, step;
 
  public:
    // Array c-tors
 
-   ConstArrayView1D(const Array1D<Numeric>& array)
-         : data(array.data), offset(0), length(array.data_size)
+   template <typename Allocator>
+   ConstArrayView1D(const Array1D<Numeric, Allocator>& array)
+         : data(array.data_ptr()), offset(0), length(array.size()), step(1)
    {
 #ifndef NDEBUG
       std::cout << "ConstArrayView1D" << " c-tor from Array" << std::endl;
 #endif
    }
-   ConstArrayView1D(const Array1D<Numeric>& array, std::size_t offset, std::size_t length)
-         : data(array.data), offset(offset), length(length)
+   template <typename Allocator>
+   ConstArrayView1D(const Array1D<Numeric, Allocator>& array, std::size_t offset, std::size_t length)
+         : data(array.data_ptr()), offset(offset), length(length), step(1)
    {
 #ifndef NDEBUG
       std::cout << "ConstArrayView1D" << " c-tor from Array (offset, length)" << std::endl;
 #endif
       assert(offset >= 0);
-      assert(offset + length <= array.data_size);
+      assert(offset + length <= array.size());
+   }
+
+   // Raw memory c-tors (e.g. one row of a 2D array, or with a stride one
+   // column of it or one channel of interleaved samples)
+
+   ConstArrayView1D(const Numeric* data, std::size_t length)
+         : data(data), offset(0), length(length), step(1)
+   {
+   }
+   ConstArrayView1D(const Numeric* data, std::size_t length, std::size_t stride)
+         : data(data), offset(0), length(length), step(stride)
+   {
+      assert(stride > 0);
    }
 
    // ArrayView c-tors
 
    ConstArrayView1D(const ArrayView1D<Numeric>& view)
-         : data(view.data), offset(view.offset), length(view.length)
+         : data(view.data), offset(view.offset), length(view.length), step(view.step)
    {
 #ifndef NDEBUG
       std::cout << "ConstArrayView1D" << " c-tor from ArrayView" << std::endl;
@@ -288,7 +380,7 @@ class ConstArrayView1D
    }
 
    ConstArrayView1D(const ArrayView1D<Numeric>& view, std::size_t offset, std::size_t length)
-         : data(view.data), offset(view.offset + offset), length(length)
+         : data(view.data), offset(view.offset + offset * view.step), length(length), step(view.step)
    {
 #ifndef NDEBUG
       std::cout << "ConstArrayView1D" << " c-tor from ArrayView (offset, length)" << std::endl;
@@ -300,7 +392,7 @@ class ConstArrayView1D
    // ConstArrayView c-tors
 
    ConstArrayView1D(const ConstArrayView1D<Numeric>& view)
-         : data(view.data), offset(view.offset), length(view.length)
+         : data(view.data), offset(view.offset), length(view.length), step(view.step)
    {
 #ifndef NDEBUG
       std::cout << "ConstArrayView1D" << " c-tor from ConstArrayView" << std::endl;
@@ -308,7 +400,7 @@ class ConstArrayView1D
    }
 
    ConstArrayView1D(const ConstArrayView1D<Numeric>& view, std::size_t offset, std::size_t length)
-         : data(view.data), offset(view.offset + offset), length(length)
+         : data(view.data), offset(view.offset + offset * view.step), length(length), step(view.step)
    {
 #ifndef NDEBUG
       std::cout << "ConstArrayView1D"
@@ -318,6 +410,9 @@ class ConstArrayView1D
       assert(offset + length <= view.length);
    }
 
+   // Rebinds the view (the elements are not copied)
+   inline ConstArrayView1D& operator=(const ConstArrayView1D&) = default;
+
    inline ~ConstArrayView1D() = default;
 
    inline std::size_t size() const
@@ -338,13 +433,35 @@ class ConstArrayView1D
 #endif
       // std::cout << "ConstArrayView: Const access operator at index " << idx <<
       // std::endl;
-      return data[idx + offset];
+      return data[offset + idx * step];
+   }
+
+   // Raw pointer to the first element of the view; the elements are stride()
+   // apart, the raw-pointer kernels require contiguous() views
+   inline const Numeric* data_ptr() const noexcept
+   {
+      return data + offset;
+   }
+
+   // Distance between consecutive elements, 1 for contiguous views
+   inline std::size_t stride() const noexcept
+   {
+      return step;
+   }
+
+   inline bool contiguous() const noexcept
+   {
+      return step == 1;
+   }
+
+   // Alignment of the first element in bytes, for picking aligned fast paths
+   inline std::size_t alignment() const noexcept
+   {
+      return pointer_alignment(data_ptr());
    }
 
    inline ConstArrayView1D<Numeric> view(std::size_t start, std::size_t end) const
    {
       return {*this, start, end - start};
    }
-
-   friend class Array1D<Numeric>;
 };
@@ -0,0 +1,277 @@
+#pragma once
+
+#include "myarray.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <stdexcept>
+
+template <typename Numeric>
+class ArrayView2D;
+template <typename Numeric>
+class ConstArrayView2D;
+
+// Row-major 2D array. Rows are padded to a multiple of the storage alignment
+// (stride >= cols), so every row starts on an aligned address.
+template <typename Numeric, typename Allocator = AlignedAllocator>
+class Array2D
+{
+   Array1D<Numeric, Allocator> storage;
+   std::size_t num_rows, num_cols, row_stride;
+
+   static inline std::size_t padded_stride(std::size_t cols)
+   {
+      constexpr std::size_t per_line = FASTCONV_ARRAY_ALIGNMENT % sizeof(Numeric) == 0
+            ? FASTCONV_ARRAY_ALIGNMENT / sizeof(Numeric)
+            : 1;
+      return (cols + per_line - 1) / per_line * per_line;
+   }
+
+ public:
+   inline Array2D()
+         : num_rows(0), num_cols(0), row_stride(0)
+   {
+   }
+
+   inline Array2D(std::size_t rows, std::size_t cols)
+         : storage(rows * padded_stride(cols)), num_rows(rows), num_cols(cols),
+           row_stride(padded_stride(cols))
+   {
+   }
+
+   inline std::size_t rows() const
+   {
+      return num_rows;
+   }
+
+   inline std::size_t cols() const
+   {
+      return num_cols;
+   }
+
+   inline std::size_t stride() const
+   {
+      return row_stride;
+   }
+
+   inline Numeric& operator()(std::size_t r, std::size_t c)
+#ifdef NDEBUG
+         noexcept
+#endif
+   {
+#ifndef NDEBUG
+      if ( r >= num_rows || c >= num_cols )
+      {
+         throw std::runtime_error("Out of bounds");
+      }
+#endif
+      return storage.data_ptr()[r * row_stride + c];
+   }
+
+   inline const Numeric& operator()(std::size_t r, std::size_t c) const
+#ifdef NDEBUG
+         noexcept
+#endif
+   {
+#ifndef NDEBUG
+      if ( r >= num_rows || c >= num_cols )
+      {
+         throw std::runtime_error("Out of bounds");
+      }
+#endif
+      return storage.data_ptr()[r * row_stride + c];
+   }
+
+   inline Numeric* data_ptr() noexcept
+   {
+      return storage.data_ptr();
+   }
+
+   inline const Numeric* data_ptr() const noexcept
+   {
+      return storage.data_ptr();
+   }
+
+   inline ArrayView1D<Numeric> row(std::size_t r)
+   {
+      assert(r < num_rows);
+      return {storage.data_ptr() + r * row_stride, num_cols};
+   }
+
+   inline ConstArrayView1D<Numeric> row(std::size_t r) const
+   {
+      assert(r < num_rows);
+      return {storage.data_ptr() + r * row_stride, num_cols};
+   }
+
+   // Column c as a strided 1D view (stride() apart)
+   inline ArrayView1D<Numeric> col(std::size_t c)
+   {
+      assert(c < num_cols);
+      return {storage.data_ptr() + c, num_rows, row_stride};
+   }
+
+   inline ConstArrayView1D<Numeric> col(std::size_t c) const
+   {
+      assert(c < num_cols);
+      return {storage.data_ptr() + c, num_rows, row_stride};
+   }
+};
+
+template <typename Numeric>
+class ArrayView2D
+{
+   Numeric* data;
+   std::size_t num_rows, num_cols, row_stride;
+
+ public:
+   template <typename Allocator>
+   ArrayView2D(Array2D<Numeric, Allocator>& array)
+         : data(array.data_ptr()), num_rows(array.rows()), num_cols(array.cols()),
+           row_stride(array.stride())
+   {
+   }
+
+   ArrayView2D(Numeric* data, std::size_t rows, std::size_t cols, std::size_t stride)
+         : data(data), num_rows(rows), num_cols(cols), row_stride(stride)
+   {
+      assert(stride >= cols);
+   }
+
+   inline std::size_t rows() const
+   {
+      return num_rows;
+   }
+
+   inline std::size_t cols() const
+   {
+      return num_cols;
+   }
+
+   inline std::size_t stride() const
+   {
+      return row_stride;
+   }
+
+   inline Numeric& operator()(std::size_t r, std::size_t c) const
+#ifdef NDEBUG
+         noexcept
+#endif
+   {
+#ifndef NDEBUG
+      if ( r >= num_rows || c >= num_cols )
+      {
+         throw std::runtime_error("Out of bounds");
+      }
+#endif
+      return data[r * row_stride + c];
+   }
+
+   inline Numeric* data_ptr() const noexcept
+   {
+      return data;
+   }
+
+   inline ArrayView1D<Numeric> row(std::size_t r) const
+   {
+      assert(r < num_rows);
+      return {data + r * row_stride, num_cols};
+   }
+
+   // Column c as a strided 1D view
+   inline ArrayView1D<Numeric> col(std::size_t c) const
+   {
+      assert(c < num_cols);
+      return {data + c, num_rows, row_stride};
+   }
+
+   // Rectangular sub-view of rows [r0, r1) and columns [c0, c1)
+   inline ArrayView2D<Numeric> view(std::size_t r0, std::size_t r1, std::size_t c0, std::size_t c1) const
+   {
+      assert(r0 <= r1 && r1 <= num_rows && c0 <= c1 && c1 <= num_cols);
+      return {data + r0 * row_stride + c0, r1 - r0, c1 - c0, row_stride};
+   }
+
+   friend class ConstArrayView2D<Numeric>;
+};
+
+template <typename Numeric>
+class ConstArrayView2D
+{
+   const Numeric* data;
+   std::size_t num_rows, num_cols, row_stride;
+
+ public:
+   template <typename Allocator>
+   ConstArrayView2D(const Array2D<Numeric, Allocator>& array)
+         : data(array.data_ptr()), num_rows(array.rows()), num_cols(array.cols()),
+           row_stride(array.stride())
+   {
+   }
+
+   ConstArrayView2D(const ArrayView2D<Numeric>& view)
+         : data(view.data), num_rows(view.num_rows), num_cols(view.num_cols), row_stride(view.row_stride)
+   {
+   }
+
+   ConstArrayView2D(const Numeric* data, std::size_t rows, std::size_t cols, std::size_t stride)
+         : data(data), num_rows(rows), num_cols(cols), row_stride(stride)
+   {
+      assert(stride >= cols);
+   }
+
+   inline std::size_t rows() const
+   {
+      return num_rows;
+   }
+
+   inline std::size_t cols() const
+   {
+      return num_cols;
+   }
+
+   inline std::size_t stride() const
+   {
+      return row_stride;
+   }
+
+   inline const Numeric& operator()(std::size_t r, std::size_t c) const
+#ifdef NDEBUG
+         noexcept
+#endif
+   {
+#ifndef NDEBUG
+      if ( r >= num_rows || c >= num_cols )
+      {
+         throw std::runtime_error("Out of bounds");
+      }
+#endif
+      return data[r * row_stride + c];
+   }
+
+   inline const Numeric* data_ptr() const noexcept
+   {
+      return data;
+   }
+
+   inline ConstArrayView1D<Numeric> row(std::size_t r) const
+   {
+      assert(r < num_rows);
+      return {data + r * row_stride, num_cols};
+   }
+
+   // Column c as a strided 1D view
+   inline ConstArrayView1D<Numeric> col(std::size_t c) const
+   {
+      assert(c < num_cols);
+      return {data + c, num_rows, row_stride};
+   }
+
+   // Rectangular sub-view of rows [r0, r1) and columns [c0, c1)
+   inline ConstArrayView2D<Numeric> view(std::size_t r0, std::size_t r1, std::size_t c0,
+         std::size_t c1) const
+   {
+      assert(r0 <= r1 && r1 <= num_rows && c0 <= c1 && c1 <= num_cols);
+      return {data + r0 * row_stride + c0, r1 - r0, c1 - c0, row_stride};
+   }
+};
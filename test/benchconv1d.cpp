@@ -0,0 +1,419 @@
+#include "auto.hpp"
+#include "conv1.hpp"
+#include "fft.hpp"
+#include "pad.hpp"
+#include "parallel.hpp"
+#include "perf.hpp"
+#include "ref.hpp"
+#include "simd.hpp"
+#include "tiled.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Benchmark sweep over engine x array size x kernel size x thread count.
+// Every case is warmed up, then timed call by call (conv_into into a
+// preallocated buffer) until the spread of the samples settles. Reports
+// median/p10/p90 ns per output, GFLOP/s (2 * kernel_size flops per output,
+// the direct-method count, also for the FFT engine) and the effective
+// bandwidth (input read + output written) against a STREAM triad peak.
+//
+// Environment:
+//    BENCH_ENGINES   comma-separated subset of ref,pad4,pad8,pad16,fft,tiled,auto
+//    BENCH_SIZES     array sizes (default 10000,100000,1000000,10000000)
+//    BENCH_KERNELS   kernel sizes (default 3,7,15,31,64,256)
+//    BENCH_THREADS   thread counts (default 1 and all hardware threads)
+//    BENCH_MIN_TIME  minimum measured seconds per case (default 0.2)
+//    BENCH_JSON      write the results as JSON to this file
+//    BENCH_CSV       write the results as CSV to this file
+//    BENCH_TAG       label stored with the results, e.g. the compiler
+//
+// Built with -DFASTCONV_PERF the measured loops are also wrapped with the
+// hardware counters of perf.hpp, reported per output next to the timings,
+// and the per-engine totals are printed at the end.
+
+struct BenchConfig
+{
+   std::vector<std::string> engines = {"ref", "pad8", "pad16", "fft", "tiled", "auto"};
+   std::vector<std::size_t> sizes = {10000, 100000, 1000000, 10000000};
+   std::vector<std::size_t> kernels = {3, 7, 15, 31, 64, 256};
+   std::vector<std::size_t> threads;
+   double min_time = 0.2;
+   std::string json_path, csv_path, tag;
+};
+
+struct BenchResult
+{
+   std::string engine;
+   std::size_t size, kernel, threads, samples;
+   double median_ns, p10_ns, p90_ns; // per output
+   double gflops, gbs;
+   std::vector<std::pair<std::string, double>> counters; // per output, with -DFASTCONV_PERF
+};
+
+// Samples are collected until at least min_time has been measured and the
+// p10-p90 spread is within 5% of the median, or until the sample cap
+constexpr std::size_t bench_min_samples = 5;
+constexpr std::size_t bench_max_samples = 1000;
+constexpr double bench_max_spread = 0.05;
+
+std::vector<std::string> split_list(const std::string& text)
+{
+   std::vector<std::string> items;
+   std::stringstream stream(text);
+   std::string item;
+   while ( std::getline(stream, item, ',') )
+   {
+      if ( !item.empty() )
+         items.push_back(item);
+   }
+   return items;
+}
+
+std::vector<std::size_t> read_sizes(const char* name, std::vector<std::size_t> fallback)
+{
+   const char* buf = std::getenv(name);
+   if ( !buf )
+      return fallback;
+   std::vector<std::size_t> values;
+   for ( const auto& item : split_list(buf) )
+   {
+      values.push_back(std::strtoull(item.c_str(), nullptr, 10));
+   }
+   return values.empty() ? fallback : values;
+}
+
+BenchConfig read_config()
+{
+   BenchConfig config;
+   if ( const char* buf = std::getenv("BENCH_ENGINES") )
+      config.engines = split_list(buf);
+   config.sizes = read_sizes("BENCH_SIZES", config.sizes);
+   config.kernels = read_sizes("BENCH_KERNELS", config.kernels);
+
+   const std::size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+   config.threads = read_sizes("BENCH_THREADS", hardware > 1 ? std::vector<std::size_t>{1, hardware}
+                                                               : std::vector<std::size_t>{1});
+   if ( const char* buf = std::getenv("BENCH_MIN_TIME") )
+      config.min_time = std::max(0.0, std::atof(buf));
+   if ( const char* buf = std::getenv("BENCH_JSON") )
+      config.json_path = buf;
+   if ( const char* buf = std::getenv("BENCH_CSV") )
+      config.csv_path = buf;
+   if ( const char* buf = std::getenv("BENCH_TAG") )
+      config.tag = buf;
+   return config;
+}
+
+std::string compiler_name()
+{
+#if defined(__INTEL_LLVM_COMPILER)
+   return "icpx " __VERSION__;
+#elif defined(__clang__)
+   return "clang " __VERSION__;
+#elif defined(__GNUC__)
+   return "gcc " __VERSION__;
+#else
+   return "unknown";
+#endif
+}
+
+void fill_array(Array1D<float>& x)
+{
+   for ( std::size_t i = 0; i < x.size(); ++i )
+   {
+      x(i) = std::sin(0.072 * i) + std::sin(0.0013 * i) + std::sin(0.02 * i);
+   }
+}
+
+// Value at fraction q of the sorted samples (nearest rank)
+double percentile(const std::vector<double>& sorted, double q)
+{
+   return sorted[static_cast<std::size_t>(q * (sorted.size() - 1) + 0.5)];
+}
+
+// Time fn until the samples are stable; returns the sorted seconds per call
+// and, if available, the counter totals of the measured calls
+template <typename Fn>
+std::vector<double> measure(Fn&& fn, double min_time, std::vector<std::pair<std::string, double>>& counters)
+{
+   using namespace std::chrono;
+
+   // warm-up: first touch of the output pages, planner trials, pool start
+   fn();
+   fn();
+
+   counters.clear();
+#ifdef FASTCONV_PERF
+   PerfCounters& perf = PerfCounters::thread_counters();
+   PerfValues perf_start;
+   const bool perf_valid = perf.read(perf_start);
+#endif
+
+   std::vector<double> samples;
+   double total = 0;
+   for ( ;; )
+   {
+      const auto t1 = steady_clock::now();
+      fn();
+      const auto t2 = steady_clock::now();
+      samples.push_back(duration<double>(t2 - t1).count());
+      total += samples.back();
+
+      if ( samples.size() >= bench_max_samples )
+         break;
+      if ( samples.size() < bench_min_samples || total < min_time )
+         continue;
+      std::vector<double> sorted(samples);
+      std::sort(sorted.begin(), sorted.end());
+      const double median = percentile(sorted, 0.5);
+      if ( percentile(sorted, 0.9) - percentile(sorted, 0.1) <= bench_max_spread * median
+            || total > 10 * min_time )
+         break;
+   }
+
+#ifdef FASTCONV_PERF
+   PerfValues perf_end;
+   if ( perf_valid && perf.read(perf_end) )
+   {
+      for ( std::size_t e = 0; e < perf_end.size(); e++ )
+      {
+         if ( perf.has(static_cast<PerfEvent>(e)) )
+            counters.emplace_back(PerfCounters::names()[e], double(perf_end[e] - perf_start[e]));
+      }
+   }
+#endif
+   std::sort(samples.begin(), samples.end());
+   return samples;
+}
+
+// STREAM triad a = b + s * c over arrays much larger than the caches, on
+// `threads` threads; returns the best GB/s (12 bytes per element)
+double stream_triad(std::size_t threads)
+{
+   using namespace std::chrono;
+
+   const std::size_t n = 1 << 24;
+   Array1D<float> a(n), b(n), c(n);
+   ThreadPool pool(threads);
+   const std::size_t chunks = 4 * threads;
+   auto run = [&](std::size_t i, bool init) {
+      const std::size_t start = n / chunks * i, end = i + 1 == chunks ? n : n / chunks * (i + 1);
+      float *pa = a.data_ptr(), *pb = b.data_ptr(), *pc = c.data_ptr();
+      for ( std::size_t j = start; j < end; j++ )
+      {
+         if ( init )
+         {
+            pb[j] = 1.0f;
+            pc[j] = 2.0f;
+         }
+         pa[j] = pb[j] + 3.0f * pc[j];
+      }
+   };
+   pool.parallel_for(chunks, [&](std::size_t i) { run(i, true); });
+
+   double best = 0;
+   for ( int rep = 0; rep < 10; rep++ )
+   {
+      const auto t1 = steady_clock::now();
+      pool.parallel_for(chunks, [&](std::size_t i) { run(i, false); });
+      const auto t2 = steady_clock::now();
+      best = std::max(best, 12.0 * n / duration<double>(t2 - t1).count() * 1e-9);
+   }
+   return best;
+}
+
+template <typename Engine>
+BenchResult bench_engine(const std::string& name, Engine& engine, std::size_t threads,
+      const Array1D<float>& x, std::size_t kernel_size, double min_time)
+{
+   Array1D<float> y(engine.output_size(x.size()));
+   BenchResult result;
+   const auto samples = measure([&]() { engine.conv_into(x, y); }, min_time, result.counters);
+
+   result.engine = name;
+   result.size = x.size();
+   result.kernel = kernel_size;
+   result.threads = threads;
+   result.samples = samples.size();
+   const double outputs = static_cast<double>(y.size());
+   const double median = percentile(samples, 0.5);
+   result.median_ns = median / outputs * 1e9;
+   result.p10_ns = percentile(samples, 0.1) / outputs * 1e9;
+   result.p90_ns = percentile(samples, 0.9) / outputs * 1e9;
+   result.gflops = 2.0 * kernel_size * outputs / median * 1e-9;
+   result.gbs = (x.size() + y.size()) * sizeof(float) / median * 1e-9;
+   for ( auto& counter : result.counters )
+      counter.second /= outputs * samples.size();
+   return result;
+}
+
+// Run one case; returns false for engines that are unknown or do not thread
+bool run_case(const std::string& name, std::size_t threads, const Array1D<float>& x,
+      const Array1D<float>& k, double min_time, BenchResult& result)
+{
+   auto threaded = [&](auto& engine) {
+      engine.set_threads(threads);
+      result = bench_engine(name, engine, threads, x, k.size(), min_time);
+      return true;
+   };
+   auto serial = [&](auto& engine) {
+      if ( threads > 1 )
+         return false;
+      result = bench_engine(name, engine, threads, x, k.size(), min_time);
+      return true;
+   };
+
+   if ( name == "ref" )
+   {
+      Conv1DRef<float> engine(k);
+      return threaded(engine);
+   }
+   if ( name.compare(0, 3, "pad") == 0 )
+   {
+      Conv1DPad<float> engine(k, std::strtoull(name.c_str() + 3, nullptr, 10));
+      return threaded(engine);
+   }
+   if ( name == "fft" )
+   {
+      Conv1DFFT<float> engine(k);
+      return serial(engine);
+   }
+   if ( name == "tiled" )
+   {
+      Conv1DTiled<float> engine(k);
+      return threaded(engine);
+   }
+   if ( name == "auto" )
+   {
+      Conv1DAuto<float> engine(k, false, std::make_shared<Conv1DWisdom>());
+      return serial(engine);
+   }
+   std::cerr << "Unknown engine " << name << std::endl;
+   return false;
+}
+
+void write_csv(const std::string& path, const BenchConfig& config, double peak_gbs,
+      const std::vector<BenchResult>& results)
+{
+   std::ofstream out(path);
+   out << "tag,compiler,isa,engine,size,kernel,threads,samples,median_ns,p10_ns,p90_ns,gflops,gbs,"
+       << "peak_fraction,counters\n";
+   for ( const auto& r : results )
+   {
+      out << config.tag << ",\"" << compiler_name() << "\"," << simd_isa_name(simd_isa()) << ','
+          << r.engine << ',' << r.size << ',' << r.kernel << ',' << r.threads << ',' << r.samples << ','
+          << r.median_ns << ',' << r.p10_ns << ',' << r.p90_ns << ',' << r.gflops << ',' << r.gbs << ','
+          << r.gbs / peak_gbs << ",\"";
+      for ( std::size_t i = 0; i < r.counters.size(); i++ )
+         out << (i > 0 ? ";" : "") << r.counters[i].first << '=' << r.counters[i].second;
+      out << "\"\n";
+   }
+   if ( !out )
+      std::cerr << "Cannot write " << path << std::endl;
+}
+
+void write_json(const std::string& path, const BenchConfig& config, double peak_gbs,
+      const std::vector<BenchResult>& results)
+{
+   std::ofstream out(path);
+   const std::time_t now = std::time(nullptr);
+   char date[32];
+   std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+   out << "{\n  \"tag\": \"" << config.tag << "\",\n  \"compiler\": \"" << compiler_name() << "\",\n"
+       << "  \"isa\": \"" << simd_isa_name(simd_isa()) << "\",\n  \"date\": \"" << date << "\",\n"
+       << "  \"stream_triad_gbs\": " << peak_gbs << ",\n  \"results\": [\n";
+   for ( std::size_t i = 0; i < results.size(); i++ )
+   {
+      const auto& r = results[i];
+      out << "    {\"engine\": \"" << r.engine << "\", \"size\": " << r.size << ", \"kernel\": " << r.kernel
+          << ", \"threads\": " << r.threads << ", \"samples\": " << r.samples
+          << ", \"median_ns\": " << r.median_ns << ", \"p10_ns\": " << r.p10_ns
+          << ", \"p90_ns\": " << r.p90_ns << ", \"gflops\": " << r.gflops << ", \"gbs\": " << r.gbs
+          << ", \"peak_fraction\": " << r.gbs / peak_gbs;
+      if ( !r.counters.empty() )
+      {
+         out << ", \"counters\": {";
+         for ( std::size_t j = 0; j < r.counters.size(); j++ )
+            out << (j > 0 ? ", " : "") << '"' << r.counters[j].first << "\": " << r.counters[j].second;
+         out << '}';
+      }
+      out << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+   }
+   out << "  ]\n}\n";
+   if ( !out )
+      std::cerr << "Cannot write " << path << std::endl;
+}
+
+int main()
+{
+   const BenchConfig config = read_config();
+   const std::size_t max_threads = *std::max_element(config.threads.begin(), config.threads.end());
+   const double peak_gbs = stream_triad(max_threads);
+
+   std::cout
+         << "compiler = " << compiler_name() << "; isa = " << simd_isa_name(simd_isa())
+         << "; stream triad = " << std::fixed << std::setprecision(1) << peak_gbs << " GB/s ("
+         << max_threads << " threads)" << std::endl;
+   std::cout
+         << std::left << std::setw(8) << "engine" << std::right << std::setw(10) << "size" << std::setw(8)
+         << "kernel" << std::setw(8) << "threads" << std::setw(12) << "median ns" << std::setw(10)
+         << "p10 ns" << std::setw(10) << "p90 ns" << std::setw(10) << "GFLOP/s" << std::setw(9) << "GB/s"
+         << std::setw(8) << "%peak" << std::endl;
+
+   std::vector<BenchResult> results;
+   for ( const auto size : config.sizes )
+   {
+      Array1D<float> x(size);
+      fill_array(x);
+      for ( const auto kernel_size : config.kernels )
+      {
+         if ( kernel_size == 0 || kernel_size > size )
+            continue;
+         Array1D<float> k(kernel_size);
+         fill_array(k);
+         for ( const auto threads : config.threads )
+         {
+            for ( const auto& engine : config.engines )
+            {
+               BenchResult r;
+               if ( !run_case(engine, threads, x, k, config.min_time, r) )
+                  continue;
+               results.push_back(r);
+               std::cout
+                     << std::left << std::setw(8) << r.engine << std::right << std::setw(10) << r.size
+                     << std::setw(8) << r.kernel << std::setw(8) << r.threads << std::setprecision(4)
+                     << std::setw(12) << r.median_ns << std::setw(10) << r.p10_ns << std::setw(10)
+                     << r.p90_ns << std::setprecision(2) << std::setw(10) << r.gflops << std::setw(9)
+                     << r.gbs << std::setprecision(1) << std::setw(8) << 100 * r.gbs / peak_gbs;
+               for ( const auto& counter : r.counters )
+                  std::cout << "  " << counter.first << '=' << std::setprecision(3) << counter.second;
+               std::cout << std::endl;
+            }
+         }
+      }
+   }
+
+#ifdef FASTCONV_PERF
+   std::cout << std::endl;
+   PerfRegistry::global().report(std::cout);
+#endif
+
+   if ( !config.json_path.empty() )
+      write_json(config.json_path, config, peak_gbs, results);
+   if ( !config.csv_path.empty() )
+      write_csv(config.csv_path, config, peak_gbs, results);
+   return 0;
+}
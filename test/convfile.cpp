@@ -0,0 +1,127 @@
+#include "auto.hpp"
+#include "conv1.hpp"
+#include "fft.hpp"
+#include "file.hpp"
+#include "pad.hpp"
+#include "ref.hpp"
+#include "tiled.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <sys/resource.h>
+
+// File-to-file convolution of raw float32 signals larger than memory:
+//
+//    convfile <input> <output> <kernel>
+//
+// All three files are raw native-endian float32 without a header; the
+// output holds the valid convolution. Environment variables:
+//    CONVFILE_ENGINE      ref, pad4, pad8, pad16, fft, tiled or auto (default pad8)
+//    CONVFILE_WINDOW      outputs per window (default 4M)
+//    CONVFILE_READ_AHEAD  number of read-ahead threads (default 1)
+//    CONVFILE_MMAP        1 to write through an mmap of the output
+//    CONVFILE_KEEP_CACHE  1 to leave the files in the page cache
+//    NUM_THREADS          threads of the ref and pad engines (default 1)
+
+Array1D<float> read_kernel(const std::string& path)
+{
+   std::ifstream in(path, std::ios::binary | std::ios::ate);
+   if ( !in )
+   {
+      throw std::runtime_error("Cannot open " + path);
+   }
+   const std::size_t bytes = static_cast<std::size_t>(in.tellg());
+   Array1D<float> k(bytes / sizeof(float));
+   in.seekg(0);
+   in.read(reinterpret_cast<char*>(k.data_ptr()), k.size() * sizeof(float));
+   return k;
+}
+
+std::size_t read_size(const char* name, std::size_t fallback)
+{
+   const char* buf = std::getenv(name);
+   return buf ? std::strtoull(buf, nullptr, 10) : fallback;
+}
+
+// Run the driver over the files with a configured engine
+template <typename Engine>
+Conv1DFileStats run_file(Engine& engine, const std::string& input_path, const std::string& output_path)
+{
+   Conv1DFile<float> driver(*(Conv1DBase<float>*)&engine);
+   driver.set_window(read_size("CONVFILE_WINDOW", FASTCONV_FILE_WINDOW));
+   driver.set_read_ahead(read_size("CONVFILE_READ_AHEAD", 1));
+   driver.set_map_output(read_size("CONVFILE_MMAP", 0) != 0);
+   driver.set_drop_cache(read_size("CONVFILE_KEEP_CACHE", 0) == 0);
+   return driver.conv_file(input_path, output_path);
+}
+
+Conv1DFileStats run_engine(const std::string& name, const Array1D<float>& k, const std::string& input_path,
+      const std::string& output_path)
+{
+   const std::size_t threads = std::max<std::size_t>(read_size("NUM_THREADS", 1), 1);
+   if ( name == "ref" )
+   {
+      Conv1DRef<float> engine(k);
+      engine.set_threads(threads);
+      return run_file(engine, input_path, output_path);
+   }
+   if ( name.compare(0, 3, "pad") == 0 )
+   {
+      Conv1DPad<float> engine(k, std::strtoull(name.c_str() + 3, nullptr, 10));
+      engine.set_threads(threads);
+      return run_file(engine, input_path, output_path);
+   }
+   if ( name == "fft" )
+   {
+      Conv1DFFT<float> engine(k);
+      return run_file(engine, input_path, output_path);
+   }
+   if ( name == "tiled" )
+   {
+      Conv1DTiled<float> engine(k);
+      engine.set_threads(threads);
+      return run_file(engine, input_path, output_path);
+   }
+   if ( name == "auto" )
+   {
+      Conv1DAuto<float> engine(k);
+      return run_file(engine, input_path, output_path);
+   }
+   throw std::invalid_argument("Unknown engine " + name);
+}
+
+int main(int argc, char* argv[])
+{
+   if ( argc != 4 )
+   {
+      std::cerr << "usage: " << argv[0] << " <input> <output> <kernel>   (raw float32 files)" << std::endl;
+      return 1;
+   }
+
+   try
+   {
+      const Array1D<float> k = read_kernel(argv[3]);
+      const char* name = std::getenv("CONVFILE_ENGINE");
+      const Conv1DFileStats stats = run_engine(name ? name : "pad8", k, argv[1], argv[2]);
+
+      struct rusage usage;
+      getrusage(RUSAGE_SELF, &usage);
+      const double gb = (stats.input_bytes + stats.output_bytes) * 1e-9;
+      std::cout
+            << std::fixed << std::setprecision(3) << "kernel = " << k.size() << "; input = "
+            << stats.input_bytes * 1e-9 << " GB; output = " << stats.output_bytes * 1e-9
+            << " GB; windows = " << stats.windows << "; time = " << stats.seconds << " s; throughput = "
+            << (stats.seconds > 0 ? gb / stats.seconds : 0.0) << " GB/s; peak RSS = "
+            << usage.ru_maxrss / 1024.0 << " MB" << std::endl;
+   }
+   catch ( const std::exception& e )
+   {
+      std::cerr << e.what() << std::endl;
+      return 1;
+   }
+   return 0;
+}
@@ -31,4 +31,19 @@ int main()
    std::cout << arr1.view(5, 6)(0) << std::endl;
    Array1D<float> arr2{arr1.view(10, 12)};
    std::cout << sum<float>(arr2) << std::endl;
+
+   Array1D<float, PoolAllocator> pooled{arr1.view(4, 12)};
+   std::cout << sum<float>(pooled) << " (alignment " << pooled.alignment() << ")" << std::endl;
+   Array1D<float, HugePageAllocator> large(1 << 22);
+   for ( std::size_t i = 0; i < large.size(); i++ )
+   {
+      large(i) = 1;
+   }
+   std::cout << sum<float>(large.view(8, 12)) << " (alignment " << large.view(8, 12).alignment() << ")"
+             << std::endl;
+
+   // every third element, then elements 2 .. 4 of that (6, 9, 12)
+   ConstArrayView1D<float> every_third(arr1.data_ptr(), 7, 3);
+   std::cout << sum<float>(every_third) << " " << sum<float>(every_third.view(2, 5)) << " (stride "
+             << every_third.view(2, 5).stride() << ")" << std::endl;
 }
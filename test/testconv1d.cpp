@@ -1,20 +1,40 @@
+#include "auto.hpp"
+#include "bank.hpp"
+#include "cascade.hpp"
+#include "complex.hpp"
 #include "conv1.hpp"
+#include "epilogue.hpp"
+#include "fft.hpp"
+#include "lowp.hpp"
 #include "pad.hpp"
 #include "ref.hpp"
+#include "resample.hpp"
+#include "separable.hpp"
+#include "sparse.hpp"
+#include "stream.hpp"
+#include "tiled.hpp"
 #include <algorithm>
 #include <array>
 #include <chrono>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <numeric>
 #include <string>
+#include <utility>
 #include <vector>
 
 const std::vector<int64_t> array_sizes = {10000L, 100000L, 1000000L, 10000000L};
 const std::vector<int64_t> kernel_sizes = {3, 4, 5, 6, 7, 8, 9, 11, 13, 15, 19, 25, 31};
+const std::vector<int64_t> long_kernel_sizes = {64, 256, 1024};
+const std::vector<int64_t> packet_sizes = {256, 1024, 4096};
 bool extra_output = false;
+bool long_kernels = false;
+bool check_only = false;
+std::size_t num_threads = 1;
+int failures = 0; // failed identity checks, main returns non-zero if any
 
 void fill_array(Array1D<float>& x)
 {
@@ -36,13 +56,23 @@ void print_list(const std::string& caption, const std::vector<int64_t>& items)
    std ::cout << std::endl;
 }
 
-void run_test(const std::string& test_title, Conv1DBase<float>* conv)
+// Bitwise comparison for the identity checks; a mismatch counts as a failure
+bool check_identical(const ConstArrayView1D<float>& a, const ConstArrayView1D<float>& b)
+{
+   const bool identical =
+         a.size() == b.size() && std::memcmp(a.data_ptr(), b.data_ptr(), a.size() * sizeof(float)) == 0;
+   failures += identical ? 0 : 1;
+   return identical;
+}
+
+void run_test(const std::string& test_title, Conv1DBase<float>* conv,
+      const std::vector<int64_t>& kernel_sizes = ::kernel_sizes)
 {
    using namespace std::chrono;
 
    double time_total = 0;
    double verif_x = 0, verif_y = 0;
-   double time_avg = 0;
+   double time_avg = 0, time_into_avg = 0;
 
    for ( const auto& array_size : array_sizes )
    {
@@ -66,7 +96,10 @@ void run_test(const std::string& test_title, Conv1DBase<float>* conv)
                      (std::pow(static_cast<double>(array_size), 0.8) *
                            std::pow(static_cast<double>(kernel_size), 0.5)))));
 
-         double time_onesize = 0;
+         double time_onesize = 0, time_into_onesize = 0;
+
+         // caller-owned output buffer for conv_into, reused across repetitions
+         Array1D<float> y_into(conv->output_size(array_size));
 
          for ( int64_t l = 0; l < reps; ++l )
          {
@@ -79,6 +112,12 @@ void run_test(const std::string& test_title, Conv1DBase<float>* conv)
             time_total += duration<double>(t2 - t1).count();
             time_onesize += duration<double>(t2 - t1).count();
 
+            t1 = high_resolution_clock::now();
+            conv->conv_into(x, y_into);
+            t2 = high_resolution_clock::now();
+
+            time_into_onesize += duration<double>(t2 - t1).count();
+
             for ( int64_t ix = 0; ix < x.size(); ix++ )
             {
                verif_x += x(ix);
@@ -91,24 +130,928 @@ void run_test(const std::string& test_title, Conv1DBase<float>* conv)
 
          time_onesize = time_onesize / reps * 1e9L / array_size;
          time_avg += time_onesize;
+         time_into_onesize = time_into_onesize / reps * 1e9L / array_size;
+         time_into_avg += time_into_onesize;
 
          if ( extra_output )
          {
             std::cout
                   << "array = " << array_size << "; kernel = " << kernel_size << "; reps = " << reps
                   << std::fixed << std::setw(8) << std::setprecision(5) << "; t = " << time_onesize
-                  << std::endl;
+                  << "; t_into = " << time_into_onesize << std::endl;
          }
       }
    }
 
    time_avg /= array_sizes.size() * kernel_sizes.size();
+   time_into_avg /= array_sizes.size() * kernel_sizes.size();
    std::cout
          << test_title << " --> " << std::fixed << std::setprecision(2) << "time = " << time_total
-         << std::setprecision(5) << "; sec/GOps = " << time_avg << std::setw(17) << std::setprecision(0)
+         << std::setprecision(5) << "; sec/GOps = " << time_avg
+         << "; conv_into sec/GOps = " << time_into_avg << std::setw(17) << std::setprecision(0)
          << "; verif_x = " << verif_x << "; verif_y = " << verif_y << std::endl;
 }
 
+// Push a 1M-sample signal through Conv1DStream in fixed-size packets and
+// report the mean latency per packet over all kernel sizes
+void run_stream_test(int64_t packet_size)
+{
+   using namespace std::chrono;
+
+   const int64_t signal_size = 1000000;
+   Array1D<float> x(signal_size);
+   fill_array(x);
+   Array1D<float> y(signal_size);
+
+   double time_total = 0, verif_y = 0;
+   int64_t packets = 0;
+   bool identical = true;
+
+   for ( const auto& kernel_size : kernel_sizes )
+   {
+      Array1D<float> k(kernel_size);
+      fill_array(k);
+      Conv1DStream<float> stream(k);
+      std::size_t emitted = 0;
+
+      for ( int64_t start = 0; start < signal_size; start += packet_size )
+      {
+         const auto packet = x.const_view(start, std::min(start + packet_size, signal_size));
+         const std::size_t n = stream.output_size(packet.size());
+
+         auto t1 = high_resolution_clock::now();
+         stream.push(packet, y.view(emitted, emitted + n));
+         auto t2 = high_resolution_clock::now();
+
+         time_total += duration<double>(t2 - t1).count();
+         packets++;
+         for ( std::size_t iy = emitted; iy < emitted + n; iy++ )
+         {
+            verif_y += y(iy);
+         }
+         emitted += n;
+      }
+
+      // the streamed outputs are the one-shot convolution of the whole signal
+      Conv1DRef<float> conv1d_ref(k);
+      identical = check_identical(y.const_view(0, emitted), conv1d_ref.conv(x)) && identical;
+   }
+
+   std::cout
+         << "Conv1DStream (packet=" << packet_size << ") --> " << std::fixed << std::setprecision(3)
+         << "usec/packet = " << time_total / packets * 1e6 << std::setw(17) << std::setprecision(0)
+         << "; verif_y = " << verif_y << "; identical = " << (identical ? "yes" : "NO") << std::endl;
+}
+
+// Convolve a batch of channels with a shared kernel, once channel by channel
+// with conv_into and once with conv_batch_into, and report the throughput
+void run_batch_test(const std::string& test_title, Conv1DBase<float>* conv)
+{
+   using namespace std::chrono;
+
+   const std::size_t channels = 1024, samples = 10000;
+   Array2D<float> x(channels, samples);
+   for ( std::size_t r = 0; r < channels; r++ )
+   {
+      for ( std::size_t c = 0; c < samples; c++ )
+      {
+         x(r, c) = std::sin(0.072 * c + r);
+      }
+   }
+
+   double time_loop = 0, time_batch = 0, verif_loop = 0, verif_batch = 0;
+
+   for ( const auto& kernel_size : kernel_sizes )
+   {
+      Array1D<float> k(kernel_size);
+      fill_array(k);
+      conv->set_kernel(k);
+      Array2D<float> y(channels, conv->output_size(samples));
+      conv->conv_batch_into(x, y); // warm-up, touches the output pages
+
+      auto t1 = high_resolution_clock::now();
+      for ( std::size_t r = 0; r < channels; r++ )
+      {
+         conv->conv_into(x.row(r), y.row(r));
+      }
+      auto t2 = high_resolution_clock::now();
+      time_loop += duration<double>(t2 - t1).count();
+      for ( std::size_t r = 0; r < channels; r++ )
+      {
+         verif_loop += y(r, 0) + y(r, y.cols() - 1);
+      }
+
+      t1 = high_resolution_clock::now();
+      conv->conv_batch_into(x, y);
+      t2 = high_resolution_clock::now();
+      time_batch += duration<double>(t2 - t1).count();
+      for ( std::size_t r = 0; r < channels; r++ )
+      {
+         verif_batch += y(r, 0) + y(r, y.cols() - 1);
+      }
+   }
+
+   const double samples_total = double(channels) * samples * kernel_sizes.size();
+   std::cout
+         << test_title << " batch --> " << std::fixed << std::setprecision(1)
+         << "per-channel MS/s = " << samples_total / time_loop * 1e-6
+         << "; batched MS/s = " << samples_total / time_batch * 1e-6 << std::setprecision(3)
+         << "; verif = " << verif_loop << " / " << verif_batch << std::endl;
+}
+
+// Apply 32 kernels (lengths cycling through kernel_sizes) to one signal,
+// with separate Conv1DRef objects and with a single Conv1DBank
+void run_bank_test()
+{
+   using namespace std::chrono;
+
+   const std::size_t signal_size = 1000000, num_kernels = 32;
+   Array1D<float> x(signal_size);
+   fill_array(x);
+
+   std::vector<Array1D<float>> kernels;
+   std::vector<ConstArrayView1D<float>> kernel_views;
+   std::vector<Conv1DRef<float>> convs;
+   for ( std::size_t n = 0; n < num_kernels; n++ )
+   {
+      kernels.emplace_back(kernel_sizes[n % kernel_sizes.size()]);
+      fill_array(kernels.back());
+   }
+   for ( const auto& k : kernels )
+   {
+      kernel_views.push_back(k);
+      convs.emplace_back(k);
+   }
+
+   Conv1DBank<float> bank(kernel_views);
+   Array2D<float> y(num_kernels, bank.output_size(signal_size));
+   bank.conv_into(x, y); // warm-up, touches the output pages
+
+   auto t1 = high_resolution_clock::now();
+   for ( std::size_t n = 0; n < num_kernels; n++ )
+   {
+      convs[n].conv_into(x, y.row(n).view(0, convs[n].output_size(signal_size)));
+   }
+   auto t2 = high_resolution_clock::now();
+   const double time_separate = duration<double>(t2 - t1).count();
+   double verif_separate = 0;
+   for ( std::size_t n = 0; n < num_kernels; n++ )
+   {
+      verif_separate += y(n, 0) + y(n, bank.valid_size(n, signal_size) - 1);
+   }
+
+   t1 = high_resolution_clock::now();
+   bank.conv_into(x, y);
+   t2 = high_resolution_clock::now();
+   const double time_bank = duration<double>(t2 - t1).count();
+   double verif_bank = 0;
+   for ( std::size_t n = 0; n < num_kernels; n++ )
+   {
+      verif_bank += y(n, 0) + y(n, bank.valid_size(n, signal_size) - 1);
+   }
+
+   std::cout
+         << "Conv1DBank (" << num_kernels << " kernels) --> " << std::fixed << std::setprecision(5)
+         << "separate sec = " << time_separate << "; bank sec = " << time_bank << std::setprecision(3)
+         << "; verif = " << verif_separate << " / " << verif_bank << std::endl;
+}
+
+// Linear-phase (symmetric) kernels with the folded kernels and with folding
+// switched off
+void run_symmetric_test()
+{
+   using namespace std::chrono;
+
+   const std::size_t signal_size = 10000000;
+   Array1D<float> x(signal_size);
+   fill_array(x);
+
+   for ( const std::size_t kernel_size : {3, 5, 7, 31} )
+   {
+      Array1D<float> k(kernel_size);
+      for ( std::size_t i = 0; i < kernel_size; i++ )
+      {
+         const double t = double(i) - 0.5 * (kernel_size - 1);
+         k(i) = std::exp(-t * t / kernel_size);
+      }
+
+      Conv1DRef<float> conv(k);
+      Array1D<float> y(conv.output_size(signal_size));
+      conv.conv_into(x, y); // warm-up, touches the output pages
+
+      conv.set_folding(false);
+      auto t1 = high_resolution_clock::now();
+      conv.conv_into(x, y);
+      auto t2 = high_resolution_clock::now();
+      const double time_plain = duration<double>(t2 - t1).count();
+      const double verif_plain = y(0) + y(y.size() / 2) + y(y.size() - 1);
+
+      conv.set_folding(true);
+      t1 = high_resolution_clock::now();
+      conv.conv_into(x, y);
+      t2 = high_resolution_clock::now();
+      const double time_folded = duration<double>(t2 - t1).count();
+      const double verif_folded = y(0) + y(y.size() / 2) + y(y.size() - 1);
+
+      std::cout
+            << "Conv1DRef (symmetric, kernel=" << kernel_size << ") --> " << std::fixed
+            << std::setprecision(5) << "plain sec = " << time_plain << "; folded sec = " << time_folded
+            << std::setprecision(3) << "; verif = " << verif_plain << " / " << verif_folded << std::endl;
+   }
+}
+
+// Filter and keep every stride-th sample: full convolution followed by
+// decimation, versus the strided engine that computes only the kept outputs
+void run_decimation_test(std::size_t stride)
+{
+   using namespace std::chrono;
+
+   const std::size_t signal_size = 10000000, kernel_size = 31;
+   Array1D<float> x(signal_size), k(kernel_size);
+   fill_array(x);
+   fill_array(k);
+
+   Conv1DPad<float> conv_full(k, 16), conv_strided(k, 16);
+   conv_strided.set_stride(stride);
+   Array1D<float> y_full(conv_full.output_size(signal_size));
+   Array1D<float> y(conv_strided.output_size(signal_size));
+   conv_full.conv_into(x, y_full); // warm-up, touches the output pages
+   conv_strided.conv_into(x, y);
+
+   auto t1 = high_resolution_clock::now();
+   conv_full.conv_into(x, y_full);
+   for ( std::size_t m = 0; m < y.size(); m++ )
+   {
+      y(m) = y_full(m * stride);
+   }
+   auto t2 = high_resolution_clock::now();
+   const double time_full = duration<double>(t2 - t1).count();
+   const double verif_full = y(0) + y(y.size() / 2) + y(y.size() - 1);
+
+   t1 = high_resolution_clock::now();
+   conv_strided.conv_into(x, y);
+   t2 = high_resolution_clock::now();
+   const double time_strided = duration<double>(t2 - t1).count();
+   const double verif_strided = y(0) + y(y.size() / 2) + y(y.size() - 1);
+
+   std::cout
+         << "Conv1DPad (stride=" << stride << ", kernel=" << kernel_size << ") --> " << std::fixed
+         << std::setprecision(5) << "full+decimate sec = " << time_full
+         << "; strided sec = " << time_strided << std::setprecision(3) << "; verif = " << verif_full
+         << " / " << verif_strided << std::endl;
+}
+
+// Input of n samples extended by mode, independently of boundary.hpp: the
+// samples p - offset for p in [0, n + kernel_size - 1)
+Array1D<float> extend_copy(const Array1D<float>& x, std::size_t kernel_size, Conv1DBoundary mode,
+      float value)
+{
+   const std::ptrdiff_t n = x.size(), offset = (kernel_size - 1) / 2;
+   Array1D<float> padded(x.size() + kernel_size - 1);
+   for ( std::size_t i = 0; i < padded.size(); i++ )
+   {
+      std::ptrdiff_t p = std::ptrdiff_t(i) - offset;
+      if ( p >= 0 && p < n )
+      {
+         padded(i) = x(p);
+         continue;
+      }
+      switch ( mode )
+      {
+      case Conv1DBoundary::replicate:
+         padded(i) = x(p < 0 ? 0 : n - 1);
+         break;
+      case Conv1DBoundary::reflect:
+         // fold at the first and last sample until p is inside
+         while ( n > 1 && (p < 0 || p >= n) )
+            p = p < 0 ? -p : 2 * (n - 1) - p;
+         padded(i) = x(n > 1 ? p : 0);
+         break;
+      case Conv1DBoundary::wrap:
+         padded(i) = x((p % n + n) % n);
+         break;
+      case Conv1DBoundary::constant:
+         padded(i) = value;
+         break;
+      default:
+         padded(i) = 0;
+      }
+   }
+   return padded;
+}
+
+// Same-size output with extended edges: an extended copy of the input and a
+// valid convolution, versus preserve_shape with set_boundary. Reflect is
+// timed; every mode is compared bitwise, including inputs shorter than the
+// kernel, where the edges extend past both ends.
+void run_boundary_test(std::size_t kernel_size)
+{
+   using namespace std::chrono;
+
+   const std::size_t signal_size = 10000000;
+   Array1D<float> x(signal_size), k(kernel_size);
+   fill_array(x);
+   fill_array(k);
+
+   Conv1DPad<float> conv_valid(k, 16), conv_same(k, 16, true);
+   conv_same.set_boundary(Conv1DBoundary::reflect);
+   Array1D<float> y_padded(signal_size), y_same(signal_size);
+   conv_same.conv_into(x, y_same); // warm-up, touches the output pages
+   conv_valid.conv_into(extend_copy(x, kernel_size, Conv1DBoundary::reflect, 0), y_padded);
+
+   auto t1 = high_resolution_clock::now();
+   conv_valid.conv_into(extend_copy(x, kernel_size, Conv1DBoundary::reflect, 0), y_padded);
+   auto t2 = high_resolution_clock::now();
+   const double time_padded = duration<double>(t2 - t1).count();
+
+   t1 = high_resolution_clock::now();
+   conv_same.conv_into(x, y_same);
+   t2 = high_resolution_clock::now();
+   const double time_same = duration<double>(t2 - t1).count();
+
+   const bool split_invariant = simd_split_invariant();
+   std::string results = "reflect (timed) = ";
+   results += split_invariant ? (check_identical(y_padded, y_same) ? "yes" : "NO") : "skipped";
+   if ( split_invariant )
+   {
+      const std::pair<Conv1DBoundary, const char*> modes[] = {{Conv1DBoundary::zero, "zero"},
+            {Conv1DBoundary::constant, "constant"}, {Conv1DBoundary::replicate, "replicate"},
+            {Conv1DBoundary::reflect, "reflect"}, {Conv1DBoundary::wrap, "wrap"}};
+      const std::size_t sizes[] = {1, kernel_size / 2 + 1, kernel_size, 3 * kernel_size + 1};
+      for ( const auto& mode : modes )
+      {
+         bool identical = true;
+         for ( const std::size_t size : sizes )
+         {
+            Array1D<float> xs(size);
+            fill_array(xs);
+            const Array1D<float> padded = extend_copy(xs, kernel_size, mode.first, 0.5f);
+            conv_same.set_boundary(mode.first, 0.5f);
+            identical = check_identical(conv_same.conv(xs), conv_valid.conv(padded)) && identical;
+         }
+         results += std::string("; ") + mode.second + " = " + (identical ? "yes" : "NO");
+      }
+   }
+
+   std::cout << "Conv1DPad (boundary, kernel=" << kernel_size << ") --> " << std::fixed
+             << std::setprecision(5) << "reflect padded copy sec = " << time_padded
+             << "; boundary sec = " << time_same << "; identical: " << results << std::endl;
+}
+
+// Convolution, scale/bias + ReLU and the energy of the result: separate passes
+// over the output versus the fused epilogue (identical outputs and energy)
+void run_fused_test(std::size_t kernel_size)
+{
+   using namespace std::chrono;
+
+   const std::size_t signal_size = 10000000;
+   Array1D<float> x(signal_size), k(kernel_size);
+   fill_array(x);
+   fill_array(k);
+
+   const auto op = conv1d_chain(Conv1DScaleBias<float>{0.5f, -0.25f}, Conv1DRelu{});
+   auto run = [&](const std::string& name, const auto& conv) {
+      Array1D<float> y_unfused(conv.output_size(signal_size)), y_fused(conv.output_size(signal_size));
+      conv.conv_into(x, y_unfused); // warm-up, touches the output pages
+      conv.conv_into(x, y_fused);
+
+      auto t1 = high_resolution_clock::now();
+      conv.conv_into(x, y_unfused);
+      const double energy_unfused = conv1d_epilogue<float>(y_unfused, y_unfused, op, Conv1DEnergy{});
+      auto t2 = high_resolution_clock::now();
+      const double time_unfused = duration<double>(t2 - t1).count();
+
+      t1 = high_resolution_clock::now();
+      const double energy_fused = conv.conv_fused_into(x, y_fused, op, Conv1DEnergy{});
+      t2 = high_resolution_clock::now();
+      const double time_fused = duration<double>(t2 - t1).count();
+
+      const bool identical = check_identical(y_fused, y_unfused) && energy_unfused == energy_fused;
+      failures += energy_unfused == energy_fused ? 0 : 1;
+      std::cout << name << " (epilogue, kernel=" << kernel_size << ") --> " << std::fixed
+                << std::setprecision(5) << "separate passes sec = " << time_unfused
+                << "; fused sec = " << time_fused << std::setprecision(3) << "; energy = " << energy_fused
+                << "; identical = " << (identical ? "yes" : "NO") << std::endl;
+   };
+
+   run("Conv1DRef", Conv1DRef<float>(k));
+   run("Conv1DPad", Conv1DPad<float>(k, 16));
+}
+
+// Identity checks for the instruction set in use (see FASTCONV_ISA): threaded
+// Conv1DRef, Conv1DPad and Conv1DTiled versus serial, and their fused epilogue
+// versus conv_into plus conv1d_epilogue, serial and threaded, compared
+// bitwise. The odd signal size and preserve_shape put the split points of the
+// threads and epilogue blocks at unaligned outputs.
+void run_identity_check(std::size_t kernel_size, bool preserve_shape)
+{
+   const std::size_t signal_size = 100003;
+   Array1D<float> x(signal_size), k(kernel_size);
+   fill_array(x);
+   fill_array(k);
+
+   const std::string title = std::string("Identity check (") + simd_isa_name(simd_isa()) + ", kernel="
+         + std::to_string(kernel_size) + (preserve_shape ? ", preserve_shape" : "") + ") --> ";
+   if ( !simd_split_invariant() )
+   {
+      std::cout << title << "skipped, the kernels of this instruction set are not split-invariant "
+                << "with this compiler" << std::endl;
+      return;
+   }
+
+   auto pool = std::make_shared<ThreadPool>(3);
+   std::string results;
+   auto report = [&](const std::string& name, bool identical) {
+      results += (results.empty() ? "" : "; ") + name + " = " + (identical ? "yes" : "NO");
+   };
+
+   auto check_threads = [&](const std::string& name, auto& serial, auto& threaded) {
+      threaded.set_thread_pool(pool);
+      threaded.set_parallel_threshold(1);
+      Array1D<float> y_serial(serial.output_size(signal_size));
+      Array1D<float> y_threaded(threaded.output_size(signal_size));
+      serial.conv_into(x, y_serial);
+      threaded.conv_into(x, y_threaded);
+      report(name + " threads", check_identical(y_serial, y_threaded));
+   };
+
+   auto check_fused = [&](const std::string& name, auto& conv) {
+      const auto op = conv1d_chain(Conv1DScaleBias<float>{0.5f, -0.25f}, Conv1DRelu{});
+      Array1D<float> y_unfused(conv.output_size(signal_size)), y_fused(conv.output_size(signal_size));
+      conv.conv_into(x, y_unfused);
+      const double energy_unfused = conv1d_epilogue<float>(y_unfused, y_unfused, op, Conv1DEnergy{});
+      const double energy_fused = conv.conv_fused_into(x, y_fused, op, Conv1DEnergy{});
+      failures += energy_unfused == energy_fused ? 0 : 1;
+      report(name + " fused", check_identical(y_unfused, y_fused) && energy_unfused == energy_fused);
+   };
+
+   Conv1DRef<float> ref(k, preserve_shape), ref_threaded(k, preserve_shape);
+   Conv1DPad<float> pad(k, 16, preserve_shape), pad_threaded(k, 16, preserve_shape);
+   Conv1DTiled<float> tiled(k, preserve_shape), tiled_threaded(k, preserve_shape);
+   check_threads("Conv1DRef", ref, ref_threaded);
+   check_threads("Conv1DPad", pad, pad_threaded);
+   check_threads("Conv1DTiled", tiled, tiled_threaded);
+   check_fused("Conv1DRef", ref);
+   check_fused("Conv1DRef threaded", ref_threaded);
+   check_fused("Conv1DPad", pad);
+   check_fused("Conv1DPad threaded", pad_threaded);
+   check_fused("Conv1DTiled", tiled);
+   check_fused("Conv1DTiled threaded", tiled_threaded);
+
+   std::cout << title << results << std::endl;
+}
+
+// Conv1DFFT versus Conv1DRef, valid and preserve_shape, for several FFT
+// lengths and signals from shorter than the kernel to many blocks long. The
+// largest error relative to the largest output must stay within tolerance.
+void run_fft_check(std::size_t kernel_size)
+{
+   constexpr double tolerance = 1e-5;
+   Array1D<float> k(kernel_size);
+   fill_array(k);
+
+   double max_error = 0;
+   for ( const std::size_t block_size : {std::size_t(0), 2 * kernel_size, std::size_t(16384)} )
+   {
+      for ( const bool preserve_shape : {false, true} )
+      {
+         Conv1DRef<float> ref(k, preserve_shape);
+         Conv1DFFT<float> fft(k, preserve_shape, block_size);
+         const std::size_t signal_sizes[] = {kernel_size / 2 + 1, kernel_size, 3 * kernel_size + 1, 100003};
+         for ( const std::size_t signal_size : signal_sizes )
+         {
+            if ( !preserve_shape && signal_size < kernel_size )
+               continue;
+            Array1D<float> x(signal_size);
+            fill_array(x);
+            const Array1D<float> y_ref = ref.conv(x), y_fft = fft.conv(x);
+            double scale = 0, error = 0;
+            for ( std::size_t i = 0; i < y_ref.size(); i++ )
+            {
+               scale = std::max(scale, double(std::fabs(y_ref(i))));
+               error = std::max(error, double(std::fabs(y_fft(i) - y_ref(i))));
+            }
+            max_error = std::max(max_error, scale > 0 ? error / scale : error);
+         }
+      }
+   }
+
+   const bool within = max_error <= tolerance;
+   failures += within ? 0 : 1;
+   std::cout << "Conv1DFFT check (kernel=" << kernel_size << ") --> max relative error = "
+             << std::scientific << std::setprecision(2) << max_error << std::defaultfloat
+             << "; within " << tolerance << " = " << (within ? "yes" : "NO") << std::endl;
+}
+
+// Smoothing, differentiation and smoothing again: three Conv1DRef passes with
+// full-size intermediates versus the tiled cascade (identical outputs)
+void run_cascade_test()
+{
+   using namespace std::chrono;
+
+   const std::size_t signal_size = 10000000;
+   Array1D<float> x(signal_size), smooth(15), diff(5), smooth2(7);
+   fill_array(x);
+   for ( std::size_t i = 0; i < smooth.size(); i++ )
+   {
+      const double t = double(i) - 0.5 * (smooth.size() - 1);
+      smooth(i) = std::exp(-t * t / smooth.size());
+   }
+   for ( std::size_t i = 0; i < diff.size(); i++ )
+   {
+      diff(i) = float(i) - 0.5f * (diff.size() - 1);
+   }
+   for ( std::size_t i = 0; i < smooth2.size(); i++ )
+   {
+      smooth2(i) = 1.0f / smooth2.size();
+   }
+
+   Conv1DRef<float> stage1(smooth), stage2(diff), stage3(smooth2);
+   Conv1DCascade<float> cascade({smooth, diff, smooth2});
+   Array1D<float> y_stages(cascade.output_size(signal_size)), y_cascade(cascade.output_size(signal_size));
+   cascade.conv_into(x, y_cascade); // warm-up, touches the output pages
+
+   auto t1 = high_resolution_clock::now();
+   Array1D<float> tmp1 = stage1.conv(x);
+   Array1D<float> tmp2 = stage2.conv(tmp1);
+   stage3.conv_into(tmp2, y_stages);
+   auto t2 = high_resolution_clock::now();
+   const double time_stages = duration<double>(t2 - t1).count();
+
+   t1 = high_resolution_clock::now();
+   cascade.conv_into(x, y_cascade);
+   t2 = high_resolution_clock::now();
+   const double time_cascade = duration<double>(t2 - t1).count();
+
+   const bool identical = check_identical(y_cascade, y_stages);
+   std::cout
+         << "Conv1DCascade (kernels=15,5,7) --> " << std::fixed << std::setprecision(5)
+         << "separate stages sec = " << time_stages << "; cascade sec = " << time_cascade
+         << std::setprecision(3) << "; verif = "
+         << y_cascade(0) + y_cascade(y_cascade.size() / 2) + y_cascade(y_cascade.size() - 1)
+         << "; identical = " << (identical ? "yes" : "NO") << std::endl;
+}
+
+// Comb-like kernel of 1024 taps with 40 nonzeros: the dense Conv1DRef, the
+// sparse engine, and a dense 40-tap kernel for the expected cost
+void run_sparse_test()
+{
+   using namespace std::chrono;
+
+   const std::size_t signal_size = 10000000, kernel_size = 1024, num_taps = 40;
+   Array1D<float> x(signal_size), k(kernel_size), k_short(num_taps);
+   fill_array(x);
+   fill_array(k_short);
+   for ( std::size_t i = 0; i < kernel_size; i++ )
+   {
+      k(i) = 0;
+   }
+   for ( std::size_t j = 0; j < num_taps; j++ )
+   {
+      k(j * (kernel_size / num_taps)) = k_short(j);
+   }
+
+   Conv1DRef<float> conv_dense(k), conv_short(k_short);
+   Conv1DSparse<float> conv_sparse(k);
+   Array1D<float> y_dense(conv_dense.output_size(signal_size));
+   Array1D<float> y_sparse(conv_sparse.output_size(signal_size));
+   Array1D<float> y_short(conv_short.output_size(signal_size));
+   conv_sparse.conv_into(x, y_sparse); // warm-up, touches the output pages
+   conv_short.conv_into(x, y_short);
+
+   auto t1 = high_resolution_clock::now();
+   conv_dense.conv_into(x, y_dense);
+   auto t2 = high_resolution_clock::now();
+   const double time_dense = duration<double>(t2 - t1).count();
+
+   t1 = high_resolution_clock::now();
+   conv_sparse.conv_into(x, y_sparse);
+   t2 = high_resolution_clock::now();
+   const double time_sparse = duration<double>(t2 - t1).count();
+
+   t1 = high_resolution_clock::now();
+   conv_short.conv_into(x, y_short);
+   t2 = high_resolution_clock::now();
+   const double time_short = duration<double>(t2 - t1).count();
+
+   std::cout
+         << "Conv1DSparse (kernel=" << kernel_size << ", nonzeros=" << conv_sparse.num_taps() << ") --> "
+         << std::fixed << std::setprecision(5) << "dense sec = " << time_dense
+         << "; sparse sec = " << time_sparse << "; dense " << num_taps << " taps sec = " << time_short
+         << std::setprecision(3) << "; verif = "
+         << y_dense(0) + y_dense(y_dense.size() / 2) + y_dense(y_dense.size() - 1) << " / "
+         << y_sparse(0) + y_sparse(y_sparse.size() / 2) + y_sparse(y_sparse.size() - 1) << std::endl;
+}
+
+// Interleaved channels (samples x channels, row-major): every channel by a
+// copy to a contiguous array and back, through strided column views, and by
+// conv1d_core_columns
+void run_strided_test(std::size_t kernel_size)
+{
+   using namespace std::chrono;
+
+   const std::size_t samples = 1000000, channels = 16;
+   Array2D<float> x(samples, channels);
+   for ( std::size_t r = 0; r < samples; r++ )
+   {
+      for ( std::size_t c = 0; c < channels; c++ )
+      {
+         x(r, c) = std::sin(0.072 * r) + std::sin(0.013 * c * r);
+      }
+   }
+   Array1D<float> k(kernel_size);
+   fill_array(k);
+
+   Conv1DRef<float> conv(k);
+   conv.set_folding(false);
+   Array2D<float> y(conv.output_size(samples), channels);
+   Array1D<float> column(samples), out(y.rows());
+   conv.conv_into(x.col(0), y.col(0)); // warm-up, touches the output pages
+
+   auto t1 = high_resolution_clock::now();
+   for ( std::size_t c = 0; c < channels; c++ )
+   {
+      for ( std::size_t r = 0; r < samples; r++ )
+      {
+         column(r) = x(r, c);
+      }
+      conv.conv_into(column, out);
+      for ( std::size_t r = 0; r < y.rows(); r++ )
+      {
+         y(r, c) = out(r);
+      }
+   }
+   auto t2 = high_resolution_clock::now();
+   const double time_copy = duration<double>(t2 - t1).count();
+   const double verif_copy = y(0, 0) + y(y.rows() - 1, channels - 1);
+
+   t1 = high_resolution_clock::now();
+   for ( std::size_t c = 0; c < channels; c++ )
+   {
+      conv.conv_into(x.col(c), y.col(c));
+   }
+   t2 = high_resolution_clock::now();
+   const double time_view = duration<double>(t2 - t1).count();
+   const double verif_view = y(0, 0) + y(y.rows() - 1, channels - 1);
+
+   Array1D<float> reversed(kernel_size);
+   for ( std::size_t i = 0; i < kernel_size; i++ )
+   {
+      reversed(i) = k(kernel_size - 1 - i);
+   }
+   t1 = high_resolution_clock::now();
+   conv1d_core_columns<float>(x, reversed, y);
+   t2 = high_resolution_clock::now();
+   const double time_columns = duration<double>(t2 - t1).count();
+   const double verif_columns = y(0, 0) + y(y.rows() - 1, channels - 1);
+
+   std::cout
+         << "Strided views (" << samples << "x" << channels << ", kernel=" << kernel_size << ") --> "
+         << std::fixed << std::setprecision(5) << "copies sec = " << time_copy
+         << "; column views sec = " << time_view << "; conv1d_core_columns sec = " << time_columns
+         << std::setprecision(3) << "; verif = " << verif_copy << " / " << verif_view << " / "
+         << verif_columns << std::endl;
+}
+
+// Complex (IQ) signal: a direct std::complex loop against Conv1DComplex with
+// four and three (Gauss) real convolutions, and with a real kernel
+void run_complex_test(std::size_t kernel_size)
+{
+   using namespace std::chrono;
+   using Complex = std::complex<float>;
+
+   const std::size_t signal_size = 1000000;
+   Array1D<float> re(signal_size), k_re(kernel_size);
+   fill_array(re);
+   fill_array(k_re);
+   Array1D<Complex> x(signal_size), k(kernel_size);
+   for ( std::size_t i = 0; i < signal_size; i++ )
+   {
+      x(i) = Complex(re(i), re(signal_size - 1 - i));
+   }
+   for ( std::size_t i = 0; i < kernel_size; i++ )
+   {
+      k(i) = Complex(k_re(i), 0.5f - k_re(kernel_size - 1 - i));
+   }
+
+   Conv1DComplex<float> conv(k), conv_gauss(k), conv_real(k_re);
+   conv_gauss.set_gauss(true);
+   const std::size_t output_size = conv.output_size(signal_size);
+   Array1D<Complex> y_direct(output_size), y(output_size), y_gauss(output_size), y_real(output_size);
+   conv.conv_into(x, y); // warm-up, touches the output pages
+
+   auto t1 = high_resolution_clock::now();
+   for ( std::size_t i = 0; i < output_size; i++ )
+   {
+      Complex total = 0;
+      for ( std::size_t j = 0; j < kernel_size; j++ )
+      {
+         total += k(kernel_size - 1 - j) * x(i + j);
+      }
+      y_direct(i) = total;
+   }
+   auto t2 = high_resolution_clock::now();
+   const double time_direct = duration<double>(t2 - t1).count();
+
+   t1 = high_resolution_clock::now();
+   conv.conv_into(x, y);
+   t2 = high_resolution_clock::now();
+   const double time_four = duration<double>(t2 - t1).count();
+
+   t1 = high_resolution_clock::now();
+   conv_gauss.conv_into(x, y_gauss);
+   t2 = high_resolution_clock::now();
+   const double time_gauss = duration<double>(t2 - t1).count();
+
+   t1 = high_resolution_clock::now();
+   conv_real.conv_into(x, y_real);
+   t2 = high_resolution_clock::now();
+   const double time_real = duration<double>(t2 - t1).count();
+
+   float error = 0, error_gauss = 0;
+   for ( std::size_t i = 0; i < output_size; i++ )
+   {
+      error = std::max(error, std::abs(y(i) - y_direct(i)));
+      error_gauss = std::max(error_gauss, std::abs(y_gauss(i) - y_direct(i)));
+   }
+
+   std::cout
+         << "Conv1DComplex (kernel=" << kernel_size << ") --> " << std::fixed << std::setprecision(5)
+         << "std::complex loop sec = " << time_direct << "; four sec = " << time_four
+         << "; gauss sec = " << time_gauss << "; real kernel sec = " << time_real << std::scientific
+         << std::setprecision(2) << "; max error = " << error << " / " << error_gauss << std::defaultfloat
+         << std::endl;
+}
+
+// 16-bit storage: time and worst error of Conv1DLowp against the float
+// convolution of the same signal. Samples are scaled by `scale` before the
+// conversion to StorageType (e.g. to Q12 for int16_t), outputs are scaled back.
+template <typename StorageType>
+void run_lowp_test(const std::string& type_name, std::size_t kernel_size, float scale, int shift)
+{
+   using namespace std::chrono;
+
+   const std::size_t signal_size = 10000000;
+   Array1D<float> x(signal_size), k(kernel_size);
+   fill_array(x);
+   fill_array(k);
+   float norm = 0;
+   for ( std::size_t i = 0; i < kernel_size; i++ )
+   {
+      norm += std::abs(k(i));
+   }
+
+   Array1D<StorageType> xl(signal_size), kl(kernel_size);
+   for ( std::size_t i = 0; i < kernel_size; i++ )
+   {
+      k(i) /= norm;
+      kl(i) = conv1d_from_float<StorageType>(k(i) * std::ldexp(1.0f, shift));
+   }
+   for ( std::size_t i = 0; i < signal_size; i++ )
+   {
+      xl(i) = conv1d_from_float<StorageType>(x(i) * scale);
+   }
+
+   Conv1DRef<float> conv_float(k);
+   conv_float.set_folding(false);
+   Conv1DLowp<StorageType> conv_lowp(kl, shift);
+   Array1D<float> y(conv_float.output_size(signal_size));
+   Array1D<StorageType> yl(conv_lowp.output_size(signal_size));
+   conv_float.conv_into(x, y); // warm-up, touches the output pages
+   conv_lowp.conv_into(xl, yl);
+
+   auto t1 = high_resolution_clock::now();
+   conv_float.conv_into(x, y);
+   auto t2 = high_resolution_clock::now();
+   const double time_float = duration<double>(t2 - t1).count();
+
+   t1 = high_resolution_clock::now();
+   conv_lowp.conv_into(xl, yl);
+   t2 = high_resolution_clock::now();
+   const double time_lowp = duration<double>(t2 - t1).count();
+
+   double max_error = 0, max_value = 0;
+   for ( std::size_t i = 0; i < y.size(); i++ )
+   {
+      max_error = std::max(max_error, std::abs(double(conv1d_to_float(yl(i))) / scale - y(i)));
+      max_value = std::max(max_value, std::abs(double(y(i))));
+   }
+
+   std::cout
+         << "Conv1DLowp (" << type_name << ", kernel=" << kernel_size << ") --> " << std::fixed
+         << std::setprecision(5) << "float sec = " << time_float << "; 16-bit sec = " << time_lowp
+         << std::scientific << std::setprecision(2) << "; max rel error = " << max_error / max_value
+         << std::defaultfloat << std::endl;
+}
+
+// Rational resampling by up/down: zero-stuffing, Conv1DRef and decimation,
+// versus Resampler1D that only computes the kept outputs
+void run_resample_test(std::size_t up, std::size_t down, std::size_t kernel_size, std::size_t signal_size)
+{
+   using namespace std::chrono;
+
+   Array1D<float> x(signal_size), k(kernel_size);
+   fill_array(x);
+   fill_array(k);
+
+   Resampler1D<float> resampler(k, up, down);
+   Array1D<float> y(resampler.output_size(signal_size));
+   resampler.conv_into(x, y); // warm-up, touches the output pages
+
+   // zeros in front align output m with upsampled index m * down
+   const std::size_t phase_size = (kernel_size + up - 1) / up;
+   const std::size_t lead = kernel_size - 1 - (phase_size - 1) * up;
+   Conv1DRef<float> conv1d(k);
+
+   auto t1 = high_resolution_clock::now();
+   Array1D<float> upsampled(lead + signal_size * up);
+   for ( std::size_t i = 0; i < upsampled.size(); i++ )
+   {
+      upsampled(i) = 0;
+   }
+   for ( std::size_t i = 0; i < signal_size; i++ )
+   {
+      upsampled(lead + i * up) = x(i);
+   }
+   Array1D<float> filtered = conv1d.conv(upsampled);
+   for ( std::size_t m = 0; m < y.size(); m++ )
+   {
+      y(m) = filtered(m * down);
+   }
+   auto t2 = high_resolution_clock::now();
+   const double time_naive = duration<double>(t2 - t1).count();
+   const double verif_naive = y(0) + y(y.size() / 2) + y(y.size() - 1);
+
+   t1 = high_resolution_clock::now();
+   resampler.conv_into(x, y);
+   t2 = high_resolution_clock::now();
+   const double time_polyphase = duration<double>(t2 - t1).count();
+   const double verif_polyphase = y(0) + y(y.size() / 2) + y(y.size() - 1);
+
+   std::cout
+         << "Resampler1D (" << up << "/" << down << ", kernel=" << kernel_size << ") --> " << std::fixed
+         << std::setprecision(5) << "naive sec = " << time_naive << "; polyphase sec = " << time_polyphase
+         << std::setprecision(3) << "; verif = " << verif_naive << " / " << verif_polyphase << std::endl;
+}
+
+// Separable 2D convolution of an image: row pass with Conv1DRef and a
+// strided column pass written by hand, versus Conv2DSeparable
+void run_separable_test(std::size_t kernel_size)
+{
+   using namespace std::chrono;
+
+   const std::size_t rows = 2048, cols = 2048;
+   Array2D<float> x(rows, cols);
+   for ( std::size_t r = 0; r < rows; r++ )
+   {
+      for ( std::size_t c = 0; c < cols; c++ )
+      {
+         x(r, c) = std::sin(0.072 * c) + std::sin(0.013 * r);
+      }
+   }
+   Array1D<float> k(kernel_size);
+   fill_array(k);
+
+   Conv1DRef<float> conv1d(k);
+   Conv2DSeparable<float> conv2d(k, k);
+   Array2D<float> tmp(rows, conv1d.output_size(cols));
+   Array2D<float> y(conv2d.output_rows(rows), conv2d.output_cols(cols));
+   conv2d.conv_into(x, y); // warm-up, touches the output pages
+
+   auto t1 = high_resolution_clock::now();
+   for ( std::size_t r = 0; r < rows; r++ )
+   {
+      conv1d.conv_into(x.row(r), tmp.row(r));
+   }
+   for ( std::size_t c = 0; c < y.cols(); c++ )
+   {
+      for ( std::size_t r = 0; r < y.rows(); r++ )
+      {
+         float total = 0;
+         for ( std::size_t j = 0; j < kernel_size; j++ )
+         {
+            total += k(kernel_size - 1 - j) * tmp(r + j, c);
+         }
+         y(r, c) = total;
+      }
+   }
+   auto t2 = high_resolution_clock::now();
+   const double time_naive = duration<double>(t2 - t1).count();
+   const double verif_naive = y(0, 0) + y(y.rows() - 1, y.cols() - 1);
+
+   t1 = high_resolution_clock::now();
+   conv2d.conv_into(x, y);
+   t2 = high_resolution_clock::now();
+   const double time_separable = duration<double>(t2 - t1).count();
+   const double verif_separable = y(0, 0) + y(y.rows() - 1, y.cols() - 1);
+
+   std::cout
+         << "Conv2DSeparable (" << rows << "x" << cols << ", kernel=" << kernel_size << ") --> "
+         << std::fixed << std::setprecision(5) << "by hand sec = " << time_naive
+         << "; separable sec = " << time_separable << std::setprecision(3) << "; verif = " << verif_naive
+         << " / " << verif_separable << std::endl;
+}
+
 void read_env()
 {
    const char* buf = std::getenv("EXTRA_OUTPUT");
@@ -120,10 +1063,45 @@ void read_env()
    extra_output = std::atoi(buf) != 0;
 }
 
+void read_long_kernels()
+{
+   const char* buf = std::getenv("LONG_KERNELS");
+   long_kernels = buf && std::atoi(buf) != 0;
+}
+
+void read_check_only()
+{
+   const char* buf = std::getenv("CHECK_ONLY");
+   check_only = buf && std::atoi(buf) != 0;
+}
+
+void read_threads()
+{
+   const char* buf = std::getenv("NUM_THREADS");
+   num_threads = buf ? std::max(1, std::atoi(buf)) : 1;
+}
+
 int main()
 {
 
    read_env();
+   read_threads();
+   read_long_kernels();
+   read_check_only();
+
+   for ( const std::size_t kernel_size : {7, 31, 100} )
+   {
+      run_identity_check(kernel_size, false);
+      run_identity_check(kernel_size, true);
+   }
+   for ( const std::size_t kernel_size : {33, 256, 1000} )
+   {
+      run_fft_check(kernel_size);
+   }
+   if ( check_only )
+   {
+      return failures > 0 ? 1 : 0;
+   }
 
    print_list("array sizes", array_sizes);
    print_list("kernel sizes", kernel_sizes);
@@ -137,5 +1115,96 @@ int main()
    run_test("Conv1DPad (modulo=8)", (Conv1DBase<float>*)&conv1d_pad_8);
    run_test("Conv1DPad (modulo=16)", (Conv1DBase<float>*)&conv1d_pad_16);
 
+   run_batch_test("Conv1DRef", (Conv1DBase<float>*)&conv1d_ref);
+   run_batch_test("Conv1DPad (modulo=16)", (Conv1DBase<float>*)&conv1d_pad_16);
+
+   run_bank_test();
+
+   run_symmetric_test();
+
+   for ( const std::size_t stride : {4, 8, 16} )
+   {
+      run_decimation_test(stride);
+   }
+
+   for ( const std::size_t kernel_size : {7, 31} )
+   {
+      run_boundary_test(kernel_size);
+   }
+
+   for ( const std::size_t kernel_size : {7, 31} )
+   {
+      run_fused_test(kernel_size);
+   }
+
+   run_cascade_test();
+
+   run_sparse_test();
+
+   for ( const std::size_t kernel_size : {7, 31} )
+   {
+      run_strided_test(kernel_size);
+   }
+
+   for ( const std::size_t kernel_size : {7, 31} )
+   {
+      run_complex_test(kernel_size);
+   }
+
+   for ( const std::size_t kernel_size : {7, 31} )
+   {
+#ifdef FASTCONV_HAS_FLOAT16
+      run_lowp_test<_Float16>("fp16", kernel_size, 1.0f, 0);
+#endif
+      run_lowp_test<BFloat16>("bf16", kernel_size, 1.0f, 0);
+      run_lowp_test<std::int16_t>("int16 Q15", kernel_size, 8192.0f, 15);
+   }
+
+   run_resample_test(3, 2, 48, 1000000);
+   run_resample_test(160, 147, 1280, 44100);
+
+   for ( const std::size_t kernel_size : {5, 15} )
+   {
+      run_separable_test(kernel_size);
+   }
+
+   for ( const auto& packet_size : packet_sizes )
+   {
+      run_stream_test(packet_size);
+   }
+
+   // with FASTCONV_WISDOM set, decisions are loaded from and saved to that file
+   Conv1DAuto<float> conv1d_auto;
+   run_test("Conv1DAuto", (Conv1DBase<float>*)&conv1d_auto);
+   if ( const char* wisdom_path = std::getenv("FASTCONV_WISDOM") )
+   {
+      Conv1DWisdom::global()->save(wisdom_path);
+   }
+
+   if ( num_threads > 1 )
+   {
+      auto pool = std::make_shared<ThreadPool>(num_threads);
+      const std::string suffix = " (threads=" + std::to_string(num_threads) + ")";
+      conv1d_ref.set_thread_pool(pool);
+      conv1d_pad_16.set_thread_pool(pool);
+      run_test("Conv1DRef" + suffix, (Conv1DBase<float>*)&conv1d_ref);
+      run_test("Conv1DPad (modulo=16)" + suffix, (Conv1DBase<float>*)&conv1d_pad_16);
+   }
+
+   if ( long_kernels )
+   {
+      print_list("long kernel sizes", long_kernel_sizes);
+      Conv1DFFT<float> conv1d_fft;
+      Conv1DTiled<float> conv1d_tiled;
+      run_test("Conv1DRef", (Conv1DBase<float>*)&conv1d_ref, long_kernel_sizes);
+      run_test("Conv1DTiled", (Conv1DBase<float>*)&conv1d_tiled, long_kernel_sizes);
+      run_test("Conv1DFFT", (Conv1DBase<float>*)&conv1d_fft, long_kernel_sizes);
+   }
+
+   if ( failures > 0 )
+   {
+      std::cout << failures << " identity check(s) FAILED" << std::endl;
+      return 1;
+   }
    return 0;
 }